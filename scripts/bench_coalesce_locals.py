@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+#
+# Copyright 2022 WebAssembly Community Group participants
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+'''
+Benchmarks coalesce-locals on a single function with a great many locals, like
+the ones that compilers emit for huge generated functions. The fuzzer does not
+help here, as it keeps the number of locals in each function small.
+
+Usage: bench_coalesce_locals.py [--locals N] WASM_OPT [WASM_OPT...]
+
+A random function with N locals (by default 2000) is generated, where nearby
+code uses nearby locals, so that live ranges are short and overlap only a
+little, as is typical. The first wasm-opt binary flattens it and converts it to
+SSA form, which gives each set its own local and multiplies the number of
+locals by about 10. Then each given binary (e.g. one built before and one after
+a change) runs coalesce-locals on the result, and its wall-clock time and peak
+memory usage are reported.
+'''
+
+import os
+import random
+import subprocess
+import tempfile
+
+from test import support
+
+DEFAULT_LOCALS = 2000
+# How far from the "current" local the code may use another one.
+WINDOW = 30
+# How deeply ifs and loops nest, and how many statements each one has at most.
+MAX_DEPTH = 4
+MAX_SPAN = 50
+
+
+def make_module(num_locals, seed=1):
+    rng = random.Random(seed)
+    num_stmts = 2 * num_locals
+    out = []
+    # Locals are initialized in order at the top level, before the code near
+    # them can use them, so that they are not live all the way from the entry.
+    initialized = [0]
+
+    def local(pos):
+        base = pos * num_locals // num_stmts
+        return min(initialized[0] - 1,
+                   max(0, base + rng.randint(-WINDOW, WINDOW)))
+
+    def expr(pos, depth=0):
+        r = rng.random()
+        if depth > 2 or r < 0.4:
+            return '(local.get $l%d)' % local(pos)
+        if r < 0.5:
+            return '(i32.const %d)' % rng.randint(0, 100)
+        return '(i32.add %s %s)' % (expr(pos, depth + 1), expr(pos, depth + 1))
+
+    def stmts(lo, hi, depth):
+        i = lo
+        while i < hi:
+            if depth == 0:
+                # Code nested in this statement can reach locals further on.
+                end = min(hi, i + MAX_SPAN * MAX_DEPTH)
+                needed = min(num_locals,
+                             end * num_locals // num_stmts + WINDOW + 1)
+                while initialized[0] < needed:
+                    out.append('(local.set $l%d (i32.const %d))'
+                               % (initialized[0], initialized[0]))
+                    initialized[0] += 1
+            r = rng.random()
+            if depth < MAX_DEPTH and r < 0.13 and hi - i > 4:
+                mid = rng.randint(i + 1, min(hi, i + MAX_SPAN))
+                if r < 0.1:
+                    out.append('(if %s (then' % expr(i))
+                    stmts(i, mid, depth + 1)
+                    out.append('))')
+                else:
+                    out.append('(block $b%d (loop $c%d (br_if $b%d %s)'
+                               % (i, i, i, expr(i)))
+                    stmts(i, mid, depth + 1)
+                    out.append('(br $c%d)))' % i)
+                i = mid
+            else:
+                out.append('(local.set $l%d %s)' % (local(i), expr(i)))
+                i += 1
+
+    stmts(0, num_stmts, 0)
+    locals_ = ' '.join('(local $l%d i32)' % i for i in range(num_locals))
+    return ('(module (func $huge (export "huge") (param $p i32) (result i32)'
+            ' %s\n%s\n(local.get $l0)))\n' % (locals_, '\n'.join(out)))
+
+
+def main():
+    num_locals, binaries, _ = support.parse_bench_args(
+        __doc__, '--locals', DEFAULT_LOCALS)
+    with tempfile.TemporaryDirectory() as temp:
+        wat = os.path.join(temp, 'huge.wat')
+        with open(wat, 'w') as f:
+            f.write(make_module(num_locals))
+        ssa = os.path.join(temp, 'ssa.wasm')
+        subprocess.check_call([binaries[0], wat, '--flatten', '--ssa-nomerge',
+                               '-o', ssa])
+        out = os.path.join(temp, 'out.wasm')
+        print('one function with %d locals before flattening' % num_locals)
+        for binary in binaries:
+            wall, _, memory = support.measure(
+                [binary, ssa, '--coalesce-locals', '-o', out])
+            support.print_measurement(binary, wall, memory)
+
+
+if __name__ == '__main__':
+    main()
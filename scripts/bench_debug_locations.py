@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+#
+# Copyright 2022 WebAssembly Community Group participants
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+'''
+Benchmarks the memory used for source map debug locations, which nearly every
+expression has in a -g build. This is like test/fib-dbg.wasm and its source
+map, but scaled up to a size where the debug info is a large part of the
+memory usage.
+
+Usage: bench_debug_locations.py [--functions N] WASM_OPT [WASM_OPT...]
+
+A module with N functions (by default 1000) is generated, each with a few
+thousand expressions that all have a source location. The first wasm-opt binary
+converts it to a binary with a source map. Then each given binary (e.g. one
+built before and one after a change) reads that with its source map and writes
+it out with a new source map, once without optimizing and once with -O1. The
+wall-clock time and peak memory usage of each run are reported.
+'''
+
+import os
+import random
+import subprocess
+import tempfile
+
+from test import support
+
+DEFAULT_FUNCTIONS = 1000
+STATEMENTS = 300
+# How deeply expressions nest.
+MAX_DEPTH = 3
+
+
+def make_module(num_functions, seed=1):
+    rng = random.Random(seed)
+    out = ['(module']
+    line = [1]
+
+    def loc():
+        # Each expression gets a location on a new line of the source, and
+        # often a new column.
+        line[0] += rng.randint(0, 1)
+        return ';;@ fib.c:%d:%d\n' % (line[0], rng.randint(1, 40))
+
+    def expr(depth):
+        if depth >= MAX_DEPTH or rng.random() < 0.3:
+            if rng.random() < 0.5:
+                return '%s(local.get $l%d)' % (loc(), rng.randint(0, 3))
+            return '%s(i32.const %d)' % (loc(), rng.randint(0, 100))
+        return '%s(i32.add %s %s)' % (loc(), expr(depth + 1), expr(depth + 1))
+
+    for i in range(num_functions):
+        out.append('%s(func $f%d (export "f%d") (param $l0 i32) (result i32)'
+                   % (loc(), i, i))
+        out.append('(local $l1 i32) (local $l2 i32) (local $l3 i32)')
+        for _ in range(STATEMENTS):
+            out.append('%s(local.set $l%d %s)'
+                       % (loc(), rng.randint(0, 3), expr(0)))
+        out.append('%s(local.get $l1))' % loc())
+    out.append(')')
+    return '\n'.join(out) + '\n'
+
+
+def main():
+    num_functions, binaries, _ = support.parse_bench_args(
+        __doc__, '--functions', DEFAULT_FUNCTIONS)
+    with tempfile.TemporaryDirectory() as temp:
+        wat = os.path.join(temp, 'dbg.wat')
+        with open(wat, 'w') as f:
+            f.write(make_module(num_functions))
+        wasm = os.path.join(temp, 'dbg.wasm')
+        subprocess.check_call([binaries[0], wat, '-g', '-o', wasm,
+                               '--output-source-map', wasm + '.map'])
+        out = os.path.join(temp, 'out.wasm')
+        print('%d functions, %d bytes of wasm, %d bytes of source map'
+              % (num_functions, os.path.getsize(wasm),
+                 os.path.getsize(wasm + '.map')))
+        for binary in binaries:
+            for opts in [[], ['-O1']]:
+                wall, _, memory = support.measure(
+                    [binary, wasm, '-g'] + opts +
+                    ['--input-source-map', wasm + '.map', '-o', out,
+                     '--output-source-map', out + '.map'])
+                desc = '%s %s' % (binary, ' '.join(opts) or '(no passes)')
+                support.print_measurement(desc, wall, memory)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+#
+# Copyright 2022 WebAssembly Community Group participants
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+'''
+Benchmarks the interpreter on fannkuch (see test/fannkuch.cpp), written by
+hand in the text format so that it needs no toolchain, comparing the tree
+walker with the bytecode tier.
+
+Usage: bench_interpreter.py WASM_SHELL [N]
+
+N is the size of the permutations, 8 by default. Each size up to 11 has a
+known result, which is checked.
+'''
+
+import subprocess
+import sys
+import tempfile
+import time
+
+RESULTS = {5: 7, 6: 10, 7: 16, 8: 22, 9: 30, 10: 38, 11: 51}
+
+# The worker of fannkuch.cpp, with perm1, perm and count in memory at 0, 64 and
+# 128.
+MODULE = '''
+(module
+ (memory 1)
+ (func $worker (param $i i32) (param $n i32) (result i32)
+  (local $maxflips i32) (local $flips i32) (local $j i32) (local $k i32)
+  (local $r i32) (local $tmp i32) (local $x i32) (local $p0 i32)
+  (block $d (loop $l
+   (br_if $d (i32.ge_s (local.get $x) (local.get $n)))
+   (i32.store (i32.shl (local.get $x) (i32.const 2)) (local.get $x))
+   (local.set $x (i32.add (local.get $x) (i32.const 1)))
+   (br $l)))
+  (i32.store (i32.shl (local.get $i) (i32.const 2))
+   (i32.sub (local.get $n) (i32.const 1)))
+  (i32.store (i32.shl (i32.sub (local.get $n) (i32.const 1)) (i32.const 2))
+   (local.get $i))
+  (local.set $r (local.get $n))
+  (loop $outer
+   (block $d (loop $l
+    (br_if $d (i32.le_s (local.get $r) (i32.const 1)))
+    (i32.store offset=128
+     (i32.shl (i32.sub (local.get $r) (i32.const 1)) (i32.const 2))
+     (local.get $r))
+    (local.set $r (i32.sub (local.get $r) (i32.const 1)))
+    (br $l)))
+   (if (i32.and
+        (i32.ne (i32.load (i32.const 0)) (i32.const 0))
+        (i32.ne
+         (i32.load
+          (i32.shl (i32.sub (local.get $n) (i32.const 1)) (i32.const 2)))
+         (i32.sub (local.get $n) (i32.const 1))))
+    (then
+     (local.set $x (i32.const 0))
+     (block $d (loop $l
+      (br_if $d (i32.ge_s (local.get $x) (local.get $n)))
+      (i32.store offset=64 (i32.shl (local.get $x) (i32.const 2))
+       (i32.load (i32.shl (local.get $x) (i32.const 2))))
+      (local.set $x (i32.add (local.get $x) (i32.const 1)))
+      (br $l)))
+     (local.set $flips (i32.const 0))
+     (local.set $k (i32.load offset=64 (i32.const 0)))
+     (loop $do
+      (local.set $x (i32.const 1))
+      (local.set $j (i32.sub (local.get $k) (i32.const 1)))
+      (block $d (loop $l
+       (br_if $d (i32.ge_s (local.get $x) (local.get $j)))
+       (local.set $tmp
+        (i32.load offset=64 (i32.shl (local.get $x) (i32.const 2))))
+       (i32.store offset=64 (i32.shl (local.get $x) (i32.const 2))
+        (i32.load offset=64 (i32.shl (local.get $j) (i32.const 2))))
+       (i32.store offset=64 (i32.shl (local.get $j) (i32.const 2))
+        (local.get $tmp))
+       (local.set $x (i32.add (local.get $x) (i32.const 1)))
+       (local.set $j (i32.sub (local.get $j) (i32.const 1)))
+       (br $l)))
+      (local.set $flips (i32.add (local.get $flips) (i32.const 1)))
+      (local.set $tmp
+       (i32.load offset=64 (i32.shl (local.get $k) (i32.const 2))))
+      (i32.store offset=64 (i32.shl (local.get $k) (i32.const 2))
+       (local.get $k))
+      (local.set $k (local.get $tmp))
+      (br_if $do (local.get $k)))
+     (if (i32.lt_s (local.get $maxflips) (local.get $flips))
+      (then (local.set $maxflips (local.get $flips))))))
+   (loop $next
+    (if (i32.ge_s (local.get $r) (i32.sub (local.get $n) (i32.const 1)))
+     (then (return (local.get $maxflips))))
+    (local.set $p0 (i32.load (i32.const 0)))
+    (local.set $x (i32.const 0))
+    (block $d (loop $l
+     (br_if $d (i32.ge_s (local.get $x) (local.get $r)))
+     (i32.store (i32.shl (local.get $x) (i32.const 2))
+      (i32.load offset=4 (i32.shl (local.get $x) (i32.const 2))))
+     (local.set $x (i32.add (local.get $x) (i32.const 1)))
+     (br $l)))
+    (i32.store (i32.shl (local.get $x) (i32.const 2)) (local.get $p0))
+    (local.set $tmp
+     (i32.sub (i32.load offset=128 (i32.shl (local.get $r) (i32.const 2)))
+      (i32.const 1)))
+    (i32.store offset=128 (i32.shl (local.get $r) (i32.const 2))
+     (local.get $tmp))
+    (br_if $outer (i32.gt_s (local.get $tmp) (i32.const 0)))
+    (local.set $r (i32.add (local.get $r) (i32.const 1)))
+    (br $next)))
+  (unreachable))
+ (func $fannkuch (export "fannkuch") (param $n i32) (result i32)
+  (local $i i32) (local $max i32) (local $flips i32)
+  (block $d (loop $l
+   (br_if $d (i32.ge_s (local.get $i) (i32.sub (local.get $n) (i32.const 1))))
+   (local.set $flips (call $worker (local.get $i) (local.get $n)))
+   (if (i32.gt_s (local.get $flips) (local.get $max))
+    (then (local.set $max (local.get $flips))))
+   (local.set $i (i32.add (local.get $i) (i32.const 1)))
+   (br $l)))
+  (local.get $max))
+)
+(assert_return (invoke "fannkuch" (i32.const %d)) (i32.const %d))
+'''
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+    shell = sys.argv[1]
+    n = int(sys.argv[2]) if len(sys.argv) > 2 else 8
+    if n not in RESULTS:
+        print('N must be one of %s' % sorted(RESULTS))
+        sys.exit(1)
+    with tempfile.NamedTemporaryFile('w', suffix='.wast') as wast:
+        wast.write(MODULE % (n, RESULTS[n]))
+        wast.flush()
+        for name, args in [('tree', []), ('bytecode', ['--bytecode'])]:
+            start = time.time()
+            proc = subprocess.run([shell, wast.name] + args,
+                                  stdout=subprocess.PIPE,
+                                  stderr=subprocess.STDOUT, text=True)
+            elapsed = time.time() - start
+            if proc.returncode != 0:
+                print(proc.stdout)
+                sys.exit('%s: failed' % name)
+            print('fannkuch(%d), %s: %.2fs' % (n, name, elapsed))
+
+
+if __name__ == '__main__':
+    main()
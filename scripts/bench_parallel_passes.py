@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+#
+# Copyright 2022 WebAssembly Community Group participants
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+'''
+Benchmarks how well function-parallel passes use the available cores on a
+skewed module, that is, one with many small functions and a single huge one at
+the very end, which is the worst case for scheduling functions in module order.
+
+Usage: bench_parallel_passes.py WASM_OPT [WASM_OPT...] [--] [wasm-opt args]
+
+Each given wasm-opt binary (e.g. one built before and one after a scheduling
+change) is run on the same generated module, and the wall-clock time, CPU time
+and core utilization (CPU time divided by wall-clock time times the number of
+cores) are reported for each. By default the module is optimized with -O3.
+'''
+
+import os
+import tempfile
+
+from test import support
+
+NUM_SMALL = 2000
+SMALL_SIZE = 20
+HUGE_SIZE = 40000
+
+
+def make_function(name, size):
+    body = ['(local.set $x (i32.const 1))']
+    for i in range(size):
+        body.append('(local.set $x (i32.add (i32.mul (local.get $x) '
+                    '(local.get $p)) (i32.const %d)))' % i)
+        body.append('(if (i32.eqz (local.get $x)) (local.set $x '
+                    '(call $%s (local.get $x))))' % name)
+    return ('(func $%s (export "%s") (param $p i32) (result i32) '
+            '(local $x i32)\n %s\n (local.get $x))\n'
+            % (name, name, '\n '.join(body)))
+
+
+def make_module():
+    parts = ['(module\n']
+    for i in range(NUM_SMALL):
+        parts.append(make_function('small%d' % i, SMALL_SIZE))
+    parts.append(make_function('huge', HUGE_SIZE))
+    parts.append(')\n')
+    return ''.join(parts)
+
+
+def main():
+    _, binaries, opts = support.parse_bench_args(__doc__)
+    if opts is None:
+        opts = ['-O3']
+    cores = int(os.environ.get('BINARYEN_CORES', os.cpu_count()))
+    with tempfile.TemporaryDirectory() as temp:
+        wat = os.path.join(temp, 'skewed.wat')
+        with open(wat, 'w') as f:
+            f.write(make_module())
+        out = os.path.join(temp, 'out.wasm')
+        print('%d small functions, one huge function at the end, %d cores'
+              % (NUM_SMALL, cores))
+        for binary in binaries:
+            wall, cpu, _ = support.measure([binary, wat, '-o', out] + opts)
+            if cpu is None:
+                print('%s: failed after %.2fs' % (binary, wall))
+                continue
+            print('%s: wall %.2fs, cpu %.2fs, utilization %.0f%%'
+                  % (binary, wall, cpu, 100 * cpu / (wall * cores)))
+
+
+if __name__ == '__main__':
+    main()
@@ -18,6 +18,7 @@ import shutil
 import subprocess
 import sys
 import tempfile
+import time
 
 
 def _open_archive(tarfile, tmp_dir):
@@ -205,3 +206,47 @@ def js_test_wrap():
             %TEST%
         })();
     '''
+
+
+# Helpers for the benchmark scripts (scripts/bench_*.py), which compare
+# binaries, for example one built before and one after a change.
+
+def parse_bench_args(usage, option=None, default=None):
+    '''Parses the arguments of a benchmark: the binaries to compare,
+    optionally preceded by an integer option like "--functions N", and
+    optionally followed by "--" and arguments to pass to the binaries. Returns
+    the option's value, the binaries and the arguments after "--" (or None).
+    Prints the usage and exits if no binaries are given.'''
+    args = sys.argv[1:]
+    value = default
+    if option and args[:1] == [option]:
+        value = int(args[1])
+        args = args[2:]
+    extra = None
+    if '--' in args:
+        split = args.index('--')
+        args, extra = args[:split], args[split + 1:]
+    if not args:
+        print(usage)
+        sys.exit(1)
+    return value, args, extra
+
+
+def measure(cmd):
+    '''Runs a command and returns its wall-clock time, CPU time and peak
+    memory usage in MB. The latter two are None if the command fails.'''
+    start = time.time()
+    proc = subprocess.Popen(cmd)
+    _, status, usage = os.wait4(proc.pid, 0)
+    wall = time.time() - start
+    if status != 0:
+        return wall, None, None
+    # ru_maxrss is in kilobytes.
+    return wall, usage.ru_utime + usage.ru_stime, usage.ru_maxrss / 1024
+
+
+def print_measurement(desc, wall, memory):
+    if memory is None:
+        print('%s: failed after %.2fs' % (desc, wall))
+    else:
+        print('%s: wall %.2fs, peak memory %.0f MB' % (desc, wall, memory))
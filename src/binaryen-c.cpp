@@ -4018,12 +4018,12 @@ void BinaryenModulePrintAsmjs(BinaryenModuleRef module) {
   Wasm2JSBuilder::Flags flags;
   Wasm2JSBuilder wasm2js(flags, globalPassOptions);
   auto asmjs = wasm2js.processWasm(wasm);
-  JSPrinter jser(true, true, asmjs);
+  JSPrinter jser(true, true, asmjs, std::cout);
   Output out("", Flags::Text); // stdout
   Wasm2JSGlue glue(*wasm, out, flags, "asmFunc");
   glue.emitPre();
   jser.printAst();
-  std::cout << jser.buffer << std::endl;
+  std::cout << std::endl;
   glue.emitPost();
 }
 
@@ -4279,12 +4279,9 @@ char* BinaryenModuleAllocateAndWriteStackIR(BinaryenModuleRef module,
 
 BinaryenModuleRef BinaryenModuleRead(char* input, size_t inputSize) {
   auto* wasm = new Module;
-  std::vector<char> buffer(false);
-  buffer.resize(inputSize);
-  std::copy_n(input, inputSize, buffer.begin());
   try {
     // TODO: allow providing features in the C API
-    WasmBinaryBuilder parser(*wasm, FeatureSet::MVP, buffer);
+    WasmBinaryBuilder parser(*wasm, FeatureSet::MVP, {input, inputSize});
     parser.read();
   } catch (ParseException& p) {
     p.dump(std::cerr);
@@ -21,10 +21,11 @@
 #ifndef liveness_traversal_h
 #define liveness_traversal_h
 
+#include <unordered_map>
+
 #include "cfg-traversal.h"
 #include "ir/utils.h"
 #include "support/sorted_vector.h"
-#include "support/sparse_square_matrix.h"
 #include "wasm-builder.h"
 #include "wasm-traversal.h"
 #include "wasm.h"
@@ -106,9 +107,11 @@ struct LivenessWalker : public CFGWalker<SubType, VisitorType, Liveness> {
 
   Index numLocals;
   std::unordered_set<BasicBlock*> liveBlocks;
-  // access as a upper triangular matrix: i.e. when accessing a pair (i,j),
-  // should access the cell i < j.
-  sparse_square_matrix<uint8_t> copies;
+  // The number of copies between each local and the locals it is copied to or
+  // from (saturating at 255). This is symmetric, that is, copies[i][j] ==
+  // copies[j][i]. Most locals are only copied to or from a few others, so this
+  // is sparse, which also lets us iterate on the copies of a local.
+  std::vector<std::unordered_map<Index, uint8_t>> copies;
 
   // total # of copies for each local, with all others
   std::vector<Index> totalCopies;
@@ -196,7 +199,8 @@ struct LivenessWalker : public CFGWalker<SubType, VisitorType, Liveness> {
 
   void doWalkFunction(Function* func) {
     numLocals = func->getNumLocals();
-    copies.recreate(numLocals);
+    copies.clear();
+    copies.resize(numLocals);
     totalCopies.clear();
     totalCopies.resize(numLocals);
     // create the CFG by walking the IR
@@ -281,19 +285,16 @@ struct LivenessWalker : public CFGWalker<SubType, VisitorType, Liveness> {
   }
 
   void addCopy(Index i, Index j) {
-    if (j > i) {
-      std::swap(i, j);
-    }
-    copies.set(i, j, std::min(copies.get(i, j), uint8_t(254)) + 1);
+    auto& count = copies[i][j];
+    count = std::min(count, uint8_t(254)) + 1;
+    copies[j][i] = count;
     totalCopies[i]++;
     totalCopies[j]++;
   }
 
   uint8_t getCopies(Index i, Index j) {
-    if (j > i) {
-      std::swap(i, j);
-    }
-    return copies.get(i, j);
+    auto iter = copies[i].find(j);
+    return iter == copies[i].end() ? 0 : iter->second;
   }
 };
 
@@ -20,9 +20,12 @@
 #ifndef wasm_istring_h
 #define wasm_istring_h
 
+#include <memory>
+#include <mutex>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <assert.h>
 #include <stdint.h>
@@ -59,6 +62,68 @@ struct IString {
     }
   };
 
+  typedef std::unordered_set<const char*, CStringHash, CStringEqual> StringSet;
+
+  // The global store of strings, in which each string is allocated exactly
+  // once. It is split into shards by hash, each with its own lock, so that
+  // threads interning different strings rarely wait on each other.
+  class GlobalStrings {
+    static constexpr size_t NumShards = 64;
+    static constexpr size_t ChunkSize = 64 * 1024;
+
+    struct Shard {
+      std::mutex mutex;
+      StringSet strings;
+      // Storage for the copies of strings that we may not reuse. Copies are
+      // bump-allocated in large chunks, and never freed or moved.
+      std::vector<std::unique_ptr<char[]>> chunks;
+      size_t chunkUsed = ChunkSize;
+      std::vector<std::unique_ptr<char[]>> largeStrings;
+
+      const char* copy(const char* s) {
+        size_t size = strlen(s) + 1;
+        char* ret;
+        if (size > ChunkSize / 4) {
+          // Large strings get an allocation of their own, so that we don't
+          // waste the rest of the current chunk.
+          largeStrings.emplace_back(new char[size]);
+          ret = largeStrings.back().get();
+        } else {
+          if (chunkUsed + size > ChunkSize) {
+            chunks.emplace_back(new char[ChunkSize]);
+            chunkUsed = 0;
+          }
+          ret = chunks.back().get() + chunkUsed;
+          chunkUsed += size;
+        }
+        memcpy(ret, s, size);
+        return ret;
+      }
+    };
+
+    Shard shards[NumShards];
+
+  public:
+    static GlobalStrings& get() {
+      static GlobalStrings globalStrings;
+      return globalStrings;
+    }
+
+    const char* intern(const char* s, bool reuse) {
+      auto& shard = shards[hash_c(s) % NumShards];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      auto existing = shard.strings.find(s);
+      if (existing != shard.strings.end()) {
+        return *existing;
+      }
+      if (!reuse) {
+        s = shard.copy(s);
+      }
+      shard.strings.insert(s);
+      return s;
+    }
+  };
+
   IString() = default;
   // if reuse=true, then input is assumed to remain alive; not copied
   IString(const char* s, bool reuse = true) {
@@ -67,36 +132,13 @@ struct IString {
   }
 
   void set(const char* s, bool reuse = true) {
-    typedef std::unordered_set<const char*, CStringHash, CStringEqual>
-      StringSet;
-    // one global store of strings per thread, we must not access this
-    // in parallel
+    // Each thread remembers the strings it has seen, so that it only needs to
+    // look in the global store, and take a lock, the first time it sees one.
     thread_local static StringSet strings;
 
     auto existing = strings.find(s);
-
     if (existing == strings.end()) {
-      // if the string isn't already known, we must use a single global
-      // storage location, guarded by a mutex, so each string is allocated
-      // exactly once
-      static std::mutex mutex;
-      std::unique_lock<std::mutex> lock(mutex);
-      // a single global set contains the actual strings, so we allocate each
-      // one exactly once.
-      static StringSet globalStrings;
-      auto globalExisting = globalStrings.find(s);
-      if (globalExisting == globalStrings.end()) {
-        if (!reuse) {
-          static std::vector<std::unique_ptr<std::string>> allocated;
-          allocated.emplace_back(wasm::make_unique<std::string>(s));
-          s = allocated.back()->c_str(); // we'll never modify it, so this is ok
-        }
-        // insert into global set
-        globalStrings.insert(s);
-      } else {
-        s = *globalExisting;
-      }
-      // add the string to our thread-local set
+      s = GlobalStrings::get().intern(s, reuse);
       strings.insert(s);
     } else {
       s = *existing;
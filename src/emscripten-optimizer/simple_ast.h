@@ -27,8 +27,10 @@
 #include <iomanip>
 #include <iostream>
 #include <limits>
+#include <numeric>
 #include <ostream>
 #include <set>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -37,6 +39,7 @@
 #include "parser.h"
 #include "snprintf.h"
 #include "support/safe_integer.h"
+#include "support/threads.h"
 
 #define err(str) fprintf(stderr, str "\n");
 #define errv(str, ...) fprintf(stderr, str "\n", __VA_ARGS__);
@@ -557,20 +560,57 @@ struct JSPrinter {
 
   Ref ast;
 
+  // If an output stream is given, the output is written to it in chunks while
+  // we print, and |buffer| only holds the part that has not been written yet.
+  // Otherwise the entire output is left in |buffer|.
+  std::ostream* out = nullptr;
+
+  // How many places are looking back at a position in the buffer, which means
+  // that we cannot write it out yet.
+  int pinned = 0;
+
+  // How much output to accumulate before writing it to the stream.
+  static const size_t FlushSize = 1 << 16;
+
+  // Whether to print sequences of functions in parallel (see printDefuns).
+  bool parallel = wasm::ThreadPool::get()->size() > 1;
+
   JSPrinter(bool pretty_, bool finalize_, Ref ast_)
     : pretty(pretty_), finalize(finalize_), ast(ast_) {}
 
+  JSPrinter(bool pretty_, bool finalize_, Ref ast_, std::ostream& out_)
+    : pretty(pretty_), finalize(finalize_), ast(ast_), out(&out_) {}
+
   ~JSPrinter() { free(buffer); }
 
+  JSPrinter(const JSPrinter&) = delete;
+  JSPrinter& operator=(const JSPrinter&) = delete;
+
   void printAst() {
     print(ast);
     ensure(1);
     buffer[used] = 0;
+    if (out) {
+      out->write(buffer, used);
+      used = 0;
+      buffer[0] = 0;
+    }
   }
 
   // Utils
 
-  void ensure(int safety = 100) {
+  // Write out the buffer if it has grown large and nothing is looking back
+  // into it. We keep the last character, as emitting may look at it.
+  void maybeFlush() {
+    if (!out || pinned || used < FlushSize) {
+      return;
+    }
+    out->write(buffer, used - 1);
+    buffer[0] = buffer[used - 1];
+    used = 1;
+  }
+
+  void ensure(size_t safety = 100) {
     if (size >= used + safety) {
       return;
     }
@@ -601,6 +641,14 @@ struct JSPrinter {
     buffer[used++] = c;
   }
 
+  // Emit output that was already printed by another printer.
+  void emitRaw(const std::string& s) {
+    ensure(s.size() + 1);
+    memcpy(buffer + used, s.data(), s.size());
+    used += s.size();
+    possibleSpace = false;
+  }
+
   void emit(const char* s) {
     maybeSpace(*s);
     int len = strlen(s);
@@ -648,6 +696,22 @@ struct JSPrinter {
 
   bool isDefun(Ref node) { return node->isArray() && node[0] == DEFUN; }
 
+  // Whether a node is a function that does not contain other functions.
+  bool isLeafDefun(Ref node) {
+    if (!isDefun(node)) {
+      return false;
+    }
+    if (node->size() > 3) {
+      Ref body = node[3];
+      for (size_t i = 0; i < body->size(); i++) {
+        if (isDefun(body[i])) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
   bool endsInBlock(Ref node) {
     if (node->isArray() && node[0] == BLOCK) {
       return true;
@@ -826,7 +890,9 @@ struct JSPrinter {
   // print a node, and if nothing is emitted, emit something instead
   void print(Ref node, const char* otherwise) {
     auto last = used;
+    pinned++;
     print(node);
+    pinned--;
     if (used == last) {
       emit(otherwise);
     }
@@ -836,6 +902,10 @@ struct JSPrinter {
     bool first = true;
     for (size_t i = 0; i < stats->size(); i++) {
       Ref curr = stats[i];
+      if (parallel && isLeafDefun(curr)) {
+        i = printDefuns(stats, i, first) - 1;
+        continue;
+      }
       if (!isNothing(curr)) {
         if (first) {
           first = false;
@@ -846,8 +916,53 @@ struct JSPrinter {
         if (!isDefun(curr) && !endsInBlock(curr) && !isIf(curr)) {
           emit(';');
         }
+        maybeFlush();
+      }
+    }
+  }
+
+  // Prints a sequence of functions in stats, starting from start, in parallel,
+  // and returns the index after the last one that was printed. The output is
+  // the same as printing them one by one, as printing a function does not look
+  // back at the output before it, and always ends with possibleSpace unset.
+  //
+  // Each function is printed into a separate buffer, so only functions that do
+  // not contain others are printed this way. A function that contains others,
+  // like the asmFunc that wasm2js emits, which contains nearly all of the
+  // output, is printed by this printer, so that its contents can be streamed
+  // to the output. What is buffered at once is then at most FlushSize plus one
+  // batch of functions.
+  size_t printDefuns(Ref stats, size_t start, bool& first) {
+    const size_t DefunsPerWorker = 64;
+    auto end = start;
+    auto maxEnd = start + wasm::ThreadPool::get()->size() * DefunsPerWorker;
+    while (end < stats->size() && end < maxEnd && isLeafDefun(stats[end])) {
+      end++;
+    }
+    if (first) {
+      first = false;
+    } else {
+      newline();
+    }
+    std::vector<std::string> printed(end - start);
+    std::vector<size_t> items(end - start);
+    std::iota(items.begin(), items.end(), 0);
+    wasm::WorkStealingQueues::run(items, [&](size_t, size_t i) {
+      JSPrinter printer(pretty, finalize, stats[start + i]);
+      printer.parallel = false;
+      printer.indent = indent;
+      printer.possibleSpace = i == 0 && possibleSpace;
+      printer.printAst();
+      printed[i].assign(printer.buffer, printer.used);
+    });
+    for (size_t i = 0; i < printed.size(); i++) {
+      if (i > 0) {
+        newline();
       }
+      emitRaw(printed[i]);
+      maybeFlush();
     }
+    return end;
   }
 
   void printToplevel(Ref node) {
@@ -1287,7 +1402,9 @@ struct JSPrinter {
         indent++;
         newline();
         auto curr = used;
+        pinned++;
         printStats(c[1]);
+        pinned--;
         indent--;
         if (curr != used) {
           newline();
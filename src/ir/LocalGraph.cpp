@@ -17,6 +17,7 @@
 #include <iterator>
 
 #include <cfg/cfg-traversal.h>
+#include <cfg/domtree.h>
 #include <ir/find_all.h>
 #include <ir/local-graph.h>
 #include <wasm-builder.h>
@@ -36,18 +37,54 @@ struct Info {
 // flow helper class. flows the gets to their sets
 
 struct Flower : public CFGWalker<Flower, Visitor<Flower>, Info> {
-  LocalGraph::GetSetses& getSetses;
   LocalGraph::Locations& locations;
 
-  Flower(LocalGraph::GetSetses& getSetses,
-         LocalGraph::Locations& locations,
-         Function* func)
-    : getSetses(getSetses), locations(locations) {
+  // This block struct is optimized for the flow process (Minimal information,
+  // iteration index).
+  struct FlowBlock {
+    // Last Traversed Iteration: This value helps us to find if this block has
+    // been seen while traversing blocks. We compare this value to the current
+    // iteration index in order to determine if we already process this block
+    // in the current iteration. This speeds up the processing compared to
+    // unordered_set or other struct usage. (No need to reset internal values,
+    // lookup into container, ...)
+    size_t lastTraversedIteration;
+    std::vector<Expression*> actions;
+    // The predecessors and successors that are reachable from the entry. Code
+    // that is not reachable never runs, so we ignore it.
+    std::vector<FlowBlock*> in;
+    std::vector<FlowBlock*> out;
+    // Sor each index, the last local.set for it
+    // The unordered_map from BasicBlock.Info is converted into a vector
+    // This speeds up search as there are usually few sets in a block, so just
+    // scanning them linearly is efficient, avoiding hash computations (while
+    // in Info, it's convenient to have a map so we can assign them easily,
+    // where the last one seen overwrites the previous; and, we do that O(1)).
+    std::vector<std::pair<Index, LocalSet*>> lastSets;
+    // The immediate dominator, or nullptr for the entry, and the blocks this
+    // one immediately dominates.
+    FlowBlock* iDom = nullptr;
+    std::vector<FlowBlock*> dominated;
+    bool reachable = false;
+  };
+
+  // Convert input blocks (basicBlocks) into more efficient flow blocks to
+  // improve memory access.
+  std::vector<FlowBlock> flowBlocks;
+  FlowBlock* entryFlowBlock = nullptr;
+
+  const size_t NULL_ITERATION = -1;
+  size_t currentIteration = 0;
+
+  // The number of local.gets we saw.
+  Index numGets = 0;
+
+  Flower(LocalGraph::Locations& locations, Function* func)
+    : locations(locations) {
     setFunction(func);
     // create the CFG by walking the IR
     CFGWalker<Flower, Visitor<Flower>, Info>::doWalkFunction(func);
-    // flow gets across blocks
-    flow(func);
+    makeFlowBlocks();
   }
 
   BasicBlock* makeBasicBlock() { return new BasicBlock(); }
@@ -62,6 +99,7 @@ struct Flower : public CFGWalker<Flower, Visitor<Flower>, Info> {
     }
     self->currBasicBlock->contents.actions.emplace_back(curr);
     self->locations[curr] = currp;
+    self->numGets++;
   }
 
   static void doVisitLocalSet(Flower* self, Expression** currp) {
@@ -75,152 +113,304 @@ struct Flower : public CFGWalker<Flower, Visitor<Flower>, Info> {
     self->locations[curr] = currp;
   }
 
-  void flow(Function* func) {
-    // This block struct is optimized for this flow process (Minimal
-    // information, iteration index).
-    struct FlowBlock {
-      // Last Traversed Iteration: This value helps us to find if this block has
-      // been seen while traversing blocks. We compare this value to the current
-      // iteration index in order to determine if we already process this block
-      // in the current iteration. This speeds up the processing compared to
-      // unordered_set or other struct usage. (No need to reset internal values,
-      // lookup into container, ...)
-      size_t lastTraversedIteration;
-      std::vector<Expression*> actions;
-      std::vector<FlowBlock*> in;
-      // Sor each index, the last local.set for it
-      // The unordered_map from BasicBlock.Info is converted into a vector
-      // This speeds up search as there are usually few sets in a block, so just
-      // scanning them linearly is efficient, avoiding hash computations (while
-      // in Info, it's convenient to have a map so we can assign them easily,
-      // where the last one seen overwrites the previous; and, we do that O(1)).
-      std::vector<std::pair<Index, LocalSet*>> lastSets;
-    };
+  void makeFlowBlocks() {
+    // The blocks are in reverse postorder, with the entry first, as DomTree
+    // expects.
+    DomTree<BasicBlock> domTree(basicBlocks);
+    assert(basicBlocks[0].get() == entry && entry->in.empty());
 
-    auto numLocals = func->getNumLocals();
-    std::vector<std::vector<LocalGet*>> allGets;
-    allGets.resize(numLocals);
-    std::vector<FlowBlock*> work;
-
-    // Convert input blocks (basicBlocks) into more efficient flow blocks to
-    // improve memory access.
-    std::vector<FlowBlock> flowBlocks;
     flowBlocks.resize(basicBlocks.size());
+    entryFlowBlock = &flowBlocks[0];
 
     // Init mapping between basicblocks and flowBlocks
     std::unordered_map<BasicBlock*, FlowBlock*> basicToFlowMap;
     for (Index i = 0; i < basicBlocks.size(); ++i) {
       basicToFlowMap[basicBlocks[i].get()] = &flowBlocks[i];
+      flowBlocks[i].reachable = i == 0 || domTree.iDoms[i] != domTree.nonsense;
     }
 
-    const size_t NULL_ITERATION = -1;
-
-    FlowBlock* entryFlowBlock = nullptr;
     for (Index i = 0; i < flowBlocks.size(); ++i) {
       auto& block = basicBlocks[i];
       auto& flowBlock = flowBlocks[i];
-      // Get the equivalent block to entry in the flow list
-      if (block.get() == entry) {
-        entryFlowBlock = &flowBlock;
-      }
       flowBlock.lastTraversedIteration = NULL_ITERATION;
+      if (!flowBlock.reachable) {
+        continue;
+      }
+      if (i > 0) {
+        flowBlock.iDom = &flowBlocks[domTree.iDoms[i]];
+        flowBlock.iDom->dominated.push_back(&flowBlock);
+      }
       flowBlock.actions.swap(block->contents.actions);
       // Map in block to flow blocks
-      auto& in = block->in;
-      flowBlock.in.resize(in.size());
-      std::transform(in.begin(),
-                     in.end(),
-                     flowBlock.in.begin(),
-                     [&](BasicBlock* block) { return basicToFlowMap[block]; });
+      for (auto* pred : block->in) {
+        auto* flowPred = basicToFlowMap[pred];
+        if (flowPred->reachable) {
+          flowBlock.in.push_back(flowPred);
+          flowPred->out.push_back(&flowBlock);
+        }
+      }
       // Convert unordered_map to vector.
       flowBlock.lastSets.reserve(block->contents.lastSets.size());
       for (auto set : block->contents.lastSets) {
         flowBlock.lastSets.emplace_back(set);
       }
     }
-    assert(entryFlowBlock != nullptr);
+    // We have everything we need in the flow blocks now.
+    basicBlocks.clear();
+  }
 
-    size_t currentIteration = 0;
+  // Flows back from the start of a block, calling apply() on each set of a
+  // local index that reaches there, or nullptr for the initial value.
+  template<typename T> void flowBack(FlowBlock* block, Index index, T apply) {
+    std::vector<FlowBlock*> work;
+    work.push_back(block);
+    // Note that we may need to revisit the later parts of this initial
+    // block, if we are in a loop, so don't mark it as seen.
+    while (!work.empty()) {
+      auto* curr = work.back();
+      work.pop_back();
+      // We have gone through this block; now we must handle flowing to
+      // the inputs.
+      if (curr == entryFlowBlock) {
+        // These receive a param or zero init value.
+        apply(nullptr);
+        continue;
+      }
+      for (auto* pred : curr->in) {
+        if (pred->lastTraversedIteration == currentIteration) {
+          // We've already seen pred in this iteration.
+          continue;
+        }
+        pred->lastTraversedIteration = currentIteration;
+        auto lastSet =
+          std::find_if(pred->lastSets.begin(),
+                       pred->lastSets.end(),
+                       [&](std::pair<Index, LocalSet*>& value) {
+                         return value.first == index;
+                       });
+        if (lastSet != pred->lastSets.end()) {
+          // There is a set here, apply it, and stop the flow.
+          apply(lastSet->second);
+        } else {
+          // Keep on flowing.
+          work.push_back(pred);
+        }
+      }
+    }
+    currentIteration++;
+  }
+
+  // Computes the sets of all the gets at once. Flowing each get back by itself
+  // takes time proportional to the number of gets times the number of blocks,
+  // which is too slow on big functions. Instead, we find the blocks where the
+  // values of a local merge, as when constructing SSA form, and rename along
+  // the dominator tree, which takes close to linear time.
+  void flow(Function* func, LocalGraph::GetSetses& getSetses) {
+    getSetses.reserve(numGets);
+
+    auto numLocals = func->getNumLocals();
+    auto numBlocks = flowBlocks.size();
+    auto getIndex = [&](FlowBlock* block) { return block - &flowBlocks[0]; };
+
+    // The dominance frontier of each block: the blocks it can reach that it
+    // does not strictly dominate, which is where the values it sets merge with
+    // others.
+    std::vector<std::vector<FlowBlock*>> frontiers(numBlocks);
     for (auto& block : flowBlocks) {
-#ifdef LOCAL_GRAPH_DEBUG
-      std::cout << "basic block " << block.get() << " :\n";
-      for (auto& action : block->contents.actions) {
-        std::cout << "  action: " << *action << '\n';
+      if (block.in.size() < 2) {
+        continue;
       }
-      for (auto* lastSet : block->contents.lastSets) {
-        std::cout << "  last set " << lastSet << '\n';
+      for (auto* pred : block.in) {
+        for (auto* curr = pred; curr != block.iDom; curr = curr->iDom) {
+          auto& frontier = frontiers[getIndex(curr)];
+          if (!frontier.empty() && frontier.back() == &block) {
+            break;
+          }
+          frontier.push_back(&block);
+        }
       }
-#endif
-      // go through the block, finding each get and adding it to its index,
-      // and seeing how sets affect that
-      auto& actions = block.actions;
-      // move towards the front, handling things as we go
-      for (int i = int(actions.size()) - 1; i >= 0; i--) {
-        auto* action = actions[i];
+    }
+
+    // A value that reaches a point: a set, nullptr for the initial value, or a
+    // merge (a phi) at the start of a block.
+    struct Value {
+      LocalSet* set = nullptr;
+      Index phi = Index(-1);
+    };
+    struct Phi {
+      Index index;
+      std::vector<Value> values;
+      // The sets that reach the phi, once we compute them.
+      std::optional<LocalGraph::Sets> sets;
+    };
+    std::vector<Phi> phis;
+    std::vector<std::vector<Index>> blockPhis(numBlocks);
+
+    // Place phis in the iterated dominance frontier of the blocks that set
+    // each local.
+    std::vector<std::vector<FlowBlock*>> setBlocks(numLocals);
+    for (auto& block : flowBlocks) {
+      for (auto& [index, _] : block.lastSets) {
+        setBlocks[index].push_back(&block);
+      }
+    }
+    // For each block, the last local whose work list or phis it was added to.
+    std::vector<Index> queuedFor(numBlocks, Index(-1));
+    std::vector<Index> phiFor(numBlocks, Index(-1));
+    for (Index index = 0; index < numLocals; index++) {
+      auto& work = setBlocks[index];
+      for (auto* block : work) {
+        queuedFor[getIndex(block)] = index;
+      }
+      while (!work.empty()) {
+        auto* block = work.back();
+        work.pop_back();
+        for (auto* merge : frontiers[getIndex(block)]) {
+          auto mergeIndex = getIndex(merge);
+          if (phiFor[mergeIndex] == index) {
+            continue;
+          }
+          phiFor[mergeIndex] = index;
+          blockPhis[mergeIndex].push_back(phis.size());
+          phis.push_back({index, {}, {}});
+          if (queuedFor[mergeIndex] != index) {
+            queuedFor[mergeIndex] = index;
+            work.push_back(merge);
+          }
+        }
+      }
+    }
+
+    // Walk the dominator tree, keeping a stack of the values of each local, to
+    // find the value each get reads and the values that reach each phi.
+    std::vector<std::vector<Value>> stacks(numLocals);
+    auto getValue = [&](Index index) {
+      auto& stack = stacks[index];
+      return stack.empty() ? Value() : stack.back();
+    };
+    std::vector<std::pair<LocalGet*, Index>> phiGets;
+    // The locals we pushed values for, to pop them when we leave a block.
+    std::vector<Index> pushed;
+    struct Task {
+      FlowBlock* block;
+      // Where the block's pushes start, once we entered it.
+      size_t pushedStart = size_t(-1);
+    };
+    std::vector<Task> tasks;
+    tasks.push_back({entryFlowBlock});
+    while (!tasks.empty()) {
+      auto& task = tasks.back();
+      if (task.pushedStart != size_t(-1)) {
+        // We are done with this block and the blocks it dominates.
+        for (auto i = pushed.size(); i > task.pushedStart; i--) {
+          stacks[pushed[i - 1]].pop_back();
+        }
+        pushed.resize(task.pushedStart);
+        tasks.pop_back();
+        continue;
+      }
+      task.pushedStart = pushed.size();
+      auto* block = task.block;
+      for (auto phi : blockPhis[getIndex(block)]) {
+        auto index = phis[phi].index;
+        stacks[index].push_back({nullptr, phi});
+        pushed.push_back(index);
+      }
+      for (auto* action : block->actions) {
         if (auto* get = action->dynCast<LocalGet>()) {
-          allGets[get->index].push_back(get);
+          auto value = getValue(get->index);
+          if (value.phi == Index(-1)) {
+            getSetses[get].insert(value.set);
+          } else {
+            phiGets.emplace_back(get, value.phi);
+          }
         } else {
-          // This set is the only set for all those gets.
           auto* set = action->cast<LocalSet>();
-          auto& gets = allGets[set->index];
-          for (auto* get : gets) {
-            getSetses[get].insert(set);
-          }
-          gets.clear();
+          stacks[set->index].push_back({set});
+          pushed.push_back(set->index);
+        }
+      }
+      for (auto* succ : block->out) {
+        for (auto phi : blockPhis[getIndex(succ)]) {
+          phis[phi].values.push_back(getValue(phis[phi].index));
         }
       }
-      // If anything is left, we must flow it back through other blocks. we
-      // can do that for all gets as a whole, they will get the same results.
-      for (Index index = 0; index < numLocals; index++) {
-        auto& gets = allGets[index];
-        if (gets.empty()) {
+      // Note that this invalidates |task|.
+      for (auto* dominated : block->dominated) {
+        tasks.push_back({dominated});
+      }
+    }
+
+    // Find the sets that reach each phi that a get reads, by flowing back
+    // through the phis it merges.
+    std::vector<Index> seen(phis.size(), Index(-1));
+    auto getPhiSets = [&](Index root) -> LocalGraph::Sets& {
+      auto& rootPhi = phis[root];
+      if (rootPhi.sets) {
+        return *rootPhi.sets;
+      }
+      LocalGraph::Sets sets;
+      std::vector<Index> work = {root};
+      seen[root] = root;
+      while (!work.empty()) {
+        auto& phi = phis[work.back()];
+        work.pop_back();
+        if (phi.sets) {
+          for (auto* set : *phi.sets) {
+            sets.insert(set);
+          }
           continue;
         }
-        work.push_back(&block);
-        // Note that we may need to revisit the later parts of this initial
-        // block, if we are in a loop, so don't mark it as seen.
-        while (!work.empty()) {
-          auto* curr = work.back();
-          work.pop_back();
-          // We have gone through this block; now we must handle flowing to
-          // the inputs.
-          if (curr->in.empty()) {
-            if (curr == entryFlowBlock) {
-              // These receive a param or zero init value.
-              for (auto* get : gets) {
-                getSetses[get].insert(nullptr);
-              }
-            }
-          } else {
-            for (auto* pred : curr->in) {
-              if (pred->lastTraversedIteration == currentIteration) {
-                // We've already seen pred in this iteration.
-                continue;
-              }
-              pred->lastTraversedIteration = currentIteration;
-              auto lastSet =
-                std::find_if(pred->lastSets.begin(),
-                             pred->lastSets.end(),
-                             [&](std::pair<Index, LocalSet*>& value) {
-                               return value.first == index;
-                             });
-              if (lastSet != pred->lastSets.end()) {
-                // There is a set here, apply it, and stop the flow.
-                for (auto* get : gets) {
-                  getSetses[get].insert(lastSet->second);
-                }
-              } else {
-                // Keep on flowing.
-                work.push_back(pred);
-              }
-            }
+        for (auto value : phi.values) {
+          if (value.phi == Index(-1)) {
+            sets.insert(value.set);
+          } else if (seen[value.phi] != root) {
+            seen[value.phi] = root;
+            work.push_back(value.phi);
           }
         }
-        gets.clear();
-        currentIteration++;
+      }
+      rootPhi.sets = std::move(sets);
+      return *rootPhi.sets;
+    };
+    for (auto& [get, phi] : phiGets) {
+      getSetses[get] = getPhiSets(phi);
+    }
+  }
+
+  // Where each get is, for computing the sets of a single get: its block and
+  // its position in the block's actions.
+  std::unordered_map<LocalGet*, std::pair<FlowBlock*, Index>> getPositions;
+
+  void computeGetPositions() {
+    getPositions.reserve(numGets);
+    for (auto& block : flowBlocks) {
+      for (Index i = 0; i < block.actions.size(); i++) {
+        if (auto* get = block.actions[i]->dynCast<LocalGet>()) {
+          getPositions[get] = {&block, i};
+        }
       }
     }
   }
+
+  void flowGet(LocalGet* get, LocalGraph::Sets& sets) {
+    auto iter = getPositions.find(get);
+    if (iter == getPositions.end()) {
+      // This get is in unreachable code.
+      return;
+    }
+    auto [block, position] = iter->second;
+    // A set earlier in the block is the only set for this get.
+    for (Index i = position; i > 0; i--) {
+      if (auto* set = block->actions[i - 1]->dynCast<LocalSet>()) {
+        if (set->index == get->index) {
+          sets.insert(set);
+          return;
+        }
+      }
+    }
+    flowBack(block, get->index, [&](LocalSet* set) { sets.insert(set); });
+  }
 };
 
 } // namespace LocalGraphInternal
@@ -228,7 +418,8 @@ struct Flower : public CFGWalker<Flower, Visitor<Flower>, Info> {
 // LocalGraph implementation
 
 LocalGraph::LocalGraph(Function* func) : func(func) {
-  LocalGraphInternal::Flower flower(getSetses, locations, func);
+  LocalGraphInternal::Flower flower(locations, func);
+  flower.flow(func, getSetses);
 
 #ifdef LOCAL_GRAPH_DEBUG
   std::cout << "LocalGraph::dump\n";
@@ -326,4 +517,23 @@ void LocalGraph::computeSSAIndexes() {
 
 bool LocalGraph::isSSA(Index x) { return SSAIndexes.count(x); }
 
+// LazyLocalGraph implementation
+
+LazyLocalGraph::LazyLocalGraph(Function* func)
+  : flower(std::make_unique<LocalGraphInternal::Flower>(locations, func)) {
+  flower->computeGetPositions();
+}
+
+LazyLocalGraph::~LazyLocalGraph() = default;
+
+const LocalGraph::Sets& LazyLocalGraph::getSets(LocalGet* get) {
+  auto iter = getSetses.find(get);
+  if (iter != getSetses.end()) {
+    return iter->second;
+  }
+  auto& sets = getSetses[get];
+  flower->flowGet(get, sets);
+  return sets;
+}
+
 } // namespace wasm
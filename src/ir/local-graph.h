@@ -22,6 +22,10 @@
 
 namespace wasm {
 
+namespace LocalGraphInternal {
+struct Flower;
+} // namespace LocalGraphInternal
+
 //
 // Finds the connections between local.gets and local.sets, creating
 // a graph of those ties. This is useful for "ssa-style" optimization,
@@ -30,6 +34,9 @@ namespace wasm {
 // (see the SSA pass for actually creating new local indexes based
 // on this).
 //
+// Code that cannot be reached from the function entry never runs, so it is
+// ignored: gets there have no sets, and sets there reach no gets.
+//
 struct LocalGraph {
   // main API
 
@@ -43,7 +50,7 @@ struct LocalGraph {
 
   using GetSetses = std::unordered_map<LocalGet*, Sets>;
 
-  using Locations = std::map<Expression*, Expression**>;
+  using Locations = std::unordered_map<Expression*, Expression**>;
 
   // externally useful information
   GetSetses getSetses; // the sets affecting each get. a nullptr set means the
@@ -102,6 +109,26 @@ private:
   std::set<Index> SSAIndexes;
 };
 
+// A LocalGraph that only computes the sets of a get when it is asked about
+// that get. This is much faster than computing them all when a pass only cares
+// about some of the gets, for example those of a few of the locals, in a
+// function with many locals.
+struct LazyLocalGraph {
+  LazyLocalGraph(Function* func);
+  ~LazyLocalGraph();
+
+  // The sets affecting a get, as in LocalGraph::getSetses. A get in
+  // unreachable code has none.
+  const LocalGraph::Sets& getSets(LocalGet* get);
+
+  // Where each get and set is, as in LocalGraph.
+  LocalGraph::Locations locations;
+
+private:
+  std::unique_ptr<LocalGraphInternal::Flower> flower;
+  LocalGraph::GetSetses getSetses;
+};
+
 } // namespace wasm
 
 #endif // wasm_ir_local_graph_h
@@ -15,6 +15,7 @@
  */
 
 #include <optional>
+#include <queue>
 #include <variant>
 
 #include "ir/branch-utils.h"
@@ -23,10 +24,8 @@
 #include "ir/possible-contents.h"
 #include "wasm.h"
 
-#ifdef POSSIBLE_CONTENTS_INSERT_ORDERED
-// Use an insert-ordered set for easier debugging with deterministic queue
-// ordering.
-#include "support/insert_ordered.h"
+#ifdef POSSIBLE_CONTENTS_DEBUG
+#include <chrono>
 #endif
 
 namespace std {
@@ -165,6 +164,10 @@ template<typename T> struct Link {
   bool operator==(const Link<T>& other) const {
     return from == other.from && to == other.to;
   }
+
+  bool operator<(const Link<T>& other) const {
+    return std::tie(from, to) < std::tie(other.from, other.to);
+  }
 };
 
 using LocationLink = Link<Location>;
@@ -927,7 +930,16 @@ struct Flower {
     //       target (an expression has one parent)
     std::vector<LocationIndex> targets;
 
-    LocationInfo(Location location) : location(location) {}
+    // The position of this location in a topological sort of the strongly
+    // connected components of the graph, which is the order in which the flow
+    // prefers to process it. See computeRanks().
+    Index rank;
+
+    // Whether this location is in the work queue.
+    bool queued = false;
+
+    LocationInfo(Location location, Index rank)
+      : location(location), rank(rank) {}
   };
 
   // Maps location indexes to the info stored there, as just described above.
@@ -972,7 +984,7 @@ private:
       // in the binary, and we don't have 4GB wasm binaries yet... do we?
       Fatal() << "Too many locations for 32 bits";
     }
-    locations.emplace_back(location);
+    locations.emplace_back(location, nextRank);
     locationIndexes[location] = index;
 
     return index;
@@ -993,8 +1005,17 @@ private:
   // The work remaining to do during the flow: locations that we need to flow
   // content from, after new content reached them.
   //
-  // Using a set here is efficient as multiple updates may arrive to a location
-  // before we get to processing it.
+  // Each location is in the queue at most once (see LocationInfo::queued), as
+  // multiple updates may arrive to a location before we get to processing it.
+  // Locations are processed in order of their rank, which means that the flow
+  // goes through the condensed graph in topological order: we reach a location
+  // after the locations that send it content have been processed, and flow out
+  // its combined contents once, instead of flowing each partial update.
+  // Locations in the same strongly connected component share a rank, and are
+  // iterated on in order of their indexes until they stabilize. (The order
+  // does not affect the final result, only how much work it takes to get
+  // there; in particular links that are added during the flow can break the
+  // topological order, which is fine.)
   //
   // The items here could be {location, newContents}, but it is more efficient
   // to have already written the new contents to the main data structure. That
@@ -1002,15 +1023,30 @@ private:
   // possible is helpful as anything reading them meanwhile (before we get to
   // their work item in the queue) will see the newer value, possibly avoiding
   // flowing an old value that would later be overwritten.
-#ifdef POSSIBLE_CONTENTS_INSERT_ORDERED
-  InsertOrderedSet<LocationIndex> workQueue;
-#else
-  std::unordered_set<LocationIndex> workQueue;
-#endif
+  using WorkItem = std::pair<Index, LocationIndex>;
+  std::priority_queue<WorkItem, std::vector<WorkItem>, std::greater<WorkItem>>
+    workQueue;
 
-  // All existing links in the graph. We keep this to know when a link we want
-  // to add is new or not.
-  std::unordered_set<IndexLink> links;
+  // All existing links in the graph, which we need to know when a link we want
+  // to add is new or not. The links we find before the flow are the vast
+  // majority, and are kept sorted in a flat vector; the ones added during the
+  // flow are in a set.
+  std::vector<IndexLink> links;
+  std::unordered_set<IndexLink> newLinks;
+
+  bool hasLink(const IndexLink& link) {
+    return std::binary_search(links.begin(), links.end(), link) ||
+           newLinks.count(link);
+  }
+
+  // The rank given to new locations. Before the ranks are computed this does
+  // not matter; after that, locations created during the flow are placed after
+  // all the others.
+  Index nextRank = 0;
+
+  // Compute the rank of each location from the graph of links. See
+  // LocationInfo::rank.
+  void computeRanks();
 
   // Update a location with new contents that are added to everything already
   // present there. If the update changes the contents at that location (if
@@ -1079,6 +1115,19 @@ private:
 
 Flower::Flower(Module& wasm) : wasm(wasm) {
 #ifdef POSSIBLE_CONTENTS_DEBUG
+  // Print the time each phase takes when it ends, and the name of the next
+  // phase.
+  auto phaseStart = std::chrono::steady_clock::now();
+  auto nextPhase = [&](const char* name) {
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> duration = now - phaseStart;
+    phaseStart = now;
+    std::cout << "  (" << duration.count() << " seconds, " << locations.size()
+              << " locations, " << links.size() << " links)\n";
+    if (name) {
+      std::cout << name << " phase\n";
+    }
+  };
   std::cout << "parallel phase\n";
 #endif
 
@@ -1099,7 +1148,7 @@ Flower::Flower(Module& wasm) : wasm(wasm) {
     });
 
 #ifdef POSSIBLE_CONTENTS_DEBUG
-  std::cout << "single phase\n";
+  nextPhase("single");
 #endif
 
   // Also walk the global module code (for simplicity, also add it to the
@@ -1128,24 +1177,33 @@ Flower::Flower(Module& wasm) : wasm(wasm) {
   // go.
 
 #ifdef POSSIBLE_CONTENTS_DEBUG
-  std::cout << "merging+indexing phase\n";
+  nextPhase("merging+indexing");
 #endif
 
   // The merged roots. (Note that all other forms of merged data are declared at
   // the class level, since we need them during the flow, but the roots are only
   // needed to start the flow, so we can declare them here.)
-  std::unordered_map<Location, PossibleContents> roots;
+  std::unordered_map<LocationIndex, PossibleContents> roots;
+
+  // Reserve space ahead of time, to avoid repeated rehashing of the (large)
+  // map of locations. Most locations appear in at least one link, and links
+  // often share locations, so the number of links is a reasonable estimate.
+  size_t numLinks = 0;
+  for (auto& [func, info] : analysis.map) {
+    numLinks += info.links.size();
+  }
+  links.reserve(numLinks);
+  locationIndexes.reserve(numLinks);
+  locations.reserve(numLinks);
 
   for (auto& [func, info] : analysis.map) {
     for (auto& link : info.links) {
-      links.insert(getIndexes(link));
+      links.push_back(getIndexes(link));
     }
     for (auto& [root, value] : info.roots) {
-      roots[root] = value;
-
-      // Ensure an index even for a root with no links to it - everything needs
-      // an index.
-      getIndex(root);
+      // Note that this also ensures an index even for a root with no links to
+      // it - everything needs an index.
+      roots[getIndex(root)] = value;
     }
     for (auto [child, parent] : info.childParents) {
       // In practice we do not have any childParent connections with a tuple;
@@ -1160,7 +1218,7 @@ Flower::Flower(Module& wasm) : wasm(wasm) {
   analysis.map.clear();
 
 #ifdef POSSIBLE_CONTENTS_DEBUG
-  std::cout << "external phase\n";
+  nextPhase("external");
 #endif
 
   // Parameters of exported functions are roots, since exports can have callers
@@ -1168,7 +1226,7 @@ Flower::Flower(Module& wasm) : wasm(wasm) {
   auto calledFromOutside = [&](Name funcName) {
     auto* func = wasm.getFunction(funcName);
     for (Index i = 0; i < func->getParams().size(); i++) {
-      roots[LocalLocation{func, i, 0}] = PossibleContents::many();
+      roots[getIndex(LocalLocation{func, i, 0})] = PossibleContents::many();
     }
   };
 
@@ -1199,7 +1257,7 @@ Flower::Flower(Module& wasm) : wasm(wasm) {
   }
 
 #ifdef POSSIBLE_CONTENTS_DEBUG
-  std::cout << "func phase\n";
+  nextPhase("func");
 #endif
 
   // Connect function parameters to their signature, so that any indirect call
@@ -1207,17 +1265,17 @@ Flower::Flower(Module& wasm) : wasm(wasm) {
   // TODO: find which functions are even taken by reference
   for (auto& func : wasm.functions) {
     for (Index i = 0; i < func->getParams().size(); i++) {
-      links.insert(getIndexes({SignatureParamLocation{func->type, i},
-                               LocalLocation{func.get(), i, 0}}));
+      links.push_back(getIndexes({SignatureParamLocation{func->type, i},
+                                  LocalLocation{func.get(), i, 0}}));
     }
     for (Index i = 0; i < func->getResults().size(); i++) {
-      links.insert(getIndexes({ResultLocation{func.get(), i},
-                               SignatureResultLocation{func->type, i}}));
+      links.push_back(getIndexes({ResultLocation{func.get(), i},
+                                  SignatureResultLocation{func->type, i}}));
     }
   }
 
 #ifdef POSSIBLE_CONTENTS_DEBUG
-  std::cout << "struct phase\n";
+  nextPhase("struct");
 #endif
 
   if (getTypeSystem() == TypeSystem::Nominal ||
@@ -1226,11 +1284,15 @@ Flower::Flower(Module& wasm) : wasm(wasm) {
   }
 
 #ifdef POSSIBLE_CONTENTS_DEBUG
-  std::cout << "Link-targets phase\n";
+  nextPhase("Link-targets");
 #endif
 
-  // Add all links to the targets vectors of the source locations, which we will
-  // use during the flow.
+  // Deduplicate the links, and add them to the targets vectors of the source
+  // locations, which we will use during the flow. Sorting the links also means
+  // that we fill in the targets in order, and that the targets of each location
+  // are sorted, which makes the accesses during the flow more local.
+  std::sort(links.begin(), links.end());
+  links.erase(std::unique(links.begin(), links.end()), links.end());
   for (auto& link : links) {
     getTargets(link.from).push_back(link.to);
   }
@@ -1244,24 +1306,30 @@ Flower::Flower(Module& wasm) : wasm(wasm) {
 #endif
 
 #ifdef POSSIBLE_CONTENTS_DEBUG
-  std::cout << "roots phase\n";
+  nextPhase("ranks");
+#endif
+
+  computeRanks();
+
+#ifdef POSSIBLE_CONTENTS_DEBUG
+  nextPhase("roots");
 #endif
 
   // Set up the roots, which are the starting state for the flow analysis: send
   // their initial content to them to start the flow.
-  for (const auto& [location, value] : roots) {
+  for (const auto& [locationIndex, value] : roots) {
 #if defined(POSSIBLE_CONTENTS_DEBUG) && POSSIBLE_CONTENTS_DEBUG >= 2
     std::cout << "  init root\n";
-    dump(location);
+    dump(getLocation(locationIndex));
     value.dump(std::cout, &wasm);
     std::cout << '\n';
 #endif
 
-    updateContents(location, value);
+    updateContents(locationIndex, value);
   }
 
 #ifdef POSSIBLE_CONTENTS_DEBUG
-  std::cout << "flow phase\n";
+  nextPhase("flow");
   size_t iters = 0;
 #endif
 
@@ -1270,17 +1338,22 @@ Flower::Flower(Module& wasm) : wasm(wasm) {
 #ifdef POSSIBLE_CONTENTS_DEBUG
     iters++;
     if ((iters & 255) == 0) {
-      std::cout << iters++ << " iters, work left: " << workQueue.size() << '\n';
+      std::cout << iters << " iters, work left: " << workQueue.size() << '\n';
     }
 #endif
 
-    auto iter = workQueue.begin();
-    auto locationIndex = *iter;
-    workQueue.erase(iter);
+    auto locationIndex = workQueue.top().second;
+    workQueue.pop();
+    locations[locationIndex].queued = false;
 
     flowAfterUpdate(locationIndex);
   }
 
+#ifdef POSSIBLE_CONTENTS_DEBUG
+  std::cout << iters << " iters\n";
+  nextPhase(nullptr);
+#endif
+
   // TODO: Add analysis and retrieval logic for fields of immutable globals,
   //       including multiple levels of depth (necessary for itables in j2wasm).
 }
@@ -1349,7 +1422,11 @@ bool Flower::updateContents(LocationIndex locationIndex,
 #endif
 
   // Add a work item if there isn't already.
-  workQueue.insert(locationIndex);
+  auto& info = locations[locationIndex];
+  if (!info.queued) {
+    info.queued = true;
+    workQueue.push({info.rank, locationIndex});
+  }
 
   return worthSendingMore;
 }
@@ -1449,12 +1526,82 @@ void Flower::flowToTargetsAfterUpdate(LocationIndex locationIndex,
   }
 }
 
+void Flower::computeRanks() {
+  // Find the strongly connected components using Tarjan's algorithm, with an
+  // explicit stack as the graph can be very deep.
+  const Index Unvisited = -1;
+  auto numLocations = locations.size();
+  std::vector<Index> visitIndexes(numLocations, Unvisited);
+  std::vector<Index> lowLinks(numLocations);
+  std::vector<bool> onStack(numLocations);
+  // The locations visited but not yet assigned to a component.
+  std::vector<LocationIndex> stack;
+  // The locations we are in the middle of visiting, each with the index of the
+  // next target to look at.
+  std::vector<std::pair<LocationIndex, Index>> work;
+  Index nextVisitIndex = 0;
+  Index numComponents = 0;
+
+  auto visit = [&](LocationIndex index) {
+    visitIndexes[index] = lowLinks[index] = nextVisitIndex++;
+    stack.push_back(index);
+    onStack[index] = true;
+    work.push_back({index, 0});
+  };
+
+  for (LocationIndex root = 0; root < numLocations; root++) {
+    if (visitIndexes[root] != Unvisited) {
+      continue;
+    }
+    visit(root);
+    while (!work.empty()) {
+      auto [index, nextTarget] = work.back();
+      auto& targets = getTargets(index);
+      if (nextTarget < targets.size()) {
+        work.back().second++;
+        auto target = targets[nextTarget];
+        if (visitIndexes[target] == Unvisited) {
+          visit(target);
+        } else if (onStack[target]) {
+          lowLinks[index] = std::min(lowLinks[index], visitIndexes[target]);
+        }
+        continue;
+      }
+
+      // We are done with this location.
+      work.pop_back();
+      if (!work.empty()) {
+        auto parent = work.back().first;
+        lowLinks[parent] = std::min(lowLinks[parent], lowLinks[index]);
+      }
+      if (lowLinks[index] == visitIndexes[index]) {
+        // This is the root of a component, whose members are everything on the
+        // stack from it and onwards.
+        LocationIndex member;
+        do {
+          member = stack.back();
+          stack.pop_back();
+          onStack[member] = false;
+          locations[member].rank = numComponents;
+        } while (member != index);
+        numComponents++;
+      }
+    }
+  }
+
+  // Tarjan's algorithm finds the components in reverse topological order.
+  for (auto& info : locations) {
+    info.rank = numComponents - 1 - info.rank;
+  }
+  nextRank = numComponents;
+}
+
 void Flower::connectDuringFlow(Location from, Location to) {
   auto newLink = LocationLink{from, to};
   auto newIndexLink = getIndexes(newLink);
-  if (links.count(newIndexLink) == 0) {
+  if (!hasLink(newIndexLink)) {
     // This is a new link. Add it to the known links.
-    links.insert(newIndexLink);
+    newLinks.insert(newIndexLink);
 
     // Add it to the |targets| vector.
     auto& targets = getTargets(newIndexLink.from);
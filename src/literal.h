@@ -18,7 +18,9 @@
 #define wasm_literal_h
 
 #include <array>
+#include <cstring>
 #include <iostream>
+#include <type_traits>
 #include <variant>
 
 #include "compiler-support.h"
@@ -97,9 +99,29 @@ public:
   explicit Literal(Name func, Type type) : func(func), type(type) {}
   explicit Literal(std::shared_ptr<GCData> gcData, Type type);
   explicit Literal(std::unique_ptr<RttSupers>&& rttSupers, Type type);
-  Literal(const Literal& other);
+  // Copying, moving and destroying are hot in the interpreter, so the common
+  // case of a basic type, which owns nothing, is handled inline.
+  Literal(const Literal& other) : type(other.type) {
+    if (type.isBasic()) {
+      copyBasic(other);
+    } else {
+      copyNonBasic(other);
+    }
+  }
+  Literal(Literal&& other) noexcept : type(other.type) {
+    if (type.isBasic()) {
+      copyBasic(other);
+    } else {
+      moveNonBasic(std::move(other));
+    }
+  }
   Literal& operator=(const Literal& other);
-  ~Literal();
+  Literal& operator=(Literal&& other) noexcept;
+  ~Literal() {
+    if (!type.isBasic()) {
+      destroyNonBasic();
+    }
+  }
 
   bool isConcrete() const { return type.isConcrete(); }
   bool isNone() const { return type == Type::none; }
@@ -271,10 +293,10 @@ public:
   // canonical RTT reflects the static supertype chain.
   static Literal makeCanonicalRtt(HeapType type);
 
-  Literal castToF32();
-  Literal castToF64();
-  Literal castToI32();
-  Literal castToI64();
+  Literal castToF32() const;
+  Literal castToF64() const;
+  Literal castToI32() const;
+  Literal castToI64() const;
 
   int32_t geti32() const {
     assert(type == Type::i32);
@@ -672,6 +694,28 @@ public:
   bool isSubRtt(const Literal& other) const;
 
 private:
+  void copyBasic(const Literal& other) {
+    switch (type.getBasic()) {
+      case Type::i32:
+      case Type::f32:
+        i32 = other.i32;
+        break;
+      case Type::i64:
+      case Type::f64:
+        i64 = other.i64;
+        break;
+      case Type::v128:
+        memcpy(&v128, other.v128, 16);
+        break;
+      case Type::none:
+      case Type::unreachable:
+        break;
+    }
+  }
+  void copyNonBasic(const Literal& other);
+  void moveNonBasic(Literal&& other) noexcept;
+  void destroyNonBasic();
+
   Literal addSatSI8(const Literal& other) const;
   Literal addSatUI8(const Literal& other) const;
   Literal addSatSI16(const Literal& other) const;
@@ -688,6 +732,11 @@ private:
   Literal avgrUInt(const Literal& other) const;
 };
 
+// Containers of literals, like Literals and the interpreter's value stack,
+// only move their elements when growing if moving cannot throw.
+static_assert(std::is_nothrow_move_constructible_v<Literal>);
+static_assert(std::is_nothrow_move_assignable_v<Literal>);
+
 class Literals : public SmallVector<Literal, 1> {
 public:
   Literals() = default;
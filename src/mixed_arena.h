@@ -19,10 +19,12 @@
 
 #include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <thread>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <support/alloc.h>
@@ -55,7 +57,9 @@
 // in a side arena for that other thread. This is done in a transparent
 // way to the outside; as a result, it is always safe to allocate using
 // a MixedArena, no matter which thread you are on. Allocations will
-// of course be fastest on the original thread for the arena.
+// of course be fastest on the original thread for the arena. Each thread
+// caches the side arena it used last, so it does not need to look for it
+// on every allocation.
 //
 
 struct MixedArena {
@@ -77,17 +81,81 @@ struct MixedArena {
   // list of next, adding an allocator if necessary
   std::atomic<MixedArena*> next;
 
+  // A unique id for this arena. Unlike its address, this is never reused by
+  // a later arena, so it can identify the arena in the thread-local cache.
+  uint64_t id;
+
+  // Statistics for this arena (not including the side arenas in next).
+  size_t chunkBytes = 0;
+  size_t allocatedBytes = 0;
+
   MixedArena() {
+    static std::atomic<uint64_t> nextId(0);
+    id = nextId++;
     threadId = std::this_thread::get_id();
     next.store(nullptr);
   }
 
+  struct Stats {
+    // The number of arenas, that is, the main one and the side arenas of the
+    // other threads that allocated in it.
+    size_t arenas = 0;
+    size_t chunks = 0;
+    size_t chunkBytes = 0;
+    // The bytes that were asked for.
+    size_t allocatedBytes = 0;
+    // The bytes lost to alignment and to the unused ends of chunks.
+    size_t wastedBytes = 0;
+  };
+
+  // Swaps the contents of this arena with another. Each arena keeps its thread
+  // id, as that is the thread that created it, but everything else including
+  // the unique id moves, so that the thread-local caches of side arenas remain
+  // valid. This must not be called while other threads may be allocating.
+  void swap(MixedArena& other) {
+    chunks.swap(other.chunks);
+    std::swap(index, other.index);
+    std::swap(id, other.id);
+    std::swap(chunkBytes, other.chunkBytes);
+    std::swap(allocatedBytes, other.allocatedBytes);
+    auto* otherNext = other.next.load();
+    other.next.store(next.load());
+    next.store(otherNext);
+  }
+
+  // Sums up the statistics of this arena and its side arenas. This must not
+  // be called while other threads may be allocating.
+  Stats getStats() const {
+    Stats stats;
+    for (auto* curr = this; curr; curr = curr->next.load()) {
+      stats.arenas++;
+      stats.chunks += curr->chunks.size();
+      stats.chunkBytes += curr->chunkBytes;
+      stats.allocatedBytes += curr->allocatedBytes;
+      // The rest of the last chunk is not wasted, as we may still use it.
+      size_t available = 0;
+      if (!curr->chunks.empty() && curr->index < CHUNK_SIZE) {
+        available = CHUNK_SIZE - curr->index;
+      }
+      stats.wastedBytes += curr->chunkBytes - curr->allocatedBytes - available;
+    }
+    return stats;
+  }
+
   // Allocate an amount of space with a guaranteed alignment
   void* allocSpace(size_t size, size_t align) {
     // the bump allocator data should not be modified by multiple threads at
     // once.
     auto myId = std::this_thread::get_id();
     if (myId != threadId) {
+      struct ThreadCache {
+        uint64_t id = uint64_t(-1);
+        MixedArena* arena = nullptr;
+      };
+      thread_local ThreadCache cache;
+      if (cache.id == id) {
+        return cache.arena->allocSpace(size, align);
+      }
       MixedArena* curr = this;
       MixedArena* allocated = nullptr;
       while (myId != curr->threadId) {
@@ -107,6 +175,7 @@ struct MixedArena {
         if (curr->next.compare_exchange_strong(seen, allocated)) {
           // we replaced it, so we are the next in the chain
           // we can forget about allocated, it is owned by the chain now
+          curr = allocated;
           allocated = nullptr;
           break;
         }
@@ -116,6 +185,8 @@ struct MixedArena {
       if (allocated) {
         delete allocated;
       }
+      cache.id = id;
+      cache.arena = curr;
       return curr->allocSpace(size, align);
     }
     // First, move the current index in the last chunk to an aligned position.
@@ -130,8 +201,10 @@ struct MixedArena {
         abort();
       }
       chunks.push_back(allocation);
+      chunkBytes += numChunks * CHUNK_SIZE;
       index = 0;
     }
+    allocatedBytes += size;
     uint8_t* ret = static_cast<uint8_t*>(chunks.back());
     ret += index;
     index += size; // TODO: if we allocated more than 1 chunk, reuse the
@@ -153,6 +226,8 @@ struct MixedArena {
       wasm::aligned_free(chunk);
     }
     chunks.clear();
+    chunkBytes = 0;
+    allocatedBytes = 0;
   }
 
   ~MixedArena() {
@@ -26,7 +26,12 @@
 
 namespace wasm {
 
+class EffectAnalyzer;
 class Pass;
+class PassProfiler;
+
+// The effects of each function, including those of the functions it calls.
+using FuncEffectsMap = std::unordered_map<Name, EffectAnalyzer>;
 
 //
 // Global registry of all passes in /passes/
@@ -162,6 +167,18 @@ struct PassOptions {
   bool zeroFilledMemory = false;
   // Whether to try to preserve debug info through, which are special calls.
   bool debugInfo = false;
+  // A directory in which to cache the results of optimizing functions, so that
+  // functions that did not change since a previous run are not optimized again
+  // (see passes/function-cache.h).
+  std::string functionCacheDir;
+  // A file to write a profile of the passes to (see passes/pass-profiler.h).
+  std::string profileFile;
+  // The effects of functions, if generate-global-effects computed them (see
+  // passes/GlobalEffects.cpp). EffectAnalyzer uses these for direct calls
+  // instead of assuming that a call can do anything. This is shared with
+  // nested runners, and PassRunner discards it before running a pass that
+  // may add effects.
+  std::shared_ptr<FuncEffectsMap> funcEffectsMap;
   // Arbitrary string arguments from the commandline, which we forward to
   // passes.
   std::map<std::string, std::string> arguments;
@@ -315,11 +332,19 @@ private:
   // Whether this pass runner has run. A pass runner should only be run once.
   bool ran = false;
 
+  // The profiler to record the passes in, if we are profiling.
+  PassProfiler* profiler = nullptr;
+
   void doAdd(std::unique_ptr<Pass> pass);
 
   void runPass(Pass* pass);
   void runPassOnFunction(Pass* pass, Function* func);
 
+  // Before running a pass, discard anything it would make stale. This is
+  // called before a function-parallel pass runs on any function, as it may
+  // run on several in parallel.
+  void handleBeforeEffects(Pass* pass);
+
   // After running a pass, handle any changes due to
   // how the pass is defined, such as clearing away any
   // temporary data structures that the pass declares it
@@ -386,6 +411,16 @@ public:
   // for. This is used to issue a proper warning about that.
   virtual bool invalidatesDWARF() { return false; }
 
+  // Whether this pass may add effects to functions, for example by adding
+  // calls or instrumentation, which makes computed function effects stale (see
+  // PassOptions::funcEffectsMap). We assume so by default, which is always
+  // safe, as the effects are then just discarded. Optimization passes that
+  // only remove effects, or move code that the effects of a function already
+  // include, can return false so that the effects remain available to later
+  // passes. A pass that runs nested passes that add effects must not return
+  // false.
+  virtual bool addsEffects() { return true; }
+
   std::string name;
 
 protected:
@@ -19,10 +19,12 @@
 // is similar to register allocation, however, there is never any
 // spilling, and there isn't a fixed number of locals.
 //
-// NB: This pass is nonlinear in the number of locals. It is best to run it
-//     after the number of locals has been somewhat reduced by other passes,
-//     for example by simplify-locals (to remove unneeded uses of locals) and
-//     reorder-locals (to sort them by # of uses and remove all unneeded ones).
+// Interferences and copies are stored sparsely, so the work here grows with
+// the number of interferences and not the square of the number of locals.
+// Still, it is best to run this after the number of locals has been somewhat
+// reduced by other passes, for example by simplify-locals (to remove unneeded
+// uses of locals) and reorder-locals (to sort them by # of uses and remove all
+// unneeded ones).
 //
 
 #include <algorithm>
@@ -35,7 +37,6 @@
 #include "pass.h"
 #include "support/learning.h"
 #include "support/permutations.h"
-#include "support/sparse_square_matrix.h"
 #include "wasm.h"
 #ifdef CFG_PROFILE
 #include "support/timing.h"
@@ -46,6 +47,7 @@ namespace wasm {
 struct CoalesceLocals
   : public WalkerPass<LivenessWalker<CoalesceLocals, Visitor<CoalesceLocals>>> {
   bool isFunctionParallel() override { return true; }
+  bool addsEffects() override { return false; }
 
   // This pass merges locals, mapping the originals to new ones.
   // FIXME DWARF updating does not handle local changes yet.
@@ -76,28 +78,23 @@ struct CoalesceLocals
 
   // interference state
 
-  // canonicalized - accesses should check (low, high)
-  sparse_square_matrix<bool> interferences;
+  // The locals that each local interferes with. This is symmetric, and once
+  // calculateInterferences() is done each list is sorted and has no
+  // duplicates. Parameters are not noted as interfering with each other, as
+  // they are never coalesced anyhow.
+  std::vector<std::vector<Index>> interferences;
 
   void interfere(Index i, Index j) {
     if (i == j) {
       return;
     }
-    interferences.set(std::min(i, j), std::max(i, j), true);
-  }
-
-  // optimized version where you know that low < high
-  void interfereLowHigh(Index low, Index high) {
-    assert(low < high);
-    interferences.set(low, high, true);
-  }
-
-  void unInterfere(Index i, Index j) {
-    interferences.set(std::min(i, j), std::max(i, j), false);
+    interferences[i].push_back(j);
+    interferences[j].push_back(i);
   }
 
   bool interferes(Index i, Index j) {
-    return interferences.get(std::min(i, j), std::max(i, j));
+    auto& others = interferences[i];
+    return std::binary_search(others.begin(), others.end(), j);
   }
 };
 
@@ -143,7 +140,8 @@ void CoalesceLocals::increaseBackEdgePriorities() {
 }
 
 void CoalesceLocals::calculateInterferences() {
-  interferences.recreate(numLocals);
+  interferences.clear();
+  interferences.resize(numLocals);
 
   // We will track the values in each local, using a numbering where each index
   // represents a unique different value. This array maps a local index to the
@@ -306,26 +304,24 @@ void CoalesceLocals::calculateInterferences() {
     // The one exception here is the entry to the function, see below.
   }
 
-  // We must not try to coalesce parameters as they are fixed. Mark them as
-  // "interfering" so that we do not need to special-case them later.
-  auto numParams = getFunction()->getNumParams();
-  for (Index i = 0; i < numParams; i++) {
-    for (Index j = i + 1; j < numParams; j++) {
-      interfereLowHigh(i, j);
-    }
-  }
-
   // We must handle interference between uses of the zero-init value and
   // parameters manually. A zero initialization represents a set (to a default
   // value), and that set would be what alerts us to a conflict, but there is no
   // actual set in the IR since the zero-init value is applied implicitly.
+  auto numParams = func->getNumParams();
   for (auto i : entry->contents.start) {
     if (i >= numParams) {
       for (Index j = 0; j < numParams; j++) {
-        interfereLowHigh(j, i);
+        interfere(j, i);
       }
     }
   }
+
+  // The same pair may have been noted more than once.
+  for (auto& others : interferences) {
+    std::sort(others.begin(), others.end());
+    others.erase(std::unique(others.begin(), others.end()), others.end());
+  }
 }
 
 // Indices decision making
@@ -374,72 +370,95 @@ void CoalesceLocals::pickIndicesFromOrder(std::vector<Index>& order,
 #endif
   // TODO: take into account distribution (99-1 is better than 50-50 with two
   // registers, for gzip)
-  std::vector<Type> types;
-  // new index * numLocals => list of all interferences of locals merged to it
-  sparse_square_matrix<bool> newInterferences;
-
-  // new index * numLocals => list of all copies of locals merged to it
-  sparse_square_matrix<uint8_t> newCopies;
-
-  indices.resize(numLocals);
-  types.resize(numLocals);
+  auto* func = getFunction();
+  auto numParams = func->getNumParams();
 
-  auto numParams = getFunction()->getNumParams();
+  // Locals that we have not picked a new index for yet.
+  const Index Unpicked = -1;
+  indices.assign(numLocals, Unpicked);
 
-  newInterferences.recreate(numLocals);
-  newCopies.recreate(numLocals);
+  // The type of each new index, and the new indices of each type, in
+  // increasing order.
+  std::vector<Type> types;
+  std::unordered_map<Type, std::vector<Index>> typeIndices;
 
-  Index nextFree = 0;
-  removedCopies = 0;
   // we can't reorder parameters, they are fixed in order, and cannot coalesce
   Index i = 0;
   for (; i < numParams; i++) {
     assert(order[i] == i); // order must leave the params in place
     indices[i] = i;
-    types[i] = getFunction()->getLocalType(i);
-    for (Index j = numParams; j < numLocals; j++) {
-      newInterferences.set(i, j, interferes(i, j));
-      newCopies.set(i, j, getCopies(i, j));
-    }
-    nextFree++;
+    auto type = func->getLocalType(i);
+    types.push_back(type);
+    typeIndices[type].push_back(i);
   }
+
+  // State for each new index, computed for the local we are picking for. A new
+  // index is forbidden if it has a local that interferes with ours, which we
+  // mark using the position of our local in the order, to avoid clearing this
+  // each time. We also count the copies between our local and the locals at
+  // each new index, noting which new indices we counted for so we can clear
+  // them afterwards.
+  std::vector<Index> forbidden(numLocals, Unpicked);
+  std::vector<uint8_t> newCopies(numLocals);
+  std::vector<Index> copiedIndices;
+
+  removedCopies = 0;
   for (; i < numLocals; i++) {
     Index actual = order[i];
+    auto type = func->getLocalType(actual);
+    for (auto other : interferences[actual]) {
+      if (indices[other] != Unpicked) {
+        forbidden[indices[other]] = i;
+      }
+    }
+    for (auto& [other, count] : copies[actual]) {
+      auto index = indices[other];
+      if (index != Unpicked) {
+        newCopies[index] += count;
+        copiedIndices.push_back(index);
+      }
+    }
+    // Start with the first new index that does not interfere, and then look for
+    // one eliminating more copies. Only the new indices we have copies to can
+    // be better, and on ties we keep the lower index.
     Index found = -1;
-    uint8_t foundCopies = -1;
-    for (Index j = 0; j < nextFree; j++) {
-      if (!newInterferences.get(j, actual) &&
-          getFunction()->getLocalType(actual) == types[j]) {
-        // this does not interfere, so it might be what we want. but pick the
-        // one eliminating the most copies (we could stop looking forward when
-        // there are no more items that have copies anyhow, but it doesn't seem
-        // to help)
-        auto currCopies = newCopies.get(j, actual);
-        if (found == Index(-1) || currCopies > foundCopies) {
-          indices[actual] = found = j;
+    uint8_t foundCopies = 0;
+    for (auto index : typeIndices[type]) {
+      if (forbidden[index] != i) {
+        found = index;
+        foundCopies = newCopies[index];
+        break;
+      }
+    }
+    if (found != Index(-1)) {
+      for (auto index : copiedIndices) {
+        if (forbidden[index] == i || types[index] != type) {
+          continue;
+        }
+        auto currCopies = newCopies[index];
+        if (currCopies > foundCopies ||
+            (currCopies == foundCopies && index < found)) {
+          found = index;
           foundCopies = currCopies;
         }
       }
     }
+    for (auto index : copiedIndices) {
+      newCopies[index] = 0;
+    }
+    copiedIndices.clear();
     if (found == Index(-1)) {
-      indices[actual] = found = nextFree;
-      types[found] = getFunction()->getLocalType(actual);
-      nextFree++;
+      found = types.size();
+      types.push_back(type);
+      typeIndices[type].push_back(found);
       removedCopies += getCopies(found, actual);
     } else {
       removedCopies += foundCopies;
     }
+    indices[actual] = found;
 #if CFG_DEBUG
     std::cerr << "set local $" << actual << " to $" << found << '\n';
 #endif
-    // merge new interferences and copies for the new index
-    for (Index k = i + 1; k < numLocals; k++) {
-      // go in the order, we only need to update for those we will see later
-      auto j = order[k];
-      newInterferences.set(
-        found, j, newInterferences.get(found, j) || interferes(actual, j));
-      newCopies.set(found, j, newCopies.get(found, j) + getCopies(actual, j));
-    }
   }
 }
 
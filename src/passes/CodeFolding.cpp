@@ -85,6 +85,7 @@ struct ExpressionMarker
 
 struct CodeFolding : public WalkerPass<ControlFlowWalker<CodeFolding>> {
   bool isFunctionParallel() override { return true; }
+  bool addsEffects() override { return false; }
 
   Pass* create() override { return new CodeFolding; }
 
@@ -233,6 +233,7 @@ private:
 
 struct CodePushing : public WalkerPass<PostWalker<CodePushing>> {
   bool isFunctionParallel() override { return true; }
+  bool addsEffects() override { return false; }
 
   Pass* create() override { return new CodePushing; }
 
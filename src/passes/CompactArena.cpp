@@ -0,0 +1,120 @@
+/*
+ * Copyright 2022 WebAssembly Community Group participants
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//
+// Copies all the expressions in the module into a fresh arena, and frees the
+// old one. The module's arena never frees anything by itself, so after a long
+// sequence of passes it contains every expression that was ever created and
+// later discarded. Running this in between groups of passes, for example
+//
+//   wasm-opt -O3 --compact-arena -O3
+//
+// keeps the peak memory usage closer to the size of the live IR.
+//
+
+#include "ir/manipulation.h"
+#include "ir/module-utils.h"
+#include "pass.h"
+#include "wasm-traversal.h"
+#include "wasm.h"
+
+namespace wasm {
+
+namespace {
+
+// Lists the expressions in a tree in a deterministic order, so that we can
+// match the expressions in a copy to the originals.
+struct Lister : public PostWalker<Lister, UnifiedExpressionVisitor<Lister>> {
+  std::vector<Expression*> list;
+  void visitExpression(Expression* curr) { list.push_back(curr); }
+};
+
+template<typename Map>
+void remap(Map& map,
+           const std::unordered_map<Expression*, Expression*>& oldToNew) {
+  Map newMap;
+  newMap.reserve(map.size());
+  for (auto& [expr, value] : map) {
+    auto iter = oldToNew.find(expr);
+    if (iter != oldToNew.end()) {
+      newMap[iter->second] = value;
+    }
+  }
+  map.swap(newMap);
+}
+
+} // anonymous namespace
+
+struct CompactArena : public Pass {
+  void run(PassRunner* runner, Module* module) override {
+    // Move the old contents aside. The module keeps its own arena object, as
+    // every ArenaVector refers to it, but from now on it allocates in fresh
+    // chunks. The old ones are freed when |old| goes out of scope, at which
+    // point nothing may refer to them any more.
+    MixedArena old;
+    module->allocator.swap(old);
+
+    ModuleUtils::ParallelFunctionAnalysis<bool, Mutable> copier(
+      *module, [&](Function* func, bool&) {
+        if (func->imported()) {
+          return;
+        }
+        // Stack IR is allocated in the arena as well. It is only an
+        // optimization of the binary output, so just drop it.
+        func->stackIR.reset();
+        auto* copy = ExpressionManipulator::copy(func->body, *module);
+        if (!func->debugLocations.empty() ||
+            !func->expressionLocations.empty() ||
+            !func->delimiterLocations.empty()) {
+          Lister oldList;
+          oldList.walk(func->body);
+          Lister newList;
+          newList.walk(copy);
+          assert(oldList.list.size() == newList.list.size());
+          std::unordered_map<Expression*, Expression*> oldToNew;
+          for (Index i = 0; i < oldList.list.size(); i++) {
+            oldToNew[oldList.list[i]] = newList.list[i];
+          }
+          remap(func->debugLocations, oldToNew);
+          remap(func->expressionLocations, oldToNew);
+          remap(func->delimiterLocations, oldToNew);
+        }
+        func->body = copy;
+      });
+
+    auto copyExpr = [&](Expression*& expr) {
+      if (expr) {
+        expr = ExpressionManipulator::copy(expr, *module);
+      }
+    };
+    for (auto& global : module->globals) {
+      copyExpr(global->init);
+    }
+    for (auto& segment : module->elementSegments) {
+      copyExpr(segment->offset);
+      for (auto*& item : segment->data) {
+        copyExpr(item);
+      }
+    }
+    for (auto& segment : module->dataSegments) {
+      copyExpr(segment->offset);
+    }
+  }
+};
+
+Pass* createCompactArenaPass() { return new CompactArena(); }
+
+} // namespace wasm
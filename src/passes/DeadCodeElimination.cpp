@@ -43,6 +43,7 @@ struct DeadCodeElimination
       PostWalker<DeadCodeElimination,
                  UnifiedExpressionVisitor<DeadCodeElimination>>> {
   bool isFunctionParallel() override { return true; }
+  bool addsEffects() override { return false; }
 
   Pass* create() override { return new DeadCodeElimination; }
 
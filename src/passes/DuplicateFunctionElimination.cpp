@@ -34,6 +34,9 @@ struct DuplicateFunctionElimination : public Pass {
   // FIXME Merge DWARF info
   bool invalidatesDWARF() override { return true; }
 
+  // Calls are only redirected to identical functions.
+  bool addsEffects() override { return false; }
+
   void run(PassRunner* runner, Module* module) override {
     // Multiple iterations may be necessary: A and B may be identical only after
     // we see the functions C1 and C2 that they call are in fact identical.
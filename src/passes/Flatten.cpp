@@ -71,6 +71,7 @@ struct Flatten
   : public WalkerPass<
       ExpressionStackWalker<Flatten, UnifiedExpressionVisitor<Flatten>>> {
   bool isFunctionParallel() override { return true; }
+  bool addsEffects() override { return false; }
 
   // Flattening splits the original locals into a great many other ones, losing
   // track of the originals that DWARF refers to.
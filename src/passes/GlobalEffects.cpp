@@ -0,0 +1,244 @@
+/*
+ * Copyright 2022 WebAssembly Community Group participants
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//
+// Computes the effects of each function, including those of the functions it
+// calls, and stores them in the pass options, so that EffectAnalyzer can use
+// them at direct calls instead of assuming that a call can do anything. That
+// makes passes like SimplifyLocals, CodePushing and Vacuum more precise.
+//
+// The effects remain valid while optimizing, as optimizations only remove
+// effects, or move code whose effects are already included in them (as when
+// inlining). PassRunner discards them before any other pass, which may add
+// effects (see Pass::addsEffects), and discard-global-effects discards them
+// explicitly.
+//
+
+#include "ir/effects.h"
+#include "ir/find_all.h"
+#include "ir/module-utils.h"
+#include "pass.h"
+#include "wasm.h"
+
+namespace wasm {
+
+struct GenerateGlobalEffects : public Pass {
+  // This only computes information.
+  bool modifiesBinaryenIR() override { return false; }
+
+  void run(PassRunner* runner, Module* module) override {
+    auto& options = runner->options;
+
+    // First, find the effects of each function, not counting the functions it
+    // calls directly, which we note instead. To not count them, compute with
+    // empty effects for all defined functions. Calls to imports and indirect
+    // calls are then still counted as calls that can do anything.
+    auto empty = std::make_shared<FuncEffectsMap>();
+    for (auto& func : module->functions) {
+      if (!func->imported()) {
+        empty->emplace(func->name, EffectAnalyzer(options, *module));
+      }
+    }
+    auto localOptions = options;
+    localOptions.funcEffectsMap = empty;
+
+    struct FuncInfo {
+      // The effects, or nothing if they cannot be known.
+      std::optional<EffectAnalyzer> effects;
+      std::unordered_set<Name> calledFunctions;
+    };
+
+    ModuleUtils::ParallelFunctionAnalysis<FuncInfo> analysis(
+      *module, [&](Function* func, FuncInfo& info) {
+        if (func->imported()) {
+          return;
+        }
+        EffectAnalyzer effects(localOptions, *module, func->body);
+        if (effects.calls) {
+          return;
+        }
+        // Returns only branch out of the function, which callers cannot
+        // notice, but an infinite loop is noticeable. As in
+        // EffectAnalyzer::checkPre, assume that any loop may be infinite, as
+        // even a loop that is not unreachable can run forever.
+        effects.branchesOut = !FindAll<Loop>(func->body).list.empty();
+        // A delegate to the caller is a throw.
+        if (effects.throws()) {
+          effects.throws_ = true;
+        }
+        effects.breakTargets.clear();
+        effects.delegateTargets.clear();
+        // Locals are not noticeable outside of the function.
+        effects.localsRead.clear();
+        effects.localsWritten.clear();
+        // The effects are used in other contexts.
+        effects.funcEffectsMap.reset();
+        info.effects.emplace(effects);
+        for (auto* call : FindAll<Call>(func->body).list) {
+          info.calledFunctions.insert(call->target);
+        }
+      });
+
+    // Add the effects of everything each function can reach through direct
+    // calls. If any of that cannot be known, then neither can the effects of
+    // the function. All the functions in a strongly connected component of the
+    // call graph reach each other, so they have the same effects, and we
+    // compute them once per component, in reverse topological order, so that
+    // the effects of all the components that a component calls are known by
+    // then.
+    std::vector<Function*> funcs;
+    std::unordered_map<Name, Index> indexes;
+    for (auto& func : module->functions) {
+      indexes[func->name] = funcs.size();
+      funcs.push_back(func.get());
+    }
+    std::vector<std::vector<Index>> callees(funcs.size());
+    for (Index i = 0; i < funcs.size(); i++) {
+      for (auto name : analysis.map[funcs[i]].calledFunctions) {
+        callees[i].push_back(indexes[name]);
+      }
+    }
+
+    // Find the components using Tarjan's algorithm, which finds each one after
+    // all those that it calls.
+    const Index Unvisited = -1;
+    std::vector<Index> order(funcs.size(), Unvisited);
+    std::vector<Index> lowLink(funcs.size());
+    std::vector<bool> onStack(funcs.size());
+    std::vector<Index> stack;
+    std::vector<std::vector<Index>> components;
+    std::vector<Index> componentOf(funcs.size());
+    Index numVisited = 0;
+    auto visit = [&](Index i) {
+      order[i] = lowLink[i] = numVisited++;
+      stack.push_back(i);
+      onStack[i] = true;
+    };
+    for (Index root = 0; root < funcs.size(); root++) {
+      if (order[root] != Unvisited) {
+        continue;
+      }
+      // Each item is a function and how many of its callees we have visited.
+      std::vector<std::pair<Index, Index>> work;
+      visit(root);
+      work.emplace_back(root, 0);
+      while (!work.empty()) {
+        auto [i, numCallees] = work.back();
+        if (numCallees < callees[i].size()) {
+          work.back().second++;
+          auto callee = callees[i][numCallees];
+          if (order[callee] == Unvisited) {
+            visit(callee);
+            work.emplace_back(callee, 0);
+          } else if (onStack[callee]) {
+            lowLink[i] = std::min(lowLink[i], order[callee]);
+          }
+          continue;
+        }
+        work.pop_back();
+        if (!work.empty()) {
+          auto caller = work.back().first;
+          lowLink[caller] = std::min(lowLink[caller], lowLink[i]);
+        }
+        if (lowLink[i] == order[i]) {
+          // This is the first function we visited in its component, and the
+          // rest are above it on the stack.
+          auto& component = components.emplace_back();
+          Index member;
+          do {
+            member = stack.back();
+            stack.pop_back();
+            onStack[member] = false;
+            componentOf[member] = components.size() - 1;
+            component.push_back(member);
+          } while (member != i);
+        }
+      }
+    }
+
+    auto map = std::make_shared<FuncEffectsMap>();
+    std::vector<std::optional<EffectAnalyzer>> componentEffects(
+      components.size());
+    // The last component whose effects each component's were merged into, to
+    // merge them only once when there are several calls.
+    std::vector<Index> mergedInto(components.size(), Unvisited);
+    for (Index c = 0; c < components.size(); c++) {
+      auto& component = components[c];
+      auto& effects = componentEffects[c];
+      // A function that can call itself may do so forever, so it may not
+      // return, and neither may anything that calls it.
+      bool recursive = component.size() > 1;
+      bool known = true;
+      for (auto i : component) {
+        auto& info = analysis.map[funcs[i]];
+        if (!info.effects) {
+          known = false;
+          break;
+        }
+        if (!effects) {
+          effects.emplace(*info.effects);
+        } else {
+          effects->mergeIn(*info.effects);
+        }
+        for (auto callee : callees[i]) {
+          auto calleeComponent = componentOf[callee];
+          if (calleeComponent == c) {
+            recursive = true;
+            continue;
+          }
+          if (mergedInto[calleeComponent] == c) {
+            continue;
+          }
+          mergedInto[calleeComponent] = c;
+          auto& calleeEffects = componentEffects[calleeComponent];
+          if (!calleeEffects) {
+            known = false;
+            break;
+          }
+          effects->mergeIn(*calleeEffects);
+        }
+        if (!known) {
+          break;
+        }
+      }
+      if (!known) {
+        effects.reset();
+        continue;
+      }
+      if (recursive) {
+        effects->branchesOut = true;
+      }
+      for (auto i : component) {
+        map->emplace(funcs[i]->name, *effects);
+      }
+    }
+    options.funcEffectsMap = map;
+  }
+};
+
+struct DiscardGlobalEffects : public Pass {
+  bool modifiesBinaryenIR() override { return false; }
+
+  void run(PassRunner* runner, Module* module) override {
+    runner->options.funcEffectsMap.reset();
+  }
+};
+
+Pass* createGenerateGlobalEffectsPass() { return new GenerateGlobalEffects(); }
+
+Pass* createDiscardGlobalEffectsPass() { return new DiscardGlobalEffects(); }
+
+} // namespace wasm
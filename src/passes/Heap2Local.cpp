@@ -742,6 +742,7 @@ struct Heap2LocalOptimizer {
 
 struct Heap2Local : public WalkerPass<PostWalker<Heap2Local>> {
   bool isFunctionParallel() override { return true; }
+  bool addsEffects() override { return false; }
 
   Pass* create() override { return new Heap2Local(); }
 
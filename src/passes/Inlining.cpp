@@ -824,6 +824,11 @@ struct Inlining : public Pass {
   // FIXME DWARF updating does not handle local changes yet.
   bool invalidatesDWARF() override { return true; }
 
+  // The effects of a function include those of the functions it calls, so
+  // inlining a call does not add to them, and neither do the optimizations
+  // we run afterwards.
+  bool addsEffects() override { return false; }
+
   // whether to optimize where we inline
   bool optimize = false;
 
@@ -522,6 +522,7 @@ struct Applier
 
 struct LocalCSE : public WalkerPass<PostWalker<LocalCSE>> {
   bool isFunctionParallel() override { return true; }
+  bool addsEffects() override { return false; }
 
   // FIXME DWARF updating does not handle local changes yet.
   bool invalidatesDWARF() override { return true; }
@@ -35,6 +35,7 @@ namespace wasm {
 
 struct LocalSubtyping : public WalkerPass<PostWalker<LocalSubtyping>> {
   bool isFunctionParallel() override { return true; }
+  bool addsEffects() override { return false; }
 
   Pass* create() override { return new LocalSubtyping(); }
 
@@ -51,9 +52,9 @@ struct LocalSubtyping : public WalkerPass<PostWalker<LocalSubtyping>> {
     // we cannot change that type, as if we change the local type to
     // non-nullable then we'd be accessing the default, which is not allowed.
     //
-    // TODO: Optimize this, as LocalGraph computes more than we need, and on
-    //       more locals than we need.
-    LocalGraph localGraph(func);
+    // Only the gets of vars with reference types matter for that, so we compute
+    // the sets lazily.
+    LazyLocalGraph localGraph(func);
 
     // For each local index, compute all the the sets and gets.
     std::vector<std::vector<LocalSet*>> setsForLocal(numLocals);
@@ -77,13 +78,18 @@ struct LocalSubtyping : public WalkerPass<PostWalker<LocalSubtyping>> {
     std::unordered_set<Index> usesDefault;
 
     if (getModule()->features.hasGCNNLocals()) {
-      for (auto& [get, sets] : localGraph.getSetses) {
-        auto index = get->index;
-        if (func->isVar(index) &&
-            std::any_of(sets.begin(), sets.end(), [&](LocalSet* set) {
-              return set == nullptr;
-            })) {
-          usesDefault.insert(index);
+      for (Index i = func->getVarIndexBase(); i < numLocals; i++) {
+        if (!func->getLocalType(i).isRef()) {
+          continue;
+        }
+        for (auto* get : getsForLocal[i]) {
+          auto& sets = localGraph.getSets(get);
+          if (std::any_of(sets.begin(), sets.end(), [&](LocalSet* set) {
+                return set == nullptr;
+              })) {
+            usesDefault.insert(i);
+            break;
+          }
         }
       }
     }
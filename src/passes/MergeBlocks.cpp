@@ -402,6 +402,7 @@ struct MergeBlocks
   : public WalkerPass<
       PostWalker<MergeBlocks, UnifiedExpressionVisitor<MergeBlocks>>> {
   bool isFunctionParallel() override { return true; }
+  bool addsEffects() override { return false; }
 
   Pass* create() override { return new MergeBlocks; }
 
@@ -57,6 +57,7 @@ struct MergeLocals
   : public WalkerPass<
       PostWalker<MergeLocals, UnifiedExpressionVisitor<MergeLocals>>> {
   bool isFunctionParallel() override { return true; }
+  bool addsEffects() override { return false; }
 
   // This pass merges locals, mapping the originals to new ones.
   // FIXME DWARF updating does not handle local changes yet.
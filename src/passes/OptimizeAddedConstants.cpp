@@ -241,6 +241,7 @@ struct OptimizeAddedConstants
       PostWalker<OptimizeAddedConstants,
                  UnifiedExpressionVisitor<OptimizeAddedConstants>>> {
   bool isFunctionParallel() override { return true; }
+  bool addsEffects() override { return false; }
 
   bool propagate;
 
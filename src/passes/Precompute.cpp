@@ -27,6 +27,7 @@
 // looked at.
 //
 
+#include <ir/iteration.h>
 #include <ir/literal-utils.h>
 #include <ir/local-graph.h>
 #include <ir/manipulation.h>
@@ -198,6 +199,7 @@ struct Precompute
   : public WalkerPass<
       PostWalker<Precompute, UnifiedExpressionVisitor<Precompute>>> {
   bool isFunctionParallel() override { return true; }
+  bool addsEffects() override { return false; }
 
   Pass* create() override { return new Precompute(propagate); }
 
@@ -208,8 +210,18 @@ struct Precompute
   GetValues getValues;
   HeapValues heapValues;
 
+  // Expressions in the current walk that we failed to precompute. Children are
+  // walked before their parents, and a parent that must execute a child we
+  // failed on will fail as well, so remembering failures lets us skip
+  // evaluating such parents. Otherwise each level of a deep nesting would
+  // evaluate everything under it again, which is quadratic. The expressions we
+  // failed on are not modified later in the walk, but the values we propagate
+  // between walks can make them constant, so this is cleared before each walk.
+  std::unordered_set<Expression*> nonconstant;
+
   void doWalkFunction(Function* func) {
     // Walk the function and precompute things.
+    nonconstant.clear();
     super::doWalkFunction(func);
     if (!propagate) {
       return;
@@ -223,8 +235,10 @@ struct Precompute
       // We found constants to propagate and entered them in getValues. Do
       // another walk to apply them and perhaps other optimizations that are
       // unlocked.
+      nonconstant.clear();
       super::doWalkFunction(func);
     }
+    nonconstant.clear();
     // Note that in principle even more cycles could find further work here, in
     // very rare cases. To avoid constructing a LocalGraph again just for that
     // unlikely chance, we leave such things for later runs of this pass and for
@@ -272,6 +286,10 @@ struct Precompute
     if (Properties::isConstantExpression(curr) || curr->is<Nop>()) {
       return;
     }
+    if (mustFail(curr)) {
+      nonconstant.insert(curr);
+      return;
+    }
     // try to evaluate this into a const
     Flow flow = precomputeExpression(curr);
     if (!canEmitConstantFor(flow.values)) {
@@ -332,7 +350,17 @@ private:
                getModule(), getValues, heapValues, replaceExpression)
                .visit(curr);
     } catch (PrecomputingExpressionRunner::NonconstantException&) {
-      return Flow(NONCONSTANT_FLOW);
+      flow = Flow(NONCONSTANT_FLOW);
+    }
+    if (flow.breakTo == NONCONSTANT_FLOW) {
+      // When replacing, side effects are preserved and no local or global
+      // values are remembered, so the result depends only on the expression
+      // itself, and we can remember it for mustFail(). Otherwise it depends on
+      // the context it was evaluated in.
+      if (replaceExpression) {
+        nonconstant.insert(curr);
+      }
+      return flow;
     }
     // If we are replacing the expression, then the resulting value must be of
     // a type we can emit a constant for.
@@ -343,6 +371,30 @@ private:
     return flow;
   }
 
+  // Returns whether precomputing an expression must fail because of a child we
+  // already failed on. We do not traverse calls, so a child failing makes its
+  // parent fail unless control flow can skip that child. To be sure nothing
+  // is skipped, either the child must be the condition of an if, or all the
+  // children must be constants or failures, as then nothing can branch.
+  bool mustFail(Expression* curr) {
+    if (nonconstant.empty()) {
+      return false;
+    }
+    if (auto* iff = curr->dynCast<If>()) {
+      return nonconstant.count(iff->condition);
+    }
+    bool failingChild = false;
+    for (auto* child : ChildIterator(curr)) {
+      if (nonconstant.count(child)) {
+        failingChild = true;
+      } else if (!Properties::isConstantExpression(child) &&
+                 !child->is<Nop>()) {
+        return false;
+      }
+    }
+    return failingChild;
+  }
+
   // Precomputes the value of an expression, as opposed to the expression
   // itself. This differs from precomputeExpression in that we care about
   // the value the expression will have, which we cannot necessary replace
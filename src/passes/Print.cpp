@@ -18,11 +18,15 @@
 // Print out text in s-expression format
 //
 
+#include <numeric>
+#include <sstream>
+
 #include <ir/iteration.h>
 #include <ir/module-utils.h>
 #include <ir/table-utils.h>
 #include <pass.h>
 #include <pretty_printing.h>
+#include <support/threads.h>
 #include <wasm-stack.h>
 #include <wasm.h>
 
@@ -3270,6 +3274,56 @@ struct PrintSExpression : public UnifiedExpressionVisitor<PrintSExpression> {
                           << dylinkSection->tail.size() << "\n";
     }
   }
+  // Functions are printed in parallel, each into a buffer of its own, and then
+  // the buffers are written out in order. That is done in batches, so that we
+  // do not keep the text of all the functions of a huge module in memory at
+  // once. Writing each function with a single call also avoids the overhead
+  // of the stream for each small thing we print, which is significant for
+  // std::cout, for example.
+  void printDefinedFunctions(Module* curr) {
+    std::vector<Function*> funcs;
+    ModuleUtils::iterDefinedFunctions(
+      *curr, [&](Function* func) { funcs.push_back(func); });
+#ifdef _WIN32
+    // Colors are not written to the stream on Windows, but set on the console,
+    // which only works if we print directly.
+    if (Colors::isEnabled()) {
+      for (auto* func : funcs) {
+        visitFunction(func);
+      }
+      return;
+    }
+#endif
+    const size_t FunctionsPerWorker = 64;
+    auto batchSize = ThreadPool::get()->size() * FunctionsPerWorker;
+    std::vector<std::string> printed;
+    for (size_t start = 0; start < funcs.size(); start += batchSize) {
+      auto end = std::min(start + batchSize, funcs.size());
+      printed.clear();
+      printed.resize(end - start);
+      std::vector<size_t> items(end - start);
+      std::iota(items.begin(), items.end(), 0);
+      WorkStealingQueues::run(items, [&](size_t, size_t i) {
+        std::ostringstream buffer;
+        if (!Colors::isEnabled(o)) {
+          Colors::disable(buffer);
+        }
+        PrintSExpression print(buffer);
+        print.setMinify(minify);
+        print.setFull(full);
+        print.setStackIR(stackIR);
+        print.setDebugInfo(debugInfo);
+        print.currModule = currModule;
+        print.indent = indent;
+        print.visitFunction(funcs[start + i]);
+        printed[i] = buffer.str();
+      });
+      for (auto& text : printed) {
+        o.write(text.data(), text.size());
+      }
+    }
+  }
+
   void visitModule(Module* curr) {
     currModule = curr;
     o << '(';
@@ -3359,8 +3413,7 @@ struct PrintSExpression : public UnifiedExpressionVisitor<PrintSExpression> {
       printName(curr->start, o) << ')';
       o << maybeNewLine;
     }
-    ModuleUtils::iterDefinedFunctions(
-      *curr, [&](Function* func) { visitFunction(func); });
+    printDefinedFunctions(curr);
     if (curr->dylinkSection) {
       printDylinkSection(curr->dylinkSection);
     }
@@ -3645,6 +3698,9 @@ std::ostream& printStackIR(std::ostream& o, Module* module, bool optimize) {
 namespace std {
 
 std::ostream& operator<<(std::ostream& o, wasm::Module& module) {
+  if (module.lazyFunctionBodies) {
+    module.lazyFunctionBodies->materializeAll();
+  }
   wasm::PassRunner runner(&module);
   wasm::Printer(&o).run(&runner, &module);
   return o;
@@ -62,6 +62,7 @@ struct RedundantSetElimination
                                 Visitor<RedundantSetElimination>,
                                 Info>> {
   bool isFunctionParallel() override { return true; }
+  bool addsEffects() override { return false; }
 
   Pass* create() override { return new RedundantSetElimination(); }
 
@@ -116,6 +116,7 @@ static bool tooCostlyToRunUnconditionally(const PassOptions& passOptions,
 
 struct RemoveUnusedBrs : public WalkerPass<PostWalker<RemoveUnusedBrs>> {
   bool isFunctionParallel() override { return true; }
+  bool addsEffects() override { return false; }
 
   Pass* create() override { return new RemoveUnusedBrs; }
 
@@ -232,6 +232,8 @@ struct RemoveUnusedModuleElements : public Pass {
   RemoveUnusedModuleElements(bool rootAllFunctions)
     : rootAllFunctions(rootAllFunctions) {}
 
+  bool addsEffects() override { return false; }
+
   void run(PassRunner* runner, Module* module) override {
     std::vector<ModuleElement> roots;
     // Module start is a root.
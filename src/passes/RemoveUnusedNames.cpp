@@ -30,6 +30,7 @@ struct RemoveUnusedNames
   : public WalkerPass<PostWalker<RemoveUnusedNames,
                                  UnifiedExpressionVisitor<RemoveUnusedNames>>> {
   bool isFunctionParallel() override { return true; }
+  bool addsEffects() override { return false; }
 
   Pass* create() override { return new RemoveUnusedNames; }
 
@@ -31,6 +31,7 @@ namespace wasm {
 
 struct ReorderLocals : public WalkerPass<PostWalker<ReorderLocals>> {
   bool isFunctionParallel() override { return true; }
+  bool addsEffects() override { return false; }
 
   Pass* create() override { return new ReorderLocals; }
 
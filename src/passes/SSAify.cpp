@@ -69,6 +69,7 @@ static LocalSet IMPOSSIBLE_SET;
 
 struct SSAify : public Pass {
   bool isFunctionParallel() override { return true; }
+  bool addsEffects() override { return false; }
 
   // SSAify maps each original local to a number of new ones.
   // FIXME DWARF updating does not handle local changes yet.
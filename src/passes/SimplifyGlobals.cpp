@@ -41,6 +41,7 @@
 #include <atomic>
 
 #include "ir/effects.h"
+#include "ir/find_all.h"
 #include "ir/linear-execution.h"
 #include "ir/properties.h"
 #include "ir/utils.h"
@@ -167,6 +168,11 @@ struct GlobalUseScanner : public WalkerPass<PostWalker<GlobalUseScanner>> {
     if (codeEffects.hasAnything()) {
       return Name();
     }
+    // With global effects, a call may be all that writes the global, but the
+    // write we later remove must be right here.
+    if (!FindAll<Call>(code).list.empty()) {
+      return Name();
+    }
 
     // See if we read that global in the condition expression.
     EffectAnalyzer conditionEffects(getPassOptions(), *getModule(), condition);
@@ -365,10 +371,14 @@ struct ConstantGlobalApplier
     // Otherwise, invalidate if we need to.
     EffectAnalyzer effects(getPassOptions(), *getModule());
     effects.visit(curr);
-    assert(effects.globalsWritten.empty()); // handled above
     if (effects.calls) {
       currConstantGlobals.clear();
     }
+    // Sets are handled above, so anything written here is written by a call
+    // whose global effects we know.
+    for (auto name : effects.globalsWritten) {
+      currConstantGlobals.erase(name);
+    }
   }
 
   static void doNoteNonLinear(ConstantGlobalApplier* self, Expression** currp) {
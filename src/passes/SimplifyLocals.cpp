@@ -69,6 +69,7 @@ struct SimplifyLocals
   : public WalkerPass<LinearExecutionWalker<
       SimplifyLocals<allowTee, allowStructure, allowNesting>>> {
   bool isFunctionParallel() override { return true; }
+  bool addsEffects() override { return false; }
 
   Pass* create() override {
     return new SimplifyLocals<allowTee, allowStructure, allowNesting>();
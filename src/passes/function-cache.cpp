@@ -0,0 +1,354 @@
+/*
+ * Copyright 2022 WebAssembly Community Group participants
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <set>
+#include <sstream>
+
+#include "config.h"
+#include "ir/effects.h"
+#include "ir/manipulation.h"
+#include "ir/module-utils.h"
+#include "passes/function-cache.h"
+#include "support/colors.h"
+#include "support/path.h"
+#include "wasm-s-parser.h"
+#include "wasm-type.h"
+
+namespace wasm {
+
+namespace {
+
+// Finds the things in the module that code refers to.
+struct References : public PostWalker<References> {
+  std::set<Name> functions, globals, tables, tags;
+  // Data segments are referred to by index, which we cannot represent in a
+  // module with just the function.
+  bool usesSegments = false;
+
+  void visitCall(Call* curr) { functions.insert(curr->target); }
+  void visitCallIndirect(CallIndirect* curr) { tables.insert(curr->table); }
+  void visitRefFunc(RefFunc* curr) { functions.insert(curr->func); }
+  void visitGlobalGet(GlobalGet* curr) { globals.insert(curr->name); }
+  void visitGlobalSet(GlobalSet* curr) { globals.insert(curr->name); }
+  void visitTableGet(TableGet* curr) { tables.insert(curr->table); }
+  void visitTableSet(TableSet* curr) { tables.insert(curr->table); }
+  void visitTableSize(TableSize* curr) { tables.insert(curr->table); }
+  void visitTableGrow(TableGrow* curr) { tables.insert(curr->table); }
+  void visitThrow(Throw* curr) { tags.insert(curr->tag); }
+  void visitTry(Try* curr) {
+    for (auto tag : curr->catchTags) {
+      tags.insert(tag);
+    }
+  }
+  void visitMemoryInit(MemoryInit* curr) { usesSegments = true; }
+  void visitDataDrop(DataDrop* curr) { usesSegments = true; }
+};
+
+template<typename T> void makeImport(T* item) {
+  if (!item->imported()) {
+    item->module = "env";
+    item->base = item->name;
+  }
+}
+
+// Prints the global effects of a function (see GlobalEffects.cpp).
+void printEffects(const EffectAnalyzer& effects, std::ostream& o) {
+  o << effects.getSideEffects() << ' ' << effects.trap;
+  for (auto name : effects.mutableGlobalsRead) {
+    o << " read " << name;
+  }
+  for (auto name : effects.globalsWritten) {
+    o << " write " << name;
+  }
+}
+
+// Builds a module with a copy of a function and imports for everything it
+// refers to, and prints it. Anything else that passes may look at goes into
+// comments at the end. Returns false if the function cannot be represented
+// that way.
+bool print(Module& wasm,
+           const FuncEffectsMap* funcEffects,
+           Function* func,
+           References& refs,
+           std::ostream& o) {
+  if (refs.usesSegments) {
+    return false;
+  }
+  Module entry;
+  entry.features = wasm.features;
+  std::stringstream extra;
+  // The text is hashed and parsed back, so it must not contain colors.
+  Colors::disable(o);
+  Colors::disable(extra);
+  for (auto name : refs.functions) {
+    if (name == func->name) {
+      continue;
+    }
+    auto* callee = wasm.getFunctionOrNull(name);
+    if (!callee) {
+      return false;
+    }
+    auto import = Builder::makeFunction(name, callee->type, {});
+    import->module = callee->imported() ? callee->module : Name("env");
+    import->base = callee->imported() ? callee->base : name;
+    entry.addFunction(std::move(import));
+    // Passes may use the effects of the callee.
+    if (funcEffects) {
+      auto iter = funcEffects->find(name);
+      if (iter != funcEffects->end()) {
+        extra << ";; effects " << name << ' ';
+        printEffects(iter->second, extra);
+        extra << '\n';
+      }
+    }
+  }
+  for (auto name : refs.globals) {
+    auto* global = wasm.getGlobalOrNull(name);
+    if (!global) {
+      return false;
+    }
+    auto* copy = ModuleUtils::copyGlobal(global, entry);
+    makeImport(copy);
+    copy->init = nullptr;
+    // Passes may propagate the value of an immutable global.
+    if (!global->mutable_ && !global->imported()) {
+      extra << ";; global " << name << ' '
+            << ModuleExpression(wasm, global->init) << '\n';
+    }
+  }
+  for (auto name : refs.tables) {
+    auto* table = wasm.getTableOrNull(name);
+    if (!table) {
+      return false;
+    }
+    makeImport(ModuleUtils::copyTable(table, entry));
+    // Passes may turn indirect calls into direct ones using the contents of
+    // the table.
+    for (auto& segment : wasm.elementSegments) {
+      if (segment->table != name) {
+        continue;
+      }
+      extra << ";; elem " << name << ' ';
+      if (segment->offset) {
+        extra << ModuleExpression(wasm, segment->offset);
+      }
+      for (auto* item : segment->data) {
+        extra << ' ' << ModuleExpression(wasm, item);
+      }
+      extra << '\n';
+    }
+  }
+  for (auto name : refs.tags) {
+    auto* tag = wasm.getTagOrNull(name);
+    if (!tag) {
+      return false;
+    }
+    makeImport(ModuleUtils::copyTag(tag, entry));
+  }
+  if (wasm.memory.exists) {
+    entry.memory = wasm.memory;
+    makeImport(&entry.memory);
+  }
+  ModuleUtils::copyFunction(func, entry);
+  o << entry << extra.str();
+  return true;
+}
+
+// Checks that something in a module we read from the cache matches what is in
+// the module we optimize.
+bool matches(Module& wasm, Module& entry) {
+  for (auto& func : entry.functions) {
+    if (func->imported()) {
+      auto* ours = wasm.getFunctionOrNull(func->name);
+      if (!ours || ours->type != func->type) {
+        return false;
+      }
+    }
+  }
+  for (auto& global : entry.globals) {
+    auto* ours = wasm.getGlobalOrNull(global->name);
+    if (!ours || ours->type != global->type ||
+        ours->mutable_ != global->mutable_) {
+      return false;
+    }
+  }
+  for (auto& table : entry.tables) {
+    auto* ours = wasm.getTableOrNull(table->name);
+    if (!ours || ours->type != table->type) {
+      return false;
+    }
+  }
+  for (auto& tag : entry.tags) {
+    auto* ours = wasm.getTagOrNull(tag->name);
+    if (!ours || ours->sig != tag->sig) {
+      return false;
+    }
+  }
+  if (entry.memory.exists) {
+    return wasm.memory.exists &&
+           wasm.memory.indexType == entry.memory.indexType;
+  }
+  return true;
+}
+
+// The separator between the function before and after optimization.
+const char* const AFTER = ";; after\n";
+
+} // anonymous namespace
+
+std::unique_ptr<FunctionCache> FunctionCache::create(
+  Module& wasm, const PassOptions& options, std::vector<Pass*>& passes) {
+  if (options.functionCacheDir.empty()) {
+    return nullptr;
+  }
+  // Types that we read back from the cache must be identical to the ones in
+  // the module, which is not the case for nominal types.
+  if (getTypeSystem() == TypeSystem::Nominal) {
+    return nullptr;
+  }
+  std::stringstream pipeline;
+  // Entries from another build of Binaryen may have been optimized
+  // differently, so they must not be used. The version includes the git
+  // commit when building from a git checkout.
+  pipeline << ";; version " << PROJECT_VERSION << '\n';
+  for (auto* pass : passes) {
+    // We can only cache passes that only modify Binaryen IR, and that we can
+    // identify.
+    if (!pass->modifiesBinaryenIR() || pass->name.empty()) {
+      return nullptr;
+    }
+    pipeline << ";; pass " << pass->name << '\n';
+  }
+  pipeline << ";; options " << options.optimizeLevel << ' '
+           << options.shrinkLevel << ' ' << options.inlining.alwaysInlineMaxSize
+           << ' ' << options.inlining.oneCallerInlineMaxSize << ' '
+           << options.inlining.flexibleInlineMaxSize << ' '
+           << options.inlining.allowFunctionsWithLoops << ' '
+           << options.inlining.partialInliningIfs << ' '
+           << options.ignoreImplicitTraps << ' ' << options.trapsNeverHappen
+           << ' ' << options.lowMemoryUnused << ' ' << options.fastMath << ' '
+           << options.zeroFilledMemory << ' ' << options.debugInfo << '\n';
+  for (auto& [key, value] : options.arguments) {
+    pipeline << ";; argument " << key << '=' << value << '\n';
+  }
+  pipeline << ";; features " << wasm.features.toString() << '\n';
+  return std::unique_ptr<FunctionCache>(new FunctionCache(
+    wasm, options.functionCacheDir, pipeline.str(), options.funcEffectsMap));
+}
+
+FunctionCache::FunctionCache(Module& wasm,
+                             std::string dir,
+                             std::string pipeline,
+                             std::shared_ptr<FuncEffectsMap> funcEffects)
+  : wasm(wasm), dir(dir), pipeline(pipeline), funcEffects(funcEffects) {}
+
+std::string FunctionCache::getPath(const std::string& key) {
+  return dir + Path::getPathSeparator() + key + ".wat";
+}
+
+bool FunctionCache::lookup(Function* func, Entry& entry) {
+  // Debug info is not kept in the text format, and stack IR is not kept at
+  // all.
+  if (!func->debugLocations.empty() || !func->expressionLocations.empty() ||
+      func->stackIR) {
+    return false;
+  }
+  References refs;
+  refs.walk(func->body);
+  std::stringstream before;
+  before << pipeline;
+  if (!print(wasm, funcEffects.get(), func, refs, before)) {
+    return false;
+  }
+  entry.cacheable = true;
+  entry.before = before.str();
+  std::stringstream key;
+  key << std::hex << std::hash<std::string>{}(entry.before);
+  entry.key = key.str();
+
+  std::ifstream file(getPath(entry.key), std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  std::stringstream contents;
+  contents << file.rdbuf();
+  auto text = contents.str();
+  if (text.compare(0, entry.before.size(), entry.before) != 0 ||
+      text.compare(entry.before.size(), strlen(AFTER), AFTER) != 0) {
+    return false;
+  }
+  text = text.substr(entry.before.size() + strlen(AFTER));
+
+  Module optimized;
+  optimized.features = wasm.features;
+  try {
+    SExpressionParser parser(text.data());
+    Element& root = *parser.root;
+    SExpressionWasmBuilder builder(optimized, *root[0], IRProfile::Normal);
+  } catch (ParseException&) {
+    return false;
+  }
+  auto* result = optimized.getFunctionOrNull(func->name);
+  if (!result || result->imported() || result->type != func->type ||
+      !matches(wasm, optimized)) {
+    return false;
+  }
+  func->vars = result->vars;
+  func->localNames = result->localNames;
+  func->localIndices = result->localIndices;
+  func->body = ExpressionManipulator::copy(result->body, wasm);
+  return true;
+}
+
+void FunctionCache::store(Function* func, const Entry& entry) {
+  if (!entry.cacheable || !func->debugLocations.empty() ||
+      !func->expressionLocations.empty()) {
+    return;
+  }
+  // The optimized function may refer to other things than before.
+  References refs;
+  refs.walk(func->body);
+  std::stringstream after;
+  if (!print(wasm, funcEffects.get(), func, refs, after)) {
+    return;
+  }
+
+  // Write to a temporary file first and then rename it, so that other
+  // processes using the same cache never see partial files.
+  auto path = getPath(entry.key);
+  auto temp = path + '.' + std::to_string(std::random_device{}());
+  {
+    std::ofstream file(temp, std::ios::binary);
+    if (!file) {
+      return;
+    }
+    file << entry.before << AFTER << after.str();
+    if (!file) {
+      file.close();
+      std::remove(temp.c_str());
+      return;
+    }
+  }
+  if (std::rename(temp.c_str(), path.c_str()) != 0) {
+    std::remove(temp.c_str());
+  }
+}
+
+} // namespace wasm
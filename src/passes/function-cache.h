@@ -0,0 +1,83 @@
+/*
+ * Copyright 2022 WebAssembly Community Group participants
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef wasm_passes_function_cache_h
+#define wasm_passes_function_cache_h
+
+#include "pass.h"
+#include "wasm.h"
+
+// An on-disk cache of the results of running a sequence of function-parallel
+// passes on a function. PassRunner uses this when it is given a cache
+// directory, so that when a module is optimized again after only some of its
+// functions changed, the unchanged ones are not optimized from scratch.
+//
+// A cache entry is keyed by the function's code, the version of Binaryen, the
+// passes that run and the options they run with, and everything in the module
+// that the function refers to (the signatures of the functions it calls, the
+// types of the globals it uses, and so forth). Each entry is a text file
+// containing a small module with the function and imports for those things,
+// followed by a module with the optimized function. Lookups compare the first
+// part in full, so hash collisions cannot cause a wrong result.
+//
+// This assumes that the passes only look at the function and at the things it
+// refers to, which is true of the function-parallel passes in the default
+// optimization pipeline.
+
+namespace wasm {
+
+class FunctionCache {
+public:
+  // Returns a cache for running the given passes, or nullptr if they cannot
+  // be cached.
+  static std::unique_ptr<FunctionCache>
+  create(Module& wasm, const PassOptions& options, std::vector<Pass*>& passes);
+
+  // The state of a function before we optimized it.
+  struct Entry {
+    // Whether we can cache this function at all.
+    bool cacheable = false;
+    std::string key;
+    std::string before;
+  };
+
+  // Looks up the optimized version of a function. If it is in the cache, the
+  // function is updated and true is returned. Otherwise, the entry is filled
+  // in, and after optimizing the function it should be passed to store().
+  //
+  // This (and store()) may be called on multiple functions in parallel.
+  bool lookup(Function* func, Entry& entry);
+
+  void store(Function* func, const Entry& entry);
+
+private:
+  FunctionCache(Module& wasm,
+                std::string dir,
+                std::string pipeline,
+                std::shared_ptr<FuncEffectsMap> funcEffects);
+
+  Module& wasm;
+  std::string dir;
+  std::string pipeline;
+  // The global effects that the passes use, if any.
+  std::shared_ptr<FuncEffectsMap> funcEffects;
+
+  std::string getPath(const std::string& key);
+};
+
+} // namespace wasm
+
+#endif // wasm_passes_function_cache_h
@@ -24,16 +24,18 @@
 namespace wasm::ParamUtils {
 
 std::unordered_set<Index> getUsedParams(Function* func) {
-  LocalGraph localGraph(func);
+  // We only care about the gets of params.
+  LazyLocalGraph localGraph(func);
 
   std::unordered_set<Index> usedParams;
 
-  for (auto& [get, sets] : localGraph.getSetses) {
-    if (!func->isParam(get->index)) {
+  for (auto& [curr, _] : localGraph.locations) {
+    auto* get = curr->dynCast<LocalGet>();
+    if (!get || !func->isParam(get->index) || usedParams.count(get->index)) {
       continue;
     }
 
-    for (auto* set : sets) {
+    for (auto* set : localGraph.getSets(get)) {
       // A nullptr value indicates there is no LocalSet* that sets the value,
       // so it must be the parameter value.
       if (!set) {
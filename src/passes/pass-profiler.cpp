@@ -0,0 +1,259 @@
+/*
+ * Copyright 2022 WebAssembly Community Group participants
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+
+#include "ir/utils.h"
+#include "passes/pass-profiler.h"
+#include "support/file.h"
+#include "support/threads.h"
+
+namespace wasm {
+
+namespace {
+
+// Returns how much the current thread allocated in an arena. Function-parallel
+// passes run on one thread, and each thread allocates in its own side arena.
+size_t getAllocatedOnThisThread(MixedArena& arena) {
+  auto id = std::this_thread::get_id();
+  for (auto* curr = &arena; curr; curr = curr->next.load()) {
+    if (curr->threadId == id) {
+      return curr->allocatedBytes;
+    }
+  }
+  return 0;
+}
+
+// The size of all the defined functions, measured in parallel.
+size_t getModuleSize(Module& wasm) {
+  std::vector<size_t> defined;
+  for (size_t i = 0; i < wasm.functions.size(); i++) {
+    if (!wasm.functions[i]->imported()) {
+      defined.push_back(i);
+    }
+  }
+  std::atomic<size_t> size{0};
+  WorkStealingQueues::run(defined, [&](size_t, size_t index) {
+    size += Measurer::measure(wasm.functions[index]->body);
+  });
+  return size;
+}
+
+// Write out a thread's events once it has this many.
+const size_t MaxBufferedEvents = 4096;
+
+void writeJSONString(std::ostream& o, const std::string& str) {
+  o << '"';
+  for (unsigned char c : str) {
+    if (c == '"' || c == '\\') {
+      o << '\\' << c;
+    } else if (c < 0x20) {
+      o << "\\u00" << std::hex << std::setw(2) << std::setfill('0') << int(c)
+        << std::dec;
+    } else {
+      o << c;
+    }
+  }
+  o << '"';
+}
+
+void writeCSVField(std::ostream& o, const std::string& str) {
+  o << '"';
+  for (auto c : str) {
+    if (c == '"') {
+      o << '"';
+    }
+    o << c;
+  }
+  o << '"';
+}
+
+} // anonymous namespace
+
+PassProfiler& PassProfiler::get(const std::string& filename) {
+  static std::mutex mutex;
+  static std::map<std::string, std::unique_ptr<PassProfiler>> profilers;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto& profiler = profilers[filename];
+  if (!profiler) {
+    profiler.reset(new PassProfiler(filename));
+  }
+  return *profiler;
+}
+
+PassProfiler::PassProfiler(const std::string& filename)
+  : origin(std::chrono::steady_clock::now()) {
+  output = std::make_unique<Output>(filename, Flags::Text);
+  std::string suffix = ".csv";
+  csv = filename.size() >= suffix.size() &&
+        filename.substr(filename.size() - suffix.size()) == suffix;
+  auto& o = output->getStream();
+  o << std::fixed << std::setprecision(3);
+  if (csv) {
+    o << "pass,function,thread,start_us,duration_us,allocated_bytes,"
+         "size_before,size_after\n";
+  } else {
+    o << "{\"traceEvents\":[\n";
+  }
+}
+
+PassProfiler::ThreadEvents& PassProfiler::getThreadEvents() {
+  thread_local std::unordered_map<PassProfiler*, ThreadEvents*> cache;
+  auto& events = cache[this];
+  if (!events) {
+    std::lock_guard<std::mutex> lock(mutex);
+    threads.push_back(std::make_unique<ThreadEvents>());
+    events = threads.back().get();
+    events->thread = threads.size() - 1;
+  }
+  return *events;
+}
+
+PassProfiler::Start PassProfiler::start(Module& wasm, Function* func) {
+  Start start;
+  start.func = func;
+  if (func) {
+    auto& local = getThreadEvents();
+    if (local.func == func && local.generation == generation) {
+      start.size = local.size;
+    } else {
+      start.size = Measurer::measure(func->body);
+    }
+    start.allocated = getAllocatedOnThisThread(wasm.allocator);
+  } else {
+    start.size = getModuleSize(wasm);
+    start.allocated = wasm.allocator.getStats().allocatedBytes;
+  }
+  // Start the clock last, so that measuring is not part of the time.
+  start.time = std::chrono::steady_clock::now();
+  return start;
+}
+
+void PassProfiler::stop(Module& wasm, Pass* pass, const Start& start) {
+  auto now = std::chrono::steady_clock::now();
+  Event event;
+  event.pass = pass->name;
+  event.func = start.func ? start.func->name : Name();
+  event.start =
+    std::chrono::duration<double, std::micro>(start.time - origin).count();
+  event.duration =
+    std::chrono::duration<double, std::micro>(now - start.time).count();
+  event.sizeBefore = start.size;
+
+  auto& local = getThreadEvents();
+  if (start.func) {
+    auto allocated = getAllocatedOnThisThread(wasm.allocator);
+    event.allocated = int64_t(allocated) - int64_t(start.allocated);
+    local.func = start.func;
+    local.generation = generation;
+    local.size = Measurer::measure(start.func->body);
+    event.sizeAfter = local.size;
+  } else {
+    auto allocated = wasm.allocator.getStats().allocatedBytes;
+    event.allocated = int64_t(allocated) - int64_t(start.allocated);
+    event.sizeAfter =
+      pass->modifiesBinaryenIR() ? getModuleSize(wasm) : start.size;
+    generation++;
+  }
+
+  std::unique_lock<std::mutex> localLock(local.mutex);
+  event.thread = local.thread;
+  local.events.push_back(std::move(event));
+  if (local.events.size() >= MaxBufferedEvents) {
+    std::vector<Event> events;
+    events.swap(local.events);
+    localLock.unlock();
+    std::lock_guard<std::mutex> lock(mutex);
+    writeEvents(events);
+  }
+}
+
+void PassProfiler::write() {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto& local : threads) {
+    std::vector<Event> events;
+    {
+      std::lock_guard<std::mutex> localLock(local->mutex);
+      events.swap(local->events);
+    }
+    writeEvents(events);
+  }
+  // Anything may change the module before the next pass runs.
+  generation++;
+
+  auto& o = output->getStream();
+  if (!csv) {
+    // Write the footer, and then go back to its start, so that more events
+    // overwrite it.
+    auto footer = o.tellp();
+    o << "\n]}\n";
+    o.flush();
+    if (!o.seekp(footer)) {
+      o.clear();
+    }
+  } else {
+    o.flush();
+  }
+}
+
+void PassProfiler::writeEvents(std::vector<Event>& events) {
+  auto& o = output->getStream();
+  for (auto& event : events) {
+    if (csv) {
+      writeCSV(o, event);
+    } else {
+      writeTrace(o, event);
+    }
+  }
+}
+
+void PassProfiler::writeCSV(std::ostream& o, const Event& event) {
+  writeCSVField(o, event.pass);
+  o << ',';
+  if (event.func.is()) {
+    writeCSVField(o, event.func.str);
+  }
+  o << ',' << event.thread << ',' << event.start << ',' << event.duration << ','
+    << event.allocated << ',' << event.sizeBefore << ',' << event.sizeAfter
+    << '\n';
+}
+
+void PassProfiler::writeTrace(std::ostream& o, const Event& event) {
+  if (!first) {
+    o << ",\n";
+  }
+  first = false;
+  o << "{\"name\":";
+  writeJSONString(o, event.pass);
+  o << ",\"cat\":\"" << (event.func.is() ? "function" : "module")
+    << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.thread
+    << ",\"ts\":" << event.start << ",\"dur\":" << event.duration
+    << ",\"args\":{";
+  if (event.func.is()) {
+    o << "\"function\":";
+    writeJSONString(o, event.func.str);
+    o << ',';
+  }
+  o << "\"allocated\":" << event.allocated
+    << ",\"sizeBefore\":" << event.sizeBefore
+    << ",\"sizeAfter\":" << event.sizeAfter << "}}";
+}
+
+} // namespace wasm
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2022 WebAssembly Community Group participants
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef wasm_passes_pass_profiler_h
+#define wasm_passes_pass_profiler_h
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "pass.h"
+#include "support/file.h"
+#include "wasm.h"
+
+// Records how long each pass takes on each function, how much it allocates in
+// the module's arena, and how it changes the size of the code. PassRunner
+// uses this when PassOptions::profileFile is set, while running the passes in
+// the normal way, so that the numbers reflect how passes run in production.
+//
+// Sizes are measured after each pass, and the size after a pass on a function
+// is reused as the size before the next pass in the same stack. Passes on the
+// whole module measure all the functions, in parallel, and only after the pass
+// if it may modify them.
+//
+// The profile is written as CSV if the file name ends in ".csv", and as a
+// Chrome trace (which can be loaded in about:tracing or Perfetto) otherwise.
+
+namespace wasm {
+
+class PassProfiler {
+public:
+  // Returns the profiler for a file. All the pass runners in the process that
+  // write to the same file add to the same profile.
+  static PassProfiler& get(const std::string& filename);
+
+  // The state when a pass started to run, on a function or, if func is null,
+  // on the whole module.
+  struct Start {
+    Function* func;
+    std::chrono::steady_clock::time_point time;
+    size_t allocated;
+    size_t size;
+  };
+
+  Start start(Module& wasm, Function* func = nullptr);
+
+  // Records a pass that started at |start| and just finished.
+  void stop(Module& wasm, Pass* pass, const Start& start);
+
+  // Writes out everything recorded so far.
+  void write();
+
+private:
+  PassProfiler(const std::string& filename);
+
+  struct Event {
+    std::string pass;
+    Name func;
+    size_t thread;
+    double start;
+    double duration;
+    int64_t allocated;
+    int64_t sizeBefore;
+    int64_t sizeAfter;
+  };
+
+  // The events of one thread. Threads add to their own buffers, so that they
+  // do not contend for a lock on each event, and write them out once there
+  // are enough of them, so that the memory used is bounded.
+  struct ThreadEvents {
+    std::mutex mutex;
+    size_t thread;
+    std::vector<Event> events;
+
+    // The size of the function this thread last ran a pass on, as measured
+    // after the pass. A stack of function-parallel passes runs on each
+    // function on one thread, so that is the size before the next pass on it,
+    // unless the generation changed.
+    Function* func = nullptr;
+    size_t generation = 0;
+    size_t size = 0;
+  };
+
+  ThreadEvents& getThreadEvents();
+
+  // Writes out events. The caller must hold |mutex|.
+  void writeEvents(std::vector<Event>& events);
+
+  std::chrono::steady_clock::time_point origin;
+
+  // Incremented whenever a pass on the whole module runs, as it may change any
+  // function, and when a pass runner finishes.
+  std::atomic<size_t> generation{0};
+
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadEvents>> threads;
+  std::unique_ptr<Output> output;
+  bool csv;
+  bool first = true;
+
+  void writeCSV(std::ostream& o, const Event& event);
+  void writeTrace(std::ostream& o, const Event& event);
+};
+
+} // namespace wasm
+
+#endif // wasm_passes_pass_profiler_h
@@ -15,6 +15,8 @@
  */
 
 #include <chrono>
+#include <numeric>
+#include <optional>
 #include <sstream>
 
 #ifdef __linux__
@@ -23,9 +25,14 @@
 
 #include "ir/hashed.h"
 #include "ir/module-utils.h"
+#include "ir/utils.h"
 #include "pass.h"
+#include "passes/function-cache.h"
+#include "passes/pass-profiler.h"
 #include "passes/passes.h"
 #include "support/colors.h"
+#include "support/debug.h"
+#include "wasm-binary.h"
 #include "wasm-debug.h"
 #include "wasm-io.h"
 #include "wasm-validator.h"
@@ -111,6 +118,9 @@ void PassRegistry::registerPasses() {
                createCodePushingPass);
   registerPass(
     "code-folding", "fold code, merging duplicates", createCodeFoldingPass);
+  registerPass("compact-arena",
+               "copy the IR into fresh memory, freeing discarded expressions",
+               createCompactArenaPass);
   registerPass("const-hoisting",
                "hoist repeated constants to a local",
                createConstHoistingPass);
@@ -129,6 +139,9 @@ void PassRegistry::registerPasses() {
     "directize", "turns indirect calls into direct ones", createDirectizePass);
   registerPass(
     "dfo", "optimizes using the DataFlow SSA IR", createDataFlowOptsPass);
+  registerPass("discard-global-effects",
+               "discards global effect info",
+               createDiscardGlobalEffectsPass);
   registerPass("dwarfdump",
                "dump DWARF debug info sections from the read binary",
                createDWARFDumpPass);
@@ -164,6 +177,9 @@ void PassRegistry::registerPasses() {
     "functions with i64 in their signature (which cannot be invoked "
     "via the wasm table without JavaScript BigInt support).",
     createGenerateI64DynCallsPass);
+  registerPass("generate-global-effects",
+               "generate global effect info (helps later passes)",
+               createGenerateGlobalEffectsPass);
   registerPass(
     "generate-stack-ir", "generate Stack IR", createGenerateStackIRPass);
   registerPass(
@@ -631,10 +647,69 @@ static void dumpWast(Name name, Module* wasm) {
   writer.writeBinary(*wasm, fullName + ".wasm");
 }
 
+// Validates the module after a pass, in pass-debug mode. To keep that from
+// costing as much as the passes themselves, we only validate what may have
+// changed: we note a hash of each function when we validate, and after a pass
+// that can only have changed function bodies, we only validate the functions
+// whose hashes changed. The hashes include the expressions' addresses, so they
+// notice when nodes are replaced or reused.
+static bool validateAfterPass(Module& wasm,
+                              Pass* pass,
+                              WasmValidator::Flags flags,
+                              std::unordered_map<Function*, size_t>& hashes) {
+  auto& functions = wasm.functions;
+  std::vector<size_t> newHashes(functions.size());
+  std::vector<size_t> indexes(functions.size());
+  std::iota(indexes.begin(), indexes.end(), 0);
+  WorkStealingQueues::run(indexes, [&](size_t, size_t i) {
+    auto* func = functions[i].get();
+    if (!func->imported()) {
+      newHashes[i] = FunctionHasher::flexibleHashFunction(
+        func, [](Expression* curr, size_t& digest) {
+          rehash(digest, curr);
+          return false;
+        });
+    }
+  });
+  bool valid;
+  if (!hashes.empty() &&
+      (pass->isFunctionParallel() || !pass->modifiesBinaryenIR())) {
+    std::vector<Function*> changed;
+    for (size_t i = 0; i < functions.size(); i++) {
+      auto* func = functions[i].get();
+      if (!func->imported()) {
+        auto iter = hashes.find(func);
+        if (iter == hashes.end() || iter->second != newHashes[i]) {
+          changed.push_back(func);
+        }
+      }
+    }
+    valid = WasmValidator().validate(wasm, changed, flags);
+  } else {
+    valid = WasmValidator().validate(wasm, flags);
+  }
+  hashes.clear();
+  for (size_t i = 0; i < functions.size(); i++) {
+    if (!functions[i]->imported()) {
+      hashes[functions[i].get()] = newHashes[i];
+    }
+  }
+  return valid;
+}
+
 void PassRunner::run() {
   assert(!ran);
   ran = true;
 
+  if (!isNested && !options.profileFile.empty()) {
+    profiler = &PassProfiler::get(options.profileFile);
+  }
+
+  if (wasm->lazyFunctionBodies) {
+    // Passes may look at any function.
+    wasm->lazyFunctionBodies->materializeAll();
+  }
+
   static const int passDebug = getPassDebug();
   // Emit logging information when asked for. At passDebug level 1+ we log
   // the main passes, while in 2 we also log nested ones. Note that for
@@ -658,6 +733,8 @@ void PassRunner::run() {
     if (passDebug >= 3 && !isNested) {
       dumpWast("before", wasm);
     }
+    // The hashes of the functions as we last validated them.
+    std::unordered_map<Function*, size_t> validatedHashes;
     for (auto& pass : passes) {
       // ignoring the time, save a printout of the module before, in case this
       // pass breaks it, so we can print the before and after
@@ -672,6 +749,7 @@ void PassRunner::run() {
       }
       auto before = std::chrono::steady_clock::now();
       if (pass->isFunctionParallel()) {
+        handleBeforeEffects(pass.get());
         // function-parallel passes should get a new instance per function
         ModuleUtils::iterDefinedFunctions(
           *wasm, [&](Function* func) { runPassOnFunction(pass.get(), func); });
@@ -685,7 +763,8 @@ void PassRunner::run() {
       if (options.validate && !isNested) {
         // validate, ignoring the time
         std::cerr << "[PassRunner]   (validating)\n";
-        if (!WasmValidator().validate(*wasm, validationFlags)) {
+        if (!validateAfterPass(
+              *wasm, pass.get(), validationFlags, validatedHashes)) {
           std::cout << *wasm << '\n';
           if (passDebug >= 2) {
             Fatal() << "Last pass (" << pass->name
@@ -719,38 +798,50 @@ void PassRunner::run() {
     std::vector<Pass*> stack;
     auto flush = [&]() {
       if (stack.size() > 0) {
-        // run the stack of passes on all the functions, in parallel
-        size_t num = ThreadPool::get()->size();
-        std::vector<std::function<ThreadWorkState()>> doWorkers;
-        std::atomic<size_t> nextFunction;
-        nextFunction.store(0);
-        size_t numFunctions = wasm->functions.size();
-        for (size_t i = 0; i < num; i++) {
-          doWorkers.push_back([&]() {
-            auto index = nextFunction.fetch_add(1);
-            // get the next task, if there is one
-            if (index >= numFunctions) {
-              return ThreadWorkState::Finished; // nothing left
-            }
-            Function* func = this->wasm->functions[index].get();
-            if (!func->imported()) {
-              // do the current task: run all passes on this function
-              for (auto* pass : stack) {
-                runPassOnFunction(pass, func);
-              }
-            }
-            if (index + 1 == numFunctions) {
-              return ThreadWorkState::Finished; // we did the last one
-            }
-            return ThreadWorkState::More;
+        // run the stack of passes on all the functions, in parallel. To keep
+        // one huge function from being left for last while the other cores
+        // sit idle, schedule the functions largest-first by a cheap estimate
+        // of their size, which we also compute in parallel.
+        std::vector<size_t> defined;
+        for (size_t i = 0; i < wasm->functions.size(); i++) {
+          if (!wasm->functions[i]->imported()) {
+            defined.push_back(i);
+          }
+        }
+        std::vector<Index> sizes(wasm->functions.size());
+        WorkStealingQueues::run(defined, [&](size_t, size_t index) {
+          sizes[index] = Measurer::measure(wasm->functions[index]->body);
+        });
+        std::stable_sort(
+          defined.begin(), defined.end(), [&](size_t a, size_t b) {
+            return sizes[a] > sizes[b];
           });
+        // Functions that we optimized in an earlier run with the same passes
+        // can be taken from the cache, if there is one.
+        std::unique_ptr<FunctionCache> cache;
+        if (!isNested) {
+          cache = FunctionCache::create(*wasm, options, stack);
         }
-        ThreadPool::get()->work(doWorkers);
+        WorkStealingQueues::run(defined, [&](size_t, size_t index) {
+          // do the current task: run all passes on this function
+          Function* func = this->wasm->functions[index].get();
+          FunctionCache::Entry entry;
+          if (cache && cache->lookup(func, entry)) {
+            return;
+          }
+          for (auto* pass : stack) {
+            runPassOnFunction(pass, func);
+          }
+          if (cache) {
+            cache->store(func, entry);
+          }
+        });
       }
       stack.clear();
     };
     for (auto& pass : passes) {
       if (pass->isFunctionParallel()) {
+        handleBeforeEffects(pass.get());
         stack.push_back(pass.get());
       } else {
         flush();
@@ -759,6 +850,18 @@ void PassRunner::run() {
     }
     flush();
   }
+  if (profiler) {
+    profiler->write();
+  }
+  if (!isNested) {
+    BYN_DEBUG_WITH_TYPE("arena", {
+      auto stats = wasm->allocator.getStats();
+      std::cerr << "[PassRunner] arena: " << stats.allocatedBytes
+                << " bytes allocated in " << stats.chunks << " chunks of "
+                << stats.chunkBytes << " bytes in total (" << stats.wastedBytes
+                << " bytes wasted), in " << stats.arenas << " arenas\n";
+    });
+  }
 }
 
 void PassRunner::runOnFunction(Function* func) {
@@ -766,7 +869,11 @@ void PassRunner::runOnFunction(Function* func) {
     std::cerr << "[PassRunner] running passes on function " << func->name
               << std::endl;
   }
+  if (wasm->lazyFunctionBodies) {
+    wasm->lazyFunctionBodies->materialize(func);
+  }
   for (auto& pass : passes) {
+    handleBeforeEffects(pass.get());
     runPassOnFunction(pass.get(), func);
   }
 }
@@ -877,13 +984,21 @@ struct AfterEffectModuleChecker {
 };
 
 void PassRunner::runPass(Pass* pass) {
+  handleBeforeEffects(pass);
   std::unique_ptr<AfterEffectModuleChecker> checker;
   if (getPassDebug()) {
     checker = std::unique_ptr<AfterEffectModuleChecker>(
       new AfterEffectModuleChecker(wasm));
   }
+  std::optional<PassProfiler::Start> start;
+  if (profiler) {
+    start = profiler->start(*wasm);
+  }
   pass->run(this, wasm);
   handleAfterEffects(pass);
+  if (profiler) {
+    profiler->stop(*wasm, pass, *start);
+  }
   if (getPassDebug()) {
     checker->check();
   }
@@ -898,13 +1013,29 @@ void PassRunner::runPassOnFunction(Pass* pass, Function* func) {
     checker = std::unique_ptr<AfterEffectFunctionChecker>(
       new AfterEffectFunctionChecker(func));
   }
+  std::optional<PassProfiler::Start> start;
+  if (profiler) {
+    start = profiler->start(*wasm, func);
+  }
   instance->runOnFunction(this, wasm, func);
   handleAfterEffects(pass, func);
+  if (profiler) {
+    profiler->stop(*wasm, pass, *start);
+  }
   if (getPassDebug()) {
     checker->check();
   }
 }
 
+void PassRunner::handleBeforeEffects(Pass* pass) {
+  if (pass->modifiesBinaryenIR() && pass->addsEffects()) {
+    // The effects we computed for functions would be stale. Passes see them
+    // through the options, so they cannot be updated while a
+    // function-parallel pass runs, and we discard them here instead.
+    options.funcEffectsMap.reset();
+  }
+}
+
 void PassRunner::handleAfterEffects(Pass* pass, Function* func) {
   if (pass->modifiesBinaryenIR()) {
     // If Binaryen IR is modified, Stack IR must be cleared - it would
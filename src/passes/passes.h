@@ -29,6 +29,7 @@ Pass* createCoalesceLocalsPass();
 Pass* createCoalesceLocalsWithLearningPass();
 Pass* createCodeFoldingPass();
 Pass* createCodePushingPass();
+Pass* createCompactArenaPass();
 Pass* createConstHoistingPass();
 Pass* createConstantFieldPropagationPass();
 Pass* createDAEPass();
@@ -38,6 +39,7 @@ Pass* createDeadCodeEliminationPass();
 Pass* createDeNaNPass();
 Pass* createDeAlignPass();
 Pass* createDirectizePass();
+Pass* createDiscardGlobalEffectsPass();
 Pass* createDWARFDumpPass();
 Pass* createDuplicateImportEliminationPass();
 Pass* createDuplicateFunctionEliminationPass();
@@ -49,6 +51,7 @@ Pass* createFuncCastEmulationPass();
 Pass* createFullPrinterPass();
 Pass* createFunctionMetricsPass();
 Pass* createGenerateDynCallsPass();
+Pass* createGenerateGlobalEffectsPass();
 Pass* createGenerateI64DynCallsPass();
 Pass* createGenerateStackIRPass();
 Pass* createGlobalRefiningPass();
@@ -21,11 +21,25 @@
 
 namespace {
 bool colors_enabled = true;
+
+// The index of the stream's extensible storage where we mark streams that
+// colors are disabled for.
+int getDisabledIndex() {
+  static const int index = std::ios_base::xalloc();
+  return index;
+}
 } // anonymous namespace
 
 void Colors::setEnabled(bool enabled) { colors_enabled = enabled; }
 bool Colors::isEnabled() { return colors_enabled; }
 
+void Colors::disable(std::ostream& stream) {
+  stream.iword(getDisabledIndex()) = 1;
+}
+bool Colors::isEnabled(std::ostream& stream) {
+  return colors_enabled && !stream.iword(getDisabledIndex());
+}
+
 #if defined(__linux__) || defined(__APPLE__)
 #include <unistd.h>
 
@@ -35,7 +49,7 @@ void Colors::outputColorCode(std::ostream& stream, const char* colorCode) {
            (isatty(STDOUT_FILENO) &&
             (!getenv("COLORS") || getenv("COLORS")[0] != '0')); // implicit
   }();
-  if (has_color && colors_enabled) {
+  if (has_color && isEnabled(stream)) {
     stream << colorCode;
   }
 }
@@ -51,7 +65,7 @@ void Colors::outputColorCode(std::ostream& stream, const WORD& colorCode) {
   }();
   static HANDLE hStdout = GetStdHandle(STD_OUTPUT_HANDLE);
   static HANDLE hStderr = GetStdHandle(STD_ERROR_HANDLE);
-  if (has_color && colors_enabled)
+  if (has_color && isEnabled(stream))
     SetConsoleTextAttribute(&stream == &std::cout ? hStdout : hStderr,
                             colorCode);
 }
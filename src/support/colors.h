@@ -24,6 +24,13 @@ namespace Colors {
 void setEnabled(bool enabled);
 bool isEnabled();
 
+// Disables colors when printing to a particular stream. Unlike setEnabled(),
+// this does not affect other threads, so it can be used when printing in
+// parallel.
+void disable(std::ostream& stream);
+// Whether colors are enabled both globally and for a stream.
+bool isEnabled(std::ostream& stream);
+
 #if defined(__linux__) || defined(__APPLE__)
 void outputColorCode(std::ostream& stream, const char* colorCode);
 inline void normal(std::ostream& stream) { outputColorCode(stream, "\033[0m"); }
@@ -22,6 +22,13 @@
 #include <iostream>
 #include <limits>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #define DEBUG_TYPE "file"
 
 std::vector<char> wasm::read_stdin() {
@@ -95,6 +102,55 @@ std::string wasm::read_possible_response_file(const std::string& input) {
   return wasm::read_file<std::string>(input.substr(1), Flags::Text);
 }
 
+wasm::MappedFile::MappedFile(const std::string& filename) {
+  if (filename == "-") {
+    buffer = read_stdin();
+    data = buffer.data();
+    size = buffer.size();
+    return;
+  }
+#ifndef _WIN32
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    struct stat info;
+    // An empty file cannot be mapped, and neither can things like pipes, so
+    // those are read normally below.
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0 &&
+        uint64_t(info.st_size) < std::numeric_limits<size_t>::max()) {
+      void* addr =
+        mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr != MAP_FAILED) {
+        BYN_TRACE("Mapped '" << filename << "'\n");
+        data = static_cast<const char*>(addr);
+        size = size_t(info.st_size);
+        mapped = true;
+      }
+    }
+    close(fd);
+  }
+  if (mapped) {
+    return;
+  }
+#endif
+  buffer = read_file<std::vector<char>>(filename, Flags::Binary);
+  data = buffer.data();
+  size = buffer.size();
+}
+
+wasm::MappedFile::MappedFile(std::vector<char>&& contents)
+  : buffer(std::move(contents)) {
+  data = buffer.data();
+  size = buffer.size();
+}
+
+wasm::MappedFile::~MappedFile() {
+#ifndef _WIN32
+  if (mapped) {
+    munmap(const_cast<char*>(data), size);
+  }
+#endif
+}
+
 // Explicit instantiations for the explicit specializations.
 template std::string wasm::read_file<>(const std::string&, Flags::BinaryOption);
 template std::vector<char> wasm::read_file<>(const std::string&,
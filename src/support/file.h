@@ -23,6 +23,7 @@
 
 #include <fstream>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -48,6 +49,28 @@ extern template std::vector<char> read_file<>(const std::string&,
 // is not a response file, return it as is.
 std::string read_possible_response_file(const std::string&);
 
+// The read-only contents of a binary file. Where possible the file is mapped
+// into memory rather than read, so that large inputs are not copied, and pages
+// are only loaded as they are used.
+class MappedFile {
+public:
+  explicit MappedFile(const std::string& filename);
+  // Contents that were already read, e.g. from stdin.
+  explicit MappedFile(std::vector<char>&& contents);
+  ~MappedFile();
+
+  std::string_view view() const { return {data, size}; }
+
+private:
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  const char* data = nullptr;
+  size_t size = 0;
+  bool mapped = false;
+  // The contents when the file is not mapped.
+  std::vector<char> buffer;
+};
+
 class Output {
 public:
   // An empty filename or "-" will open stdout instead.
@@ -0,0 +1,288 @@
+/*
+ * Copyright 2022 WebAssembly Community Group participants
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//
+// A map from pointers to small values, for when there are very many of them,
+// like a side table with an entry for every expression in a function. The
+// entries are stored in a single array, using open addressing with linear
+// probing, so unlike std::unordered_map there is no allocation, no next
+// pointer and no bucket per entry, which makes the map smaller, and lookups do
+// not need to chase pointers.
+//
+// The API is a subset of std::unordered_map's, with two differences:
+//
+//  * Inserting or erasing invalidates all iterators, and pointers and
+//    references to entries. (Lookups do not, so pointers into a map that is
+//    not modified remain valid.)
+//  * The null pointer cannot be used as a key, as it marks empty slots.
+//
+
+#ifndef wasm_support_pointer_map_h
+#define wasm_support_pointer_map_h
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace wasm {
+
+template<typename Key, typename T> class PointerMap {
+  static_assert(std::is_pointer_v<Key>, "PointerMap keys must be pointers");
+
+public:
+  using key_type = Key;
+  using mapped_type = T;
+  using value_type = std::pair<Key, T>;
+  using size_type = size_t;
+
+private:
+  // The slots, whose number is zero or a power of two. Empty slots have a null
+  // key.
+  std::vector<value_type> slots;
+  size_t used = 0;
+  // The amount to shift a hash by to get an index into the slots.
+  size_t shift = 64;
+
+  static const size_t MinSlots = 8;
+
+  size_t getIdealIndex(Key key) const {
+    // Fibonacci hashing. The low bits of pointers are usually zero due to
+    // alignment, so we use the high bits of the product.
+    return size_t((uint64_t(uintptr_t(key)) * 0x9e3779b97f4a7c15ULL) >> shift);
+  }
+
+  size_t getMask() const { return slots.size() - 1; }
+
+  // Returns the index of the slot with a key, or of the empty slot where it
+  // would be inserted.
+  size_t findSlot(Key key) const {
+    assert(key && !slots.empty());
+    auto mask = getMask();
+    auto i = getIdealIndex(key);
+    while (slots[i].first && slots[i].first != key) {
+      i = (i + 1) & mask;
+    }
+    return i;
+  }
+
+  void rehash(size_t numSlots) {
+    assert(numSlots >= MinSlots && (numSlots & (numSlots - 1)) == 0);
+    std::vector<value_type> old(numSlots);
+    old.swap(slots);
+    shift = 64;
+    while (numSlots > 1) {
+      numSlots >>= 1;
+      shift--;
+    }
+    for (auto& slot : old) {
+      if (slot.first) {
+        slots[findSlot(slot.first)] = std::move(slot);
+      }
+    }
+  }
+
+  // Grows if needed so that one more entry can be added, keeping the load
+  // factor at most 3/4.
+  void reserveOneMore() {
+    if (slots.empty()) {
+      rehash(MinSlots);
+    } else if ((used + 1) * 4 > slots.size() * 3) {
+      rehash(slots.size() * 2);
+    }
+  }
+
+  void eraseSlot(size_t i) {
+    // Move back any later entries in the same run that would no longer be
+    // found once this slot is empty, so that we do not need tombstones.
+    auto mask = getMask();
+    auto j = i;
+    while (1) {
+      j = (j + 1) & mask;
+      if (!slots[j].first) {
+        break;
+      }
+      // The entry at j can stay if its ideal slot is cyclically in (i, j].
+      auto k = getIdealIndex(slots[j].first);
+      if (i <= j ? (i < k && k <= j) : (i < k || k <= j)) {
+        continue;
+      }
+      slots[i] = std::move(slots[j]);
+      i = j;
+    }
+    slots[i] = value_type();
+    used--;
+  }
+
+  template<typename Parent, typename Value> struct IteratorBase {
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename PointerMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Value*;
+    using reference = Value&;
+
+    Parent* parent;
+    size_t index;
+
+    IteratorBase(Parent* parent, size_t index) : parent(parent), index(index) {
+      skipEmpty();
+    }
+
+    void skipEmpty() {
+      while (index < parent->slots.size() && !parent->slots[index].first) {
+        index++;
+      }
+    }
+
+    bool operator==(const IteratorBase& other) const {
+      return index == other.index;
+    }
+    bool operator!=(const IteratorBase& other) const {
+      return !(*this == other);
+    }
+
+    IteratorBase& operator++() {
+      index++;
+      skipEmpty();
+      return *this;
+    }
+
+    reference operator*() const { return parent->slots[index]; }
+    pointer operator->() const { return &parent->slots[index]; }
+  };
+
+public:
+  PointerMap() = default;
+  PointerMap(const PointerMap& other) = default;
+  PointerMap(PointerMap&& other) noexcept { swap(other); }
+
+  PointerMap& operator=(const PointerMap& other) = default;
+  PointerMap& operator=(PointerMap&& other) noexcept {
+    clear();
+    swap(other);
+    return *this;
+  }
+
+  using iterator = IteratorBase<PointerMap, value_type>;
+  using const_iterator = IteratorBase<const PointerMap, const value_type>;
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, slots.size()); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, slots.size()); }
+
+  size_t size() const { return used; }
+  bool empty() const { return used == 0; }
+
+  void clear() {
+    slots.clear();
+    slots.shrink_to_fit();
+    used = 0;
+    shift = 64;
+  }
+
+  void reserve(size_t size) {
+    size_t numSlots = MinSlots;
+    while (numSlots * 3 < size * 4) {
+      numSlots *= 2;
+    }
+    if (numSlots > slots.size()) {
+      rehash(numSlots);
+    }
+  }
+
+  iterator find(Key key) {
+    if (empty()) {
+      return end();
+    }
+    auto i = findSlot(key);
+    return slots[i].first ? iterator(this, i) : end();
+  }
+
+  const_iterator find(Key key) const {
+    if (empty()) {
+      return end();
+    }
+    auto i = findSlot(key);
+    return slots[i].first ? const_iterator(this, i) : end();
+  }
+
+  size_t count(Key key) const { return find(key) == end() ? 0 : 1; }
+
+  T& operator[](Key key) {
+    if (!empty()) {
+      auto i = findSlot(key);
+      if (slots[i].first) {
+        return slots[i].second;
+      }
+    }
+    reserveOneMore();
+    auto i = findSlot(key);
+    slots[i].first = key;
+    used++;
+    return slots[i].second;
+  }
+
+  T& at(Key key) {
+    auto iter = find(key);
+    assert(iter != end());
+    return iter->second;
+  }
+
+  const T& at(Key key) const {
+    auto iter = find(key);
+    assert(iter != end());
+    return iter->second;
+  }
+
+  void erase(iterator iter) { eraseSlot(iter.index); }
+
+  size_t erase(Key key) {
+    auto iter = find(key);
+    if (iter == end()) {
+      return 0;
+    }
+    erase(iter);
+    return 1;
+  }
+
+  void swap(PointerMap& other) {
+    slots.swap(other.slots);
+    std::swap(used, other.used);
+    std::swap(shift, other.shift);
+  }
+
+  bool operator==(const PointerMap& other) const {
+    if (size() != other.size()) {
+      return false;
+    }
+    for (auto& [key, value] : *this) {
+      auto iter = other.find(key);
+      if (iter == other.end() || !(iter->second == value)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  bool operator!=(const PointerMap& other) const { return !(*this == other); }
+};
+
+} // namespace wasm
+
+#endif // wasm_support_pointer_map_h
@@ -68,6 +68,14 @@ public:
     }
   }
 
+  void push_back(T&& x) {
+    if (usedFixed < N) {
+      fixed[usedFixed++] = std::move(x);
+    } else {
+      flexible.push_back(std::move(x));
+    }
+  }
+
   template<typename... ArgTypes> void emplace_back(ArgTypes&&... Args) {
     if (usedFixed < N) {
       new (&fixed[usedFixed++]) T(std::forward<ArgTypes>(Args)...);
@@ -45,99 +45,90 @@ static std::mutex debug;
 
 namespace wasm {
 
-// Thread
+// ThreadPool
 
-Thread::Thread(ThreadPool* parent) : parent(parent) {
-  assert(!parent->isRunning());
-  thread = make_unique<std::thread>(mainLoop, this);
-}
+// Global threadPool state. We have a singleton pool, which is shared by all the
+// users of parallelism, including nested ones.
+
+static std::unique_ptr<ThreadPool> pool;
 
-Thread::~Thread() {
+std::mutex ThreadPool::creationMutex;
+
+ThreadPool::~ThreadPool() {
   {
     std::lock_guard<std::mutex> lock(mutex);
-    // notify the thread that it can exit
+    // notify the threads that they can exit
     done = true;
-    condition.notify_one();
+    condition.notify_all();
   }
-  thread->join();
-}
-
-void Thread::work(std::function<ThreadWorkState()> doWork_) {
-  // TODO: fancy work stealing
-  DEBUG_THREAD("send work to thread\n");
-  {
-    std::lock_guard<std::mutex> lock(mutex);
-    // notify the thread that it can do some work
-    doWork = doWork_;
-    condition.notify_one();
-    DEBUG_THREAD("work sent\n");
+  for (auto& thread : threads) {
+    thread->join();
   }
 }
 
-void Thread::mainLoop(void* self_) {
-  auto* self = static_cast<Thread*>(self_);
-  while (1) {
-    DEBUG_THREAD("checking for work\n");
-    {
-      std::unique_lock<std::mutex> lock(self->mutex);
-      if (self->doWork) {
-        DEBUG_THREAD("doing work\n");
-        // run tasks until they are all done
-        while (self->doWork() == ThreadWorkState::More) {
-        }
-        self->doWork = nullptr;
-      } else if (self->done) {
-        DEBUG_THREAD("done\n");
-        return;
-      }
-    }
-    self->parent->notifyThreadIsReady();
-    {
-      std::unique_lock<std::mutex> lock(self->mutex);
-      if (!self->done && !self->doWork) {
-        DEBUG_THREAD("thread waiting\n");
-        self->condition.wait(lock);
-      }
-    }
-  }
-}
-
-// ThreadPool
-
-// Global threadPool state. We have a singleton pool, which can only be
-// used from one place at a time.
-
-static std::unique_ptr<ThreadPool> pool;
-
-std::mutex ThreadPool::creationMutex;
-std::mutex ThreadPool::workMutex;
-std::mutex ThreadPool::threadMutex;
-
 void ThreadPool::initialize(size_t num) {
   if (num == 1) {
     return; // no multiple cores, don't create threads
   }
   DEBUG_POOL("initialize()\n");
-  std::unique_lock<std::mutex> lock(threadMutex);
-  // initial state before first resetThreadsAreReady()
-  ready.store(threads.size());
-  resetThreadsAreReady();
-  for (size_t i = 0; i < num; i++) {
+  // The thread that calls work() helps out, so we need one less helper thread
+  // than the number of cores.
+  for (size_t i = 0; i < num - 1; i++) {
     try {
-      threads.emplace_back(make_unique<Thread>(this));
+      threads.emplace_back(
+        make_unique<std::thread>([this]() { workerLoop(); }));
     } catch (std::system_error&) {
       // failed to create a thread - don't use multithreading, as if num cores
       // == 1
       DEBUG_POOL("could not create thread\n");
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        condition.notify_all();
+      }
+      for (auto& thread : threads) {
+        thread->join();
+      }
       threads.clear();
+      done = false;
       return;
     }
   }
-  DEBUG_POOL("initialize() waiting\n");
-  condition.wait(lock, [this]() { return areThreadsReady(); });
   DEBUG_POOL("initialize() is done\n");
 }
 
+void ThreadPool::workerLoop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (1) {
+    if (done) {
+      DEBUG_THREAD("done\n");
+      return;
+    }
+    if (tasks.empty()) {
+      DEBUG_THREAD("thread waiting\n");
+      condition.wait(lock);
+      continue;
+    }
+    auto task = tasks.front();
+    tasks.pop_front();
+    DEBUG_THREAD("doing work\n");
+    runTask(lock, task);
+  }
+}
+
+void ThreadPool::runTask(std::unique_lock<std::mutex>& lock, Task task) {
+  lock.unlock();
+  // run the task until it is all done
+  while ((*task.doWork)() == ThreadWorkState::More) {
+  }
+  lock.lock();
+  assert(task.job->remaining > 0);
+  if (--task.job->remaining == 0) {
+    // Wake up whoever is waiting on the job.
+    condition.notify_all();
+  }
+}
+
 size_t ThreadPool::getNumCores() {
 #ifdef __EMSCRIPTEN__
   return 1;
@@ -167,63 +158,121 @@ ThreadPool* ThreadPool::get() {
 
 void ThreadPool::work(
   std::vector<std::function<ThreadWorkState()>>& doWorkers) {
-  size_t num = threads.size();
-  // If no multiple cores, or on a side thread, do not use worker threads
-  if (num == 0) {
-    // just run sequentially
+  assert(doWorkers.size() > 0);
+  // If no multiple cores, just run sequentially
+  if (threads.empty()) {
     DEBUG_POOL("work() sequentially\n");
-    assert(doWorkers.size() > 0);
-    while (doWorkers[0]() == ThreadWorkState::More) {
+    for (auto& doWork : doWorkers) {
+      while (doWork() == ThreadWorkState::More) {
+      }
     }
     return;
   }
   // run in parallel on threads
-  // TODO: fancy work stealing
   DEBUG_POOL("work() on threads\n");
-  // lock globally on doing work in the pool - the threadPool can only be used
-  // from one thread at a time, all others must wait patiently
-  std::lock_guard<std::mutex> poolLock(workMutex);
-  assert(doWorkers.size() == num);
-  assert(!running);
-  DEBUG_POOL("running = true\n");
-  running = true;
-  std::unique_lock<std::mutex> lock(threadMutex);
-  resetThreadsAreReady();
-  for (size_t i = 0; i < num; i++) {
-    threads[i]->work(doWorkers[i]);
+  Job job;
+  job.remaining = doWorkers.size();
+  std::unique_lock<std::mutex> lock(mutex);
+  // If this is nested work, queue it up in front of the existing tasks, as
+  // whoever sent it is blocked until it finishes.
+  bool nested = runningJobs > 0;
+  runningJobs++;
+  for (auto& doWork : doWorkers) {
+    if (nested) {
+      tasks.push_front(Task{&job, &doWork});
+    } else {
+      tasks.push_back(Task{&job, &doWork});
+    }
+  }
+  condition.notify_all();
+  // Help to run our own tasks while we wait. We do not pick up tasks from other
+  // jobs here, as they may be waiting on locks that our caller holds.
+  while (job.remaining > 0) {
+    auto iter = std::find_if(tasks.begin(), tasks.end(), [&](const Task& task) {
+      return task.job == &job;
+    });
+    if (iter != tasks.end()) {
+      auto task = *iter;
+      tasks.erase(iter);
+      DEBUG_POOL("helping with work\n");
+      runTask(lock, task);
+    } else {
+      DEBUG_POOL("waiting for work to finish\n");
+      condition.wait(lock);
+    }
   }
-  DEBUG_POOL("main thread waiting\n");
-  condition.wait(lock, [this]() { return areThreadsReady(); });
-  DEBUG_POOL("main thread done waiting\n");
-  DEBUG_POOL("running = false\n");
-  running = false;
+  runningJobs--;
   DEBUG_POOL("work() is done\n");
 }
 
-size_t ThreadPool::size() { return std::max(size_t(1), threads.size()); }
+size_t ThreadPool::size() { return threads.size() + 1; }
 
 bool ThreadPool::isRunning() {
   DEBUG_POOL("check if running\n");
-  return running;
+  std::lock_guard<std::mutex> lock(mutex);
+  return runningJobs > 0;
 }
 
-void ThreadPool::notifyThreadIsReady() {
-  DEBUG_POOL("notify thread is ready\n";)
-  std::lock_guard<std::mutex> lock(threadMutex);
-  ready.fetch_add(1);
-  condition.notify_one();
+// WorkStealingQueues
+
+WorkStealingQueues::WorkStealingQueues(size_t numWorkers,
+                                       const std::vector<size_t>& items) {
+  assert(numWorkers > 0);
+  for (size_t i = 0; i < numWorkers; i++) {
+    queues.emplace_back(make_unique<Queue>());
+  }
+  for (size_t i = 0; i < items.size(); i++) {
+    queues[i % numWorkers]->items.push_back(items[i]);
+  }
 }
 
-void ThreadPool::resetThreadsAreReady() {
-  DEBUG_POOL("reset threads are ready\n";)
-  auto old = ready.exchange(0);
-  WASM_UNUSED(old);
-  assert(old == threads.size());
+bool WorkStealingQueues::getNext(size_t worker, size_t& item) {
+  assert(worker < queues.size());
+  {
+    auto& own = *queues[worker];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.items.empty()) {
+      item = own.items.front();
+      own.items.pop_front();
+      return true;
+    }
+  }
+  // Our own work is done; steal from the others, starting with our neighbor so
+  // that thieves spread out over the victims. Nothing is ever added to a queue
+  // after construction, so once every queue has been seen empty we are done.
+  for (size_t i = 1; i < queues.size(); i++) {
+    auto& other = *queues[(worker + i) % queues.size()];
+    std::lock_guard<std::mutex> lock(other.mutex);
+    if (!other.items.empty()) {
+      DEBUG_THREAD("stealing work\n");
+      item = other.items.back();
+      other.items.pop_back();
+      return true;
+    }
+  }
+  return false;
 }
 
-bool ThreadPool::areThreadsReady() {
-  DEBUG_POOL("are threads ready?\n";)
-  return ready.load() == threads.size();
+void WorkStealingQueues::run(const std::vector<size_t>& items,
+                             std::function<void(size_t, size_t)> work) {
+  if (items.empty()) {
+    return;
+  }
+  auto* pool = ThreadPool::get();
+  size_t num = pool->size();
+  WorkStealingQueues queues(num, items);
+  std::vector<std::function<ThreadWorkState()>> doWorkers;
+  for (size_t i = 0; i < num; i++) {
+    doWorkers.push_back([&, i]() {
+      size_t item;
+      if (!queues.getNext(i, item)) {
+        return ThreadWorkState::Finished;
+      }
+      work(i, item);
+      return ThreadWorkState::More;
+    });
+  }
+  pool->work(doWorkers);
 }
 
 } // namespace wasm
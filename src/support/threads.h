@@ -23,6 +23,7 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -37,57 +38,54 @@ namespace wasm {
 // or are we finished for now.
 enum class ThreadWorkState { More, Finished };
 
-class ThreadPool;
-
 //
-// A helper thread.
+// A pool of helper threads, which runs tasks.
 //
-// You can only create and destroy these on the main thread.
+// There is only one, to avoid recursive pools using too many cores. The pool
+// is re-entrant: a task running on the pool may itself call work(), in which
+// case the new tasks are queued up for the idle threads, and the calling thread
+// helps to execute them while it waits for them to finish (rather than
+// blocking a core). That lets nested fork/join parallelism, like a parallel
+// analysis launched from inside a function-parallel pass, still scale across
+// all the cores.
 //
 
-class Thread {
-  ThreadPool* parent;
-  std::unique_ptr<std::thread> thread;
-  std::mutex mutex;
-  std::condition_variable condition;
-  bool done = false;
-  std::function<ThreadWorkState()> doWork = nullptr;
-
-public:
-  Thread(ThreadPool* parent);
-  ~Thread();
-
-  // Start to do work, calling doWork() until
-  // it returns false.
-  void work(std::function<ThreadWorkState()> doWork);
+class ThreadPool {
+  // A set of tasks sent to the pool by one call to work().
+  struct Job {
+    // The number of tasks in this job that have not finished yet.
+    size_t remaining;
+  };
 
-private:
-  static void mainLoop(void* self);
-};
+  struct Task {
+    Job* job;
+    std::function<ThreadWorkState()>* doWork;
+  };
 
-//
-// A pool of helper threads.
-//
-// There is only one, to avoid recursive pools using too many cores.
-//
+  std::vector<std::unique_ptr<std::thread>> threads;
 
-class ThreadPool {
-  std::vector<std::unique_ptr<Thread>> threads;
-  bool running = false;
+  // The mutex and condition protect all the following state. The condition is
+  // notified both when new tasks are queued and when a job finishes.
+  std::mutex mutex;
   std::condition_variable condition;
-  std::atomic<size_t> ready;
+  std::deque<Task> tasks;
+  size_t runningJobs = 0;
+  bool done = false;
 
   // A mutex for creating the pool safely
   static std::mutex creationMutex;
-  // A mutex for work() so that the pool can only work on one
-  // thing at a time
-  static std::mutex workMutex;
-  // A mutex for communication with the worker threads
-  static std::mutex threadMutex;
+
+public:
+  ~ThreadPool();
 
 private:
   void initialize(size_t num);
 
+  void workerLoop();
+
+  // Runs a task (with the lock not held), and marks it as finished.
+  void runTask(std::unique_lock<std::mutex>& lock, Task task);
+
 public:
   // Get the number of cores we can use.
   static size_t getNumCores();
@@ -95,23 +93,53 @@ public:
   // Get the singleton threadpool.
   static ThreadPool* get();
 
-  // Execute a bunch of tasks by the pool. This calls
-  // getTask() (in a thread-safe manner) to get tasks, and
-  // sends them to workers to be executed. This method
-  // blocks until all tasks are complete.
+  // Execute a bunch of tasks by the pool. Each of the given functions is run as
+  // a task, and is called until it returns ThreadWorkState::Finished. This
+  // method blocks until all tasks are complete, while helping to run them on
+  // the calling thread. It may be called from inside a task.
   void work(std::vector<std::function<ThreadWorkState()>>& doWorkers);
 
+  // The number of threads that can work on tasks at once (the helper threads
+  // plus the thread that calls work()), which is also the number of tasks
+  // callers should split their work into.
   size_t size();
 
+  // Whether any work is currently being done on the pool.
   bool isRunning();
+};
 
-  // Called by helper threads when they are free and ready.
-  void notifyThreadIsReady();
+//
+// Work-stealing queues for distributing a list of items among workers.
+//
+// Items are dealt out round-robin to one deque per worker, in the order they
+// are given. Each worker takes items from the front of its own deque, and when
+// that is empty it steals from the back of another worker's deque. If the
+// items are sorted by decreasing cost then every worker starts on one of the
+// largest items and the small ones fill in the gaps at the end, which keeps the
+// tail bounded by the single largest item rather than by unlucky ordering.
+//
 
-private:
-  void resetThreadsAreReady();
+class WorkStealingQueues {
+  struct Queue {
+    std::mutex mutex;
+    std::deque<size_t> items;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;
 
-  bool areThreadsReady();
+public:
+  WorkStealingQueues(size_t numWorkers, const std::vector<size_t>& items);
+
+  // Get the next item for a worker. Returns false if there is nothing left to
+  // do anywhere.
+  bool getNext(size_t worker, size_t& item);
+
+  // Runs work(worker, item) on the pool for each of the given items, using a
+  // set of work-stealing queues. The worker index is in [0, pool size), and no
+  // two items are processed at once with the same worker index, so callers can
+  // use it to keep per-worker state.
+  static void run(const std::vector<size_t>& items,
+                  std::function<void(size_t, size_t)> work);
 };
 
 // Verify a code segment is only entered once. Usage:
@@ -248,6 +248,25 @@ struct OptimizationOptions : public ToolOptions {
            Options::Arguments::Zero,
            [this](Options*, const std::string&) {
              passOptions.zeroFilledMemory = true;
+           })
+      .add("--function-cache-dir",
+           "-fcd",
+           "Cache optimized functions in this (existing) directory, and reuse "
+           "them when optimizing the same functions again",
+           OptimizationOptionsCategory,
+           Options::Arguments::One,
+           [this](Options*, const std::string& argument) {
+             passOptions.functionCacheDir = argument;
+           })
+      .add("--pass-profile",
+           "-pp",
+           "Write the time, allocations and code size changes of each pass on "
+           "each function to this file, as CSV if it ends in .csv, and as a "
+           "Chrome trace otherwise",
+           OptimizationOptionsCategory,
+           Options::Arguments::One,
+           [this](Options*, const std::string& argument) {
+             passOptions.profileFile = argument;
            });
 
     // add passes in registry
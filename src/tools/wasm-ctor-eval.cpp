@@ -141,6 +141,9 @@ std::unique_ptr<Module> buildEnvModule(Module& wasm) {
 // that there are not arguments passed to main, etc.
 static bool ignoreExternalInput = false;
 
+// Whether to run functions in the interpreter's bytecode tier.
+static bool useBytecode = false;
+
 struct CtorEvalExternalInterface : EvallingModuleRunner::ExternalInterface {
   Module* wasm;
   EvallingModuleRunner* instance;
@@ -801,6 +804,7 @@ void evalCtors(Module& wasm,
   try {
     // create an instance for evalling
     EvallingModuleRunner instance(wasm, &interface, linkedInstances);
+    instance.useBytecode = useBytecode;
     // go one by one, in order, until we fail
     // TODO: if we knew priorities, we could reorder?
     for (auto& ctor : ctors) {
@@ -920,6 +924,13 @@ int main(int argc, const char* argv[]) {
          [&](Options* o, const std::string& argument) {
            ignoreExternalInput = true;
          })
+    .add("--bytecode",
+         "-b",
+         "Run functions in the bytecode interpreter when possible, instead of "
+         "walking the tree",
+         WasmCtorEvalOption,
+         Options::Arguments::Zero,
+         [&](Options* o, const std::string& argument) { useBytecode = true; })
     .add_positional("INFILE",
                     Options::Arguments::One,
                     [](Options* o, const std::string& argument) {
@@ -227,6 +227,7 @@ int main(int argc, const char* argv[]) {
   Module wasm;
   options.applyFeatures(wasm);
   ModuleReader reader;
+  LazyFunctionBodies lazyFunctionBodies;
   // If we are not writing output then we definitely don't need to read debug
   // info, as it does not affect the metadata we will emit. (However, if we
   // emit output then definitely load the names section so that we roundtrip
@@ -241,8 +242,10 @@ int main(int argc, const char* argv[]) {
     // Note that the one case we do need function bodies for, pthreads + EM_ASM
     // parsing, requires special handling. The start function has code that we
     // parse in order to find the EM_ASMs, and for that reason the binary reader
-    // will still parse the start function even in this mode.
-    reader.setSkipFunctionBodies(true);
+    // will still parse the start function even in this mode. The other is
+    // EM_JS functions, whose bodies are read to find the address of their code,
+    // and we decode those on demand below.
+    reader.setLazyFunctionBodies(&lazyFunctionBodies);
   }
   try {
     reader.read(infile, wasm, inputSourceMapFilename);
@@ -256,6 +259,24 @@ int main(int argc, const char* argv[]) {
     Fatal() << "error in parsing wasm source map";
   }
 
+  if (!writeOutput) {
+    for (auto& curr : wasm.exports) {
+      if (curr->kind == ExternalKind::Function &&
+          curr->name.startsWith("__em_js__")) {
+        try {
+          lazyFunctionBodies.materialize(wasm.getFunction(curr->value));
+        } catch (ParseException& p) {
+          p.dump(std::cerr);
+          std::cerr << '\n';
+          Fatal() << "error in parsing input";
+        }
+      }
+    }
+    // Nothing else needs the function bodies, so the passes below can run on
+    // the placeholders.
+    lazyFunctionBodies.skipRemaining();
+  }
+
   BYN_TRACE_WITH_TYPE("emscripten-dump", "Module before:\n");
   BYN_DEBUG_WITH_TYPE("emscripten-dump", std::cerr << &wasm);
 
@@ -46,6 +46,7 @@ Name GET("get");
 struct ShellOptions : public Options {
   Name entry;
   std::set<size_t> skipped;
+  bool bytecode = false;
 
   const std::string WasmShellOption = "wasm-shell options";
 
@@ -75,6 +76,13 @@ struct ShellOptions : public Options {
                i = ending + 1;
              }
            })
+      .add("--bytecode",
+           "-b",
+           "Run functions in the bytecode interpreter when possible, instead "
+           "of walking the tree",
+           WasmShellOption,
+           Options::Arguments::Zero,
+           [this](Options*, const std::string&) { bytecode = true; })
       .add_positional("INFILE",
                       Options::Arguments::One,
                       [](Options* o, const std::string& argument) {
@@ -99,6 +107,7 @@ protected:
       std::make_shared<ShellExternalInterface>(linkedInstances);
     auto tempInstance = std::make_shared<ModuleRunner>(
       *wasm, tempInterface.get(), linkedInstances);
+    tempInstance->useBytecode = options.bytecode;
     interfaces[wasm->name].swap(tempInterface);
     instances[wasm->name].swap(tempInstance);
   }
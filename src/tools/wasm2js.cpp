@@ -59,10 +59,10 @@ static void optimizeWasm(Module& wasm, PassOptions options) {
   OptimizeForJS().run(&runner, &wasm);
 }
 
-template<typename T> static void printJS(Ref ast, T& output) {
-  JSPrinter jser(true, true, ast);
+static void printJS(Ref ast, Output& output) {
+  JSPrinter jser(true, true, ast, output.getStream());
   jser.printAst();
-  output << jser.buffer << '\n';
+  output << '\n';
 }
 
 // Traversals
@@ -529,7 +529,14 @@ static void emitWasm(Module& wasm,
   Wasm2JSBuilder wasm2js(flags, options);
   auto js = wasm2js.processWasm(&wasm, name);
   if (options.optimizeLevel >= 2) {
-    optimizeJS(js, flags);
+    // All the code is in the body of the asm function. Each statement there
+    // (most of which are functions) can be optimized by itself, so we do that
+    // in parallel.
+    Ref body = js[1][0][3];
+    std::vector<size_t> items(body->size());
+    std::iota(items.begin(), items.end(), 0);
+    WorkStealingQueues::run(
+      items, [&](size_t, size_t i) { optimizeJS(body[i], flags); });
   }
   Wasm2JSGlue glue(wasm, output, flags, name);
   glue.emitPre();
@@ -587,9 +594,9 @@ private:
   }
 
   void emitFunction(Ref func) {
-    JSPrinter jser(true, true, func);
+    JSPrinter jser(true, true, func, out.getStream());
     jser.printAst();
-    out << jser.buffer << std::endl;
+    out.getStream() << std::endl;
   }
 };
 
@@ -22,7 +22,10 @@
 #define wasm_wasm_binary_h
 
 #include <cassert>
+#include <mutex>
+#include <optional>
 #include <ostream>
+#include <string_view>
 #include <type_traits>
 
 #include "ir/import-utils.h"
@@ -1391,7 +1394,9 @@ private:
   std::vector<std::pair<size_t, const Function::DebugLocation*>>
     sourceMapLocations;
   size_t sourceMapLocationsSizeAtSectionStart;
-  Function::DebugLocation lastDebugLocation;
+  // The last location written to the source map, if any. Consecutive equal
+  // locations are only written once.
+  std::optional<Function::DebugLocation> lastDebugLocation;
 
   std::unique_ptr<ImportInfo> importInfo;
 
@@ -1412,22 +1417,40 @@ private:
   std::unordered_map<Name, Index> stringIndexes;
 
   void prepare();
+
+  // Whether to encode function bodies in parallel.
+  bool shouldWriteFunctionsInParallel();
+  // Encode the function bodies into separate buffers in parallel, then append
+  // them to the output in order. Each worker thread uses its own
+  // WasmBinaryWriter with copies of the module-level indexes. Source map and
+  // DWARF locations are recorded relative to the start of each body, and
+  // shifted to where the body ends up when it is appended.
+  void writeFunctionsInParallel(bool DWARF);
+
+  // Creates a writer for encoding function bodies in parallel with the given
+  // one, into the given buffer.
+  WasmBinaryWriter(WasmBinaryWriter& parent, BufferWithRandomAccess& o);
 };
 
+class LazyFunctionBodies;
+class MappedFile;
+
 class WasmBinaryBuilder {
   Module& wasm;
   MixedArena& allocator;
-  const std::vector<char>& input;
+  // The input is not copied, and must outlive the builder.
+  std::string_view input;
   std::istream* sourceMap;
   std::pair<uint32_t, Function::DebugLocation> nextDebugLocation;
   bool debugInfo = true;
   bool DWARF = false;
   bool skipFunctionBodies = false;
+  LazyFunctionBodies* lazyFunctionBodies = nullptr;
 
   size_t pos = 0;
   Index startIndex = -1;
   std::set<Function::DebugLocation> debugLocation;
-  size_t codeSectionLocation;
+  size_t codeSectionLocation = 0;
 
   std::set<BinaryConsts::Section> seenSections;
 
@@ -1435,15 +1458,24 @@ class WasmBinaryBuilder {
   std::vector<HeapType> types;
 
 public:
+  WasmBinaryBuilder(Module& wasm, FeatureSet features, std::string_view input);
   WasmBinaryBuilder(Module& wasm,
                     FeatureSet features,
-                    const std::vector<char>& input);
+                    const std::vector<char>& input)
+    : WasmBinaryBuilder(wasm, features, {input.data(), input.size()}) {}
 
   void setDebugInfo(bool value) { debugInfo = value; }
   void setDWARF(bool value) { DWARF = value; }
   void setSkipFunctionBodies(bool skipFunctionBodies_) {
     skipFunctionBodies = skipFunctionBodies_;
   }
+  // Skip function bodies, but note where they are so that they can be decoded
+  // later through the given LazyFunctionBodies, which must own this builder
+  // (see LazyFunctionBodies::createBuilder()).
+  void setLazyFunctionBodies(LazyFunctionBodies* lazyFunctionBodies_) {
+    skipFunctionBodies = true;
+    lazyFunctionBodies = lazyFunctionBodies_;
+  }
   void read();
   void readUserSection(size_t payloadLen);
 
@@ -1558,8 +1590,19 @@ public:
   void requireFunctionContext(const char* error);
 
   void readFunctions();
+  // Reads the body of the i-th defined function, which begins at pos and has
+  // the given size (whose LEB began at sizePos).
+  Function* readFunction(size_t i, size_t sizePos, size_t size);
   void readVars();
 
+  // Whether to decode function bodies in parallel. That is only possible
+  // without a source map, as that is read as a stream in code order.
+  bool shouldReadFunctionsInParallel(size_t total);
+  // Index the function bodies, then decode them in parallel. Each worker
+  // thread uses its own WasmBinaryBuilder for the per-function state, and the
+  // references they note down are merged back into ours afterwards.
+  void readFunctionsInParallel(size_t total);
+
   std::map<Export*, Index> exportIndices;
   std::vector<Export*> exportOrder;
   void readExports();
@@ -1649,6 +1692,9 @@ public:
 
   void validateBinary(); // validations that cannot be performed on the Module
   void processNames();
+  // Apply the names of functions, tables and globals to the references to them
+  // that we noted down.
+  void resolveRefs();
 
   size_t dataCount = 0;
   bool hasDataCount = false;
@@ -1788,6 +1834,76 @@ public:
 
 private:
   bool hasDWARFSections();
+
+  // Creates a builder for decoding function bodies in parallel with the given
+  // one, with its own copies of the module-level state that bodies refer to.
+  WasmBinaryBuilder(WasmBinaryBuilder& parent);
+
+  friend class LazyFunctionBodies;
+};
+
+// Function bodies that were skipped when reading a binary, and that can be
+// decoded on demand later. Until then each such function has an unreachable
+// as a placeholder body, as with setSkipFunctionBodies(). This is useful for
+// tools that only need to look at the code of a few functions.
+//
+// Bodies are decoded using the module's index spaces as they were when it was
+// read, so functions, tables, globals and tags must not be added, removed or
+// reordered before materializing (renaming them is fine). Debug locations from
+// a source map are not available for lazily decoded bodies.
+//
+// The module points to this while it has lazy bodies, so that PassRunner
+// decodes the bodies of the functions that passes run on, and printing or
+// writing the module decodes them all. This must be destroyed before the
+// module, and the bodies that are still lazy then stay placeholders.
+class LazyFunctionBodies {
+public:
+  LazyFunctionBodies();
+  ~LazyFunctionBodies();
+
+  // Create a builder to read a binary into a module with lazy function bodies.
+  // We take ownership of the input and of the builder, as the bodies are
+  // decoded from them later.
+  WasmBinaryBuilder& createBuilder(Module& wasm,
+                                   std::unique_ptr<MappedFile> input);
+
+  // Whether the function's body has not been decoded yet.
+  bool isLazy(Function* func);
+
+  // Decode the body of a function, if it has not been decoded yet. This may be
+  // called from multiple threads.
+  void materialize(Function* func);
+
+  void materializeAll();
+
+  // Keep the placeholders of the bodies that have not been decoded yet, and do
+  // not decode them later. This is for tools that do not output the module,
+  // and want to run passes on it without decoding everything.
+  void skipRemaining();
+
+private:
+  friend class WasmBinaryBuilder;
+
+  struct Body {
+    // The index of the function among the defined functions.
+    Index index;
+    // The location of the body's size, and the body itself.
+    size_t sizePos;
+    size_t pos;
+    size_t size;
+  };
+
+  std::unique_ptr<MappedFile> input;
+  std::unique_ptr<WasmBinaryBuilder> builder;
+  std::unordered_map<Function*, Body> bodies;
+
+  // The sizes of the index spaces after reading.
+  size_t numFunctions = 0;
+  size_t numTables = 0;
+  size_t numGlobals = 0;
+  size_t numTags = 0;
+
+  std::mutex mutex;
 };
 
 } // namespace wasm
@@ -54,11 +54,19 @@ extern Name WASM, RETURN_FLOW, NONCONSTANT_FLOW;
 class Flow {
 public:
   Flow() : values() {}
-  Flow(Literal value) : values{value} { assert(value.type.isConcrete()); }
+  // Literals are moved in, rather than copied through an initializer list, as
+  // flows of single values are created for almost every expression.
+  Flow(Literal value) {
+    assert(value.type.isConcrete());
+    values.push_back(std::move(value));
+  }
   Flow(Literals& values) : values(values) {}
   Flow(Literals&& values) : values(std::move(values)) {}
   Flow(Name breakTo) : values(), breakTo(breakTo) {}
-  Flow(Name breakTo, Literal value) : values{value}, breakTo(breakTo) {}
+  Flow(Name breakTo, Literal value) : breakTo(breakTo) {
+    assert(value.type.isConcrete());
+    values.push_back(std::move(value));
+  }
 
   Literals values;
   Name breakTo; // if non-null, a break is going on
@@ -349,7 +357,7 @@ public:
     if (flow.breaking()) {
       return flow;
     }
-    Literal value = flow.getSingleValue();
+    const Literal& value = flow.getSingleValue();
     NOTE_EVAL1(value);
     switch (curr->op) {
       case ClzInt32:
@@ -586,16 +594,16 @@ public:
   }
   Flow visitBinary(Binary* curr) {
     NOTE_ENTER("Binary");
-    Flow flow = visit(curr->left);
-    if (flow.breaking()) {
-      return flow;
+    Flow leftFlow = visit(curr->left);
+    if (leftFlow.breaking()) {
+      return leftFlow;
     }
-    Literal left = flow.getSingleValue();
-    flow = visit(curr->right);
-    if (flow.breaking()) {
-      return flow;
+    Flow rightFlow = visit(curr->right);
+    if (rightFlow.breaking()) {
+      return rightFlow;
     }
-    Literal right = flow.getSingleValue();
+    const Literal& left = leftFlow.getSingleValue();
+    const Literal& right = rightFlow.getSingleValue();
     NOTE_EVAL2(left, right);
     assert(curr->left->type.isConcrete() ? left.type == curr->left->type
                                          : true);
@@ -2317,6 +2325,173 @@ public:
 
 using GlobalValueSet = std::map<Name, Literals>;
 
+//
+// A function compiled for the bytecode tier of ModuleRunnerBase. Instead of
+// walking the tree and returning a Flow from every node, the function is
+// compiled once into a flat sequence of instructions for a stack machine, in
+// which branch targets are resolved to instruction offsets and stack heights,
+// and values are untyped 64-bit slots.
+//
+// Only functions whose locals and values are all i32, i64, f32 or f64 are
+// compiled. Control flow, locals, calls, loads, stores and integer math are
+// executed directly. Anything else is executed by the tree walker on a copy of
+// the expression whose children are constants holding the operands (see
+// Generic), so the tree walker remains the reference for the semantics of
+// every instruction, including anything a subclass overrides.
+//
+struct InterpreterBytecode {
+  enum class Op : uint32_t {
+    Const,
+    LocalGet,
+    LocalSet,
+    LocalTee,
+    Drop,
+    Select,
+    // Branches. |a| is the target instruction, and |imm| is the stack height
+    // at the target, shifted left by one, with the low bit set if a value is
+    // sent to the target.
+    Br,
+    BrIf,
+    // Branches if the condition is zero. Used for ifs, and never sends a
+    // value.
+    BrUnless,
+    // |a| is the index of the first target in |targets|, and |imm| is the
+    // number of targets, the last of which is the default.
+    BrTable,
+    // |a| is 1 if a value is returned.
+    Return,
+    Call,
+    Load,
+    Store,
+    // |a| is the index in |generics|.
+    Generic,
+    I32Eqz,
+    I32Add,
+    I32Sub,
+    I32Mul,
+    I32And,
+    I32Or,
+    I32Xor,
+    I32Shl,
+    I32ShrS,
+    I32ShrU,
+    I32RotL,
+    I32RotR,
+    I32Eq,
+    I32Ne,
+    I32LtS,
+    I32LtU,
+    I32GtS,
+    I32GtU,
+    I32LeS,
+    I32LeU,
+    I32GeS,
+    I32GeU,
+    I64Eqz,
+    I64Add,
+    I64Sub,
+    I64Mul,
+    I64And,
+    I64Or,
+    I64Xor,
+    I64Shl,
+    I64ShrS,
+    I64ShrU,
+    I64RotL,
+    I64RotR,
+    I64Eq,
+    I64Ne,
+    I64LtS,
+    I64LtU,
+    I64GtS,
+    I64GtU,
+    I64LeS,
+    I64LeU,
+    I64GeS,
+    I64GeU,
+    I32WrapI64,
+    I64ExtendI32S,
+    I64ExtendI32U,
+  };
+
+  struct Instruction {
+    Op op;
+    Index a = 0;
+    union {
+      uint64_t imm = 0;
+      // The original expression, for calls, loads and stores.
+      Expression* expr;
+    };
+  };
+
+  struct Target {
+    Index pc;
+    Index height;
+    bool hasValue;
+  };
+
+  // An expression executed by the tree walker. |operands| are the constants
+  // that replace its children, in execution order.
+  struct Generic {
+    Expression* expr;
+    std::vector<Const*> operands;
+  };
+
+  std::vector<Instruction> code;
+  std::vector<Target> targets;
+  std::vector<Generic> generics;
+  Index numLocals = 0;
+  // The maximum number of values on the stack at once.
+  Index maxHeight = 0;
+
+  // Compiles a function, or returns nullptr if it cannot be compiled. The
+  // copies of expressions that are executed by the tree walker are allocated
+  // in |scratch|.
+  static std::unique_ptr<InterpreterBytecode> compile(Function* func,
+                                                      Module& scratch);
+
+  // Values are stored as their bits, zero-extended to 64 bits.
+  static uint64_t fromLiteral(const Literal& value) {
+    switch (value.type.getBasic()) {
+      case Type::i32:
+        return uint32_t(value.geti32());
+      case Type::i64:
+        return uint64_t(value.geti64());
+      case Type::f32:
+        return uint32_t(value.reinterpreti32());
+      case Type::f64:
+        return uint64_t(value.reinterpreti64());
+      default:
+        WASM_UNREACHABLE("unexpected type");
+    }
+  }
+  static Literal toLiteral(uint64_t bits, Type type) {
+    switch (type.getBasic()) {
+      case Type::i32:
+        return Literal(int32_t(bits));
+      case Type::i64:
+        return Literal(int64_t(bits));
+      case Type::f32:
+        return Literal(int32_t(bits)).castToF32();
+      case Type::f64:
+        return Literal(int64_t(bits)).castToF64();
+      default:
+        WASM_UNREACHABLE("unexpected type");
+    }
+  }
+
+  // Unwinds the stack for a branch, moving the value that is sent, if there is
+  // one, and returns the new top of the stack.
+  static uint64_t*
+  branch(uint64_t* stack, uint64_t* sp, Index height, bool hasValue) {
+    if (hasValue) {
+      stack[height] = sp[-1];
+      return stack + height + 1;
+    }
+    return stack + height;
+  }
+};
+
 //
 // A runner for a module. Each runner contains the information to execute the
 // module, such as the state of globals, and so forth, so it basically
@@ -2512,6 +2687,11 @@ public:
   // Multivalue ABI support (see push/pop).
   std::vector<Literals> multiValues;
 
+  // Whether to run functions in the bytecode tier when they can be compiled
+  // to it (see InterpreterBytecode). This only affects calls after it is set,
+  // so the start function always runs in the tree walker.
+  bool useBytecode = false;
+
   ModuleRunnerBase(
     Module& wasm,
     ExternalInterface* externalInterface,
@@ -2915,8 +3095,12 @@ public:
     NOTE_EVAL1(index);
     NOTE_EVAL1(flow.getSingleValue());
     assert(curr->isTee() ? Type::isSubType(flow.getType(), curr->type) : true);
-    scope->locals[index] = flow.values;
-    return curr->isTee() ? flow : Flow();
+    if (curr->isTee()) {
+      scope->locals[index] = flow.values;
+      return flow;
+    }
+    scope->locals[index] = std::move(flow.values);
+    return Flow();
   }
 
   Flow visitGlobalGet(GlobalGet* curr) {
@@ -3585,24 +3769,30 @@ public:
 
     Function* function = wasm.getFunction(name);
     assert(function);
-    FunctionScope scope(function, arguments, *self());
+    Literals results;
+    if (auto* bytecode = getBytecode(function)) {
+      results = runBytecode(function, *bytecode, arguments);
+    } else {
+      FunctionScope scope(function, arguments, *self());
 
 #ifdef WASM_INTERPRETER_DEBUG
-    std::cout << "entering " << function->name << "\n  with arguments:\n";
-    for (unsigned i = 0; i < arguments.size(); ++i) {
-      std::cout << "    $" << i << ": " << arguments[i] << '\n';
-    }
+      std::cout << "entering " << function->name << "\n  with arguments:\n";
+      for (unsigned i = 0; i < arguments.size(); ++i) {
+        std::cout << "    $" << i << ": " << arguments[i] << '\n';
+      }
 #endif
 
-    Flow flow = self()->visit(function->body);
-    // cannot still be breaking, it means we missed our stop
-    assert(!flow.breaking() || flow.breakTo == RETURN_FLOW);
-    auto type = flow.getType();
-    if (!Type::isSubType(type, function->getResults())) {
-      std::cerr << "calling " << function->name << " resulted in " << type
-                << " but the function type is " << function->getResults()
-                << '\n';
-      WASM_UNREACHABLE("unexpected result type");
+      Flow flow = self()->visit(function->body);
+      // cannot still be breaking, it means we missed our stop
+      assert(!flow.breaking() || flow.breakTo == RETURN_FLOW);
+      auto type = flow.getType();
+      if (!Type::isSubType(type, function->getResults())) {
+        std::cerr << "calling " << function->name << " resulted in " << type
+                  << " but the function type is " << function->getResults()
+                  << '\n';
+        WASM_UNREACHABLE("unexpected result type");
+      }
+      results = std::move(flow.values);
     }
     // may decrease more than one, if we jumped up the stack
     callDepth = previousCallDepth;
@@ -3612,15 +3802,267 @@ public:
       functionStack.pop_back();
     }
 #ifdef WASM_INTERPRETER_DEBUG
-    std::cout << "exiting " << function->name << " with " << flow.values
-              << '\n';
+    std::cout << "exiting " << function->name << " with " << results << '\n';
 #endif
-    return flow.values;
+    return results;
   }
 
   // The maximum call stack depth to evaluate into.
   static const Index maxDepth = 250;
 
+private:
+  // Functions compiled for the bytecode tier, or nullptr for those that
+  // cannot be compiled.
+  std::unordered_map<Function*, std::unique_ptr<InterpreterBytecode>>
+    bytecodes;
+
+  // Where compiled functions allocate the expressions they execute in the
+  // tree walker.
+  Module bytecodeScratch;
+
+  // The stack of the bytecode tier, holding the locals and values of all the
+  // frames.
+  std::vector<uint64_t> bytecodeStack;
+  size_t bytecodeStackTop = 0;
+
+  InterpreterBytecode* getBytecode(Function* func) {
+    if (!useBytecode) {
+      return nullptr;
+    }
+    auto iter = bytecodes.find(func);
+    if (iter == bytecodes.end()) {
+      iter =
+        bytecodes
+          .emplace(func, InterpreterBytecode::compile(func, bytecodeScratch))
+          .first;
+    }
+    return iter->second.get();
+  }
+
+  Literals runBytecode(Function* func,
+                       InterpreterBytecode& bytecode,
+                       const Literals& arguments) {
+    using Op = InterpreterBytecode::Op;
+    if (func->getParams().size() != arguments.size()) {
+      std::cerr << "Function `" << func->name << "` expects "
+                << func->getParams().size() << " parameters, got "
+                << arguments.size() << " arguments." << std::endl;
+      WASM_UNREACHABLE("invalid param count");
+    }
+
+    // Allocate a frame, and free it when we return or unwind.
+    struct Frame {
+      size_t& top;
+      size_t base;
+      ~Frame() { top = base; }
+    } frame{bytecodeStackTop, bytecodeStackTop};
+    bytecodeStackTop += bytecode.numLocals + bytecode.maxHeight;
+    if (bytecodeStack.size() < bytecodeStackTop) {
+      bytecodeStack.resize(bytecodeStackTop);
+    }
+    uint64_t* locals = bytecodeStack.data() + frame.base;
+    uint64_t* stack = locals + bytecode.numLocals;
+    uint64_t* sp = stack;
+    for (Index i = 0; i < bytecode.numLocals; i++) {
+      locals[i] = i < arguments.size()
+                    ? InterpreterBytecode::fromLiteral(arguments[i])
+                    : 0;
+    }
+    // Calls may resize the stack, after which we must find our frame again.
+    auto reload = [&]() {
+      auto height = sp - stack;
+      locals = bytecodeStack.data() + frame.base;
+      stack = locals + bytecode.numLocals;
+      sp = stack + height;
+    };
+
+    const auto* code = bytecode.code.data();
+    const auto* pc = code;
+    while (1) {
+      switch (pc->op) {
+        case Op::Const:
+          *sp++ = pc->imm;
+          break;
+        case Op::LocalGet:
+          *sp++ = locals[pc->a];
+          break;
+        case Op::LocalSet:
+          locals[pc->a] = *--sp;
+          break;
+        case Op::LocalTee:
+          locals[pc->a] = sp[-1];
+          break;
+        case Op::Drop:
+          sp--;
+          break;
+        case Op::Select: {
+          auto condition = uint32_t(*--sp);
+          auto ifFalse = *--sp;
+          if (!condition) {
+            sp[-1] = ifFalse;
+          }
+          break;
+        }
+        case Op::Br:
+          sp =
+            InterpreterBytecode::branch(stack, sp, pc->imm >> 1, pc->imm & 1);
+          pc = code + pc->a;
+          continue;
+        case Op::BrIf:
+          if (uint32_t(*--sp)) {
+            sp =
+              InterpreterBytecode::branch(stack, sp, pc->imm >> 1, pc->imm & 1);
+            pc = code + pc->a;
+            continue;
+          }
+          break;
+        case Op::BrUnless:
+          if (!uint32_t(*--sp)) {
+            pc = code + pc->a;
+            continue;
+          }
+          break;
+        case Op::BrTable: {
+          auto index = std::min(uint64_t(uint32_t(*--sp)), pc->imm - 1);
+          auto& target = bytecode.targets[pc->a + index];
+          sp = InterpreterBytecode::branch(
+            stack, sp, target.height, target.hasValue);
+          pc = code + target.pc;
+          continue;
+        }
+        case Op::Return:
+          if (pc->a) {
+            return {InterpreterBytecode::toLiteral(sp[-1], func->getResults())};
+          }
+          return {};
+        case Op::Call: {
+          auto* call = static_cast<Call*>(pc->expr);
+          auto* target = wasm.getFunction(call->target);
+          auto params = target->getParams();
+          sp -= params.size();
+          Literals arguments;
+          arguments.reserve(params.size());
+          for (Index i = 0; i < params.size(); i++) {
+            arguments.push_back(
+              InterpreterBytecode::toLiteral(sp[i], params[i]));
+          }
+          auto results = target->imported()
+                           ? externalInterface->callImport(target, arguments)
+                           : callFunctionInternal(call->target, arguments);
+          reload();
+          // A return call has an unreachable type, but still has results,
+          // which the return after it returns.
+          if (target->getResults().isConcrete()) {
+            *sp++ = InterpreterBytecode::fromLiteral(results[0]);
+          }
+          break;
+        }
+        case Op::Load: {
+          auto* load = static_cast<Load*>(pc->expr);
+          auto* inst = getMemoryInstance();
+          auto addr = inst->getFinalAddress(
+            load, InterpreterBytecode::toLiteral(sp[-1], load->ptr->type));
+          sp[-1] = InterpreterBytecode::fromLiteral(
+            inst->externalInterface->load(load, addr));
+          break;
+        }
+        case Op::Store: {
+          auto* store = static_cast<Store*>(pc->expr);
+          sp -= 2;
+          auto* inst = getMemoryInstance();
+          auto addr = inst->getFinalAddress(
+            store, InterpreterBytecode::toLiteral(sp[0], store->ptr->type));
+          auto value = InterpreterBytecode::toLiteral(sp[1], store->valueType);
+          inst->externalInterface->store(store, addr, value);
+          break;
+        }
+        case Op::Generic: {
+          auto& generic = bytecode.generics[pc->a];
+          auto& operands = generic.operands;
+          sp -= operands.size();
+          for (Index i = 0; i < operands.size(); i++) {
+            operands[i]->value =
+              InterpreterBytecode::toLiteral(sp[i], operands[i]->type);
+          }
+          Flow flow = self()->visit(generic.expr);
+          reload();
+          // Branches, returns and return calls are compiled natively.
+          assert(!flow.breaking());
+          if (generic.expr->type.isConcrete()) {
+            *sp++ = InterpreterBytecode::fromLiteral(flow.getSingleValue());
+          }
+          break;
+        }
+
+#define UNARY(name, type, expr)                                                \
+  case Op::name: {                                                             \
+    type x = type(sp[-1]);                                                     \
+    sp[-1] = (expr);                                                           \
+    break;                                                                     \
+  }
+#define BINARY(name, type, expr)                                               \
+  case Op::name: {                                                             \
+    type r = type(*--sp);                                                      \
+    type l = type(sp[-1]);                                                     \
+    sp[-1] = (expr);                                                           \
+    break;                                                                     \
+  }
+          // Results are stored zero-extended, so i32 results are cast to
+          // uint32_t.
+          UNARY(I32Eqz, uint32_t, x == 0)
+          BINARY(I32Add, uint32_t, uint32_t(l + r))
+          BINARY(I32Sub, uint32_t, uint32_t(l - r))
+          BINARY(I32Mul, uint32_t, uint32_t(l * r))
+          BINARY(I32And, uint32_t, l & r)
+          BINARY(I32Or, uint32_t, l | r)
+          BINARY(I32Xor, uint32_t, l ^ r)
+          BINARY(I32Shl, uint32_t, uint32_t(l << (r & 31)))
+          BINARY(I32ShrS, uint32_t, uint32_t(int32_t(l) >> (r & 31)))
+          BINARY(I32ShrU, uint32_t, l >> (r & 31))
+          BINARY(I32RotL, uint32_t, Bits::rotateLeft(l, r))
+          BINARY(I32RotR, uint32_t, Bits::rotateRight(l, r))
+          BINARY(I32Eq, uint32_t, l == r)
+          BINARY(I32Ne, uint32_t, l != r)
+          BINARY(I32LtS, uint32_t, int32_t(l) < int32_t(r))
+          BINARY(I32LtU, uint32_t, l < r)
+          BINARY(I32GtS, uint32_t, int32_t(l) > int32_t(r))
+          BINARY(I32GtU, uint32_t, l > r)
+          BINARY(I32LeS, uint32_t, int32_t(l) <= int32_t(r))
+          BINARY(I32LeU, uint32_t, l <= r)
+          BINARY(I32GeS, uint32_t, int32_t(l) >= int32_t(r))
+          BINARY(I32GeU, uint32_t, l >= r)
+          UNARY(I64Eqz, uint64_t, x == 0)
+          BINARY(I64Add, uint64_t, l + r)
+          BINARY(I64Sub, uint64_t, l - r)
+          BINARY(I64Mul, uint64_t, l * r)
+          BINARY(I64And, uint64_t, l & r)
+          BINARY(I64Or, uint64_t, l | r)
+          BINARY(I64Xor, uint64_t, l ^ r)
+          BINARY(I64Shl, uint64_t, l << (r & 63))
+          BINARY(I64ShrS, uint64_t, uint64_t(int64_t(l) >> (r & 63)))
+          BINARY(I64ShrU, uint64_t, l >> (r & 63))
+          BINARY(I64RotL, uint64_t, Bits::rotateLeft(l, r))
+          BINARY(I64RotR, uint64_t, Bits::rotateRight(l, r))
+          BINARY(I64Eq, uint64_t, l == r)
+          BINARY(I64Ne, uint64_t, l != r)
+          BINARY(I64LtS, uint64_t, int64_t(l) < int64_t(r))
+          BINARY(I64LtU, uint64_t, l < r)
+          BINARY(I64GtS, uint64_t, int64_t(l) > int64_t(r))
+          BINARY(I64GtU, uint64_t, l > r)
+          BINARY(I64LeS, uint64_t, int64_t(l) <= int64_t(r))
+          BINARY(I64LeU, uint64_t, l <= r)
+          BINARY(I64GeS, uint64_t, int64_t(l) >= int64_t(r))
+          BINARY(I64GeU, uint64_t, l >= r)
+          UNARY(I32WrapI64, uint64_t, uint32_t(x))
+          UNARY(I64ExtendI32S, uint64_t, uint64_t(int64_t(int32_t(x))))
+          UNARY(I64ExtendI32U, uint64_t, uint32_t(x))
+#undef UNARY
+#undef BINARY
+      }
+      pc++;
+    }
+  }
+
 protected:
   Address memorySize; // in pages
 
@@ -31,6 +31,9 @@ namespace wasm {
 // removing the old one.
 extern bool useNewWATParser;
 
+class LazyFunctionBodies;
+class MappedFile;
+
 class ModuleIOBase {
 protected:
   bool debugInfo;
@@ -57,6 +60,12 @@ public:
     skipFunctionBodies = skipFunctionBodies_;
   }
 
+  // Like skipping function bodies, but the given object keeps what it needs to
+  // decode them later on demand. Only applies to binaries.
+  void setLazyFunctionBodies(LazyFunctionBodies* lazyFunctionBodies_) {
+    lazyFunctionBodies = lazyFunctionBodies_;
+  }
+
   // read text
   void readText(std::string filename, Module& wasm);
   // read binary
@@ -77,9 +86,11 @@ private:
 
   bool skipFunctionBodies = false;
 
+  LazyFunctionBodies* lazyFunctionBodies = nullptr;
+
   void readStdin(Module& wasm, std::string sourceMapFilename);
 
-  void readBinaryData(std::vector<char>& input,
+  void readBinaryData(std::unique_ptr<MappedFile> input,
                       Module& wasm,
                       std::string sourceMapFilename);
 };
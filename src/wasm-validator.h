@@ -57,6 +57,13 @@ struct WasmValidator {
   typedef uint32_t Flags;
 
   bool validate(Module& module, Flags flags = Globally);
+
+  // Validates only the given functions, and not the module-level things. This
+  // is enough after changes that can only affect the contents of those
+  // functions.
+  bool validate(Module& module,
+                const std::vector<Function*>& functions,
+                Flags flags = Globally);
 };
 
 } // namespace wasm
@@ -36,6 +36,7 @@
 #include "mixed_arena.h"
 #include "support/index.h"
 #include "support/name.h"
+#include "support/pointer_map.h"
 #include "wasm-features.h"
 #include "wasm-type.h"
 
@@ -1985,13 +1986,15 @@ public:
                    : columnNumber < other.columnNumber;
     }
   };
-  std::unordered_map<Expression*, DebugLocation> debugLocations;
+  // Nearly every expression may have a location, so these side tables use a
+  // compact map.
+  PointerMap<Expression*, DebugLocation> debugLocations;
   std::set<DebugLocation> prologLocation;
   std::set<DebugLocation> epilogLocation;
 
   // General debugging info support: track instructions and the function itself.
-  std::unordered_map<Expression*, BinaryLocations::Span> expressionLocations;
-  std::unordered_map<Expression*, BinaryLocations::DelimiterLocations>
+  PointerMap<Expression*, BinaryLocations::Span> expressionLocations;
+  PointerMap<Expression*, BinaryLocations::DelimiterLocations>
     delimiterLocations;
   BinaryLocations::FunctionLocations funcLocation;
 
@@ -2146,6 +2149,8 @@ public:
   std::vector<char> tail;
 };
 
+class LazyFunctionBodies;
+
 class Module {
 public:
   // wasm contents (generally you shouldn't access these from outside, except
@@ -2181,6 +2186,12 @@ public:
 
   std::unordered_map<HeapType, TypeNames> typeNames;
 
+  // Function bodies that have not been decoded yet, if the module was read
+  // with lazy function bodies (see LazyFunctionBodies in wasm-binary.h). They
+  // are decoded before passes run on the functions and before the module is
+  // written.
+  LazyFunctionBodies* lazyFunctionBodies = nullptr;
+
   MixedArena allocator;
 
 private:
@@ -78,26 +78,7 @@ Literal::Literal(std::unique_ptr<RttSupers>&& rttSupers, Type type)
   assert(type.isRtt());
 }
 
-Literal::Literal(const Literal& other) : type(other.type) {
-  if (type.isBasic()) {
-    switch (type.getBasic()) {
-      case Type::i32:
-      case Type::f32:
-        i32 = other.i32;
-        return;
-      case Type::i64:
-      case Type::f64:
-        i64 = other.i64;
-        return;
-      case Type::v128:
-        memcpy(&v128, other.v128, 16);
-        return;
-      case Type::none:
-        return;
-      case Type::unreachable:
-        break;
-    }
-  }
+void Literal::copyNonBasic(const Literal& other) {
   if (other.isData()) {
     new (&gcData) std::shared_ptr<GCData>(other.gcData);
     return;
@@ -133,12 +114,19 @@ Literal::Literal(const Literal& other) : type(other.type) {
   }
 }
 
-Literal::~Literal() {
-  // Early exit for the common case; basic types need no special handling.
-  if (type.isBasic()) {
+void Literal::moveNonBasic(Literal&& other) noexcept {
+  // Take ownership of the other literal's GC data, which avoids refcounting.
+  // The other literal is left with null data, which is safe to copy and
+  // destroy. RTTs are copied instead, as a moved-from RTT literal would have no
+  // supers for copyNonBasic() and getRttSupers() to use.
+  if (other.isData()) {
+    new (&gcData) std::shared_ptr<GCData>(std::move(other.gcData));
     return;
   }
+  copyNonBasic(other);
+}
 
+void Literal::destroyNonBasic() {
   if (isData()) {
     gcData.~shared_ptr();
   } else if (type.isRtt()) {
@@ -154,6 +142,14 @@ Literal& Literal::operator=(const Literal& other) {
   return *this;
 }
 
+Literal& Literal::operator=(Literal&& other) noexcept {
+  if (this != &other) {
+    this->~Literal();
+    new (this) Literal(std::move(other));
+  }
+  return *this;
+}
+
 Literal Literal::makeCanonicalRtt(HeapType type) {
   auto supers = std::make_unique<RttSupers>();
   std::optional<HeapType> supertype;
@@ -264,28 +260,28 @@ const RttSupers& Literal::getRttSupers() const {
   return *rttSupers;
 }
 
-Literal Literal::castToF32() {
+Literal Literal::castToF32() const {
   assert(type == Type::i32);
   Literal ret(Type::f32);
   ret.i32 = i32;
   return ret;
 }
 
-Literal Literal::castToF64() {
+Literal Literal::castToF64() const {
   assert(type == Type::i64);
   Literal ret(Type::f64);
   ret.i64 = i64;
   return ret;
 }
 
-Literal Literal::castToI32() {
+Literal Literal::castToI32() const {
   assert(type == Type::f32);
   Literal ret(Type::i32);
   ret.i32 = i32;
   return ret;
 }
 
-Literal Literal::castToI64() {
+Literal Literal::castToI64() const {
   assert(type == Type::f64);
   Literal ret(Type::i64);
   ret.i64 = i64;
@@ -16,6 +16,7 @@
 
 #include <algorithm>
 #include <fstream>
+#include <numeric>
 
 #include "ir/eh-utils.h"
 #include "ir/module-utils.h"
@@ -23,6 +24,7 @@
 #include "ir/type-updating.h"
 #include "support/bits.h"
 #include "support/debug.h"
+#include "support/file.h"
 #include "wasm-binary.h"
 #include "wasm-debug.h"
 #include "wasm-stack.h"
@@ -32,6 +34,10 @@
 namespace wasm {
 
 void WasmBinaryWriter::prepare() {
+  if (wasm->lazyFunctionBodies) {
+    wasm->lazyFunctionBodies->materializeAll();
+  }
+
   // Collect function types and their frequencies. Collect information in each
   // function in parallel, then merge.
   indexedTypes = ModuleUtils::getOptimizedIndexedHeapTypes(*wasm);
@@ -383,6 +389,11 @@ void WasmBinaryWriter::writeFunctions() {
   auto sectionStart = startSection(BinaryConsts::Section::Code);
   o << U32LEB(importInfo->getNumDefinedFunctions());
   bool DWARF = Debug::hasDWARFSections(*getModule());
+  if (shouldWriteFunctionsInParallel()) {
+    writeFunctionsInParallel(DWARF);
+    finishSection(sectionStart);
+    return;
+  }
   ModuleUtils::iterDefinedFunctions(*wasm, [&](Function* func) {
     assert(binaryLocationTrackedExpressionsForFunc.empty());
     size_t sourceMapLocationsSizeAtFunctionStart = sourceMapLocations.size();
@@ -436,7 +447,10 @@ void WasmBinaryWriter::writeFunctions() {
         auto iter = binaryLocations.delimiters.find(curr);
         if (iter != binaryLocations.delimiters.end()) {
           for (auto& item : iter->second) {
-            item -= adjustmentForLEBShrinking;
+            // Zero means there is no location.
+            if (item) {
+              item -= adjustmentForLEBShrinking;
+            }
           }
         }
       }
@@ -454,6 +468,134 @@ void WasmBinaryWriter::writeFunctions() {
   finishSection(sectionStart);
 }
 
+WasmBinaryWriter::WasmBinaryWriter(WasmBinaryWriter& parent,
+                                   BufferWithRandomAccess& o)
+  : wasm(parent.wasm), o(o), indexes(parent.indexes),
+    indexedTypes(parent.indexedTypes), debugInfo(parent.debugInfo),
+    stringIndexes(parent.stringIndexes) {}
+
+bool WasmBinaryWriter::shouldWriteFunctionsInParallel() {
+  return importInfo->getNumDefinedFunctions() > 1 &&
+         ThreadPool::getNumCores() > 1;
+}
+
+void WasmBinaryWriter::writeFunctionsInParallel(bool DWARF) {
+  std::vector<Function*> funcs;
+  ModuleUtils::iterDefinedFunctions(
+    *wasm, [&](Function* func) { funcs.push_back(func); });
+
+  // Bodies do not refer to each other's offsets, so they can be encoded
+  // independently once all the indexes are known. Each worker writes into its
+  // own buffer, which we then move into the slot for the function.
+  struct Worker {
+    BufferWithRandomAccess buffer;
+    std::unique_ptr<WasmBinaryWriter> writer;
+  };
+  // The debug info of a body, with offsets relative to its start.
+  struct BodyLocations {
+    std::vector<std::pair<size_t, const Function::DebugLocation*>>
+      sourceMapLocations;
+    std::vector<std::pair<Expression*, BinaryLocations::Span>> expressions;
+    std::vector<std::pair<Expression*, BinaryLocations::DelimiterLocations>>
+      delimiters;
+  };
+  std::vector<Worker> workers(ThreadPool::get()->size());
+  std::vector<BufferWithRandomAccess> bodies(funcs.size());
+  std::vector<MappedLocals> mappedLocals(funcs.size());
+  std::vector<BodyLocations> bodyLocations(funcs.size());
+  std::vector<size_t> items(funcs.size());
+  std::iota(items.begin(), items.end(), 0);
+  WorkStealingQueues::run(items, [&](size_t worker, size_t i) {
+    auto& [buffer, writer] = workers[worker];
+    if (!writer) {
+      writer = std::unique_ptr<WasmBinaryWriter>(
+        new WasmBinaryWriter(*this, buffer));
+      // The worker only notes source map locations, and never writes to the
+      // source map itself.
+      writer->sourceMap = sourceMap;
+    }
+    auto* func = funcs[i];
+    // Note the first location in the function even if it is the same as the
+    // last one in the previous function this worker wrote, which need not be
+    // the previous function in the output. We remove it when appending the
+    // body if it is a duplicate there.
+    writer->lastDebugLocation.reset();
+    if (func->stackIR && !sourceMap && !DWARF) {
+      StackIRToBinaryWriter funcWriter(*writer, buffer, func);
+      funcWriter.write();
+      mappedLocals[i] = std::move(funcWriter.getMappedLocals());
+    } else {
+      BinaryenIRToBinaryWriter funcWriter(
+        *writer, buffer, func, sourceMap, DWARF);
+      funcWriter.write();
+      mappedLocals[i] = std::move(funcWriter.getMappedLocals());
+    }
+    auto& locations = bodyLocations[i];
+    locations.sourceMapLocations.swap(writer->sourceMapLocations);
+    for (auto* curr : writer->binaryLocationTrackedExpressionsForFunc) {
+      locations.expressions.emplace_back(
+        curr, writer->binaryLocations.expressions[curr]);
+      auto iter = writer->binaryLocations.delimiters.find(curr);
+      if (iter != writer->binaryLocations.delimiters.end()) {
+        locations.delimiters.emplace_back(curr, std::move(iter->second));
+      }
+    }
+    writer->binaryLocations.expressions.clear();
+    writer->binaryLocations.delimiters.clear();
+    writer->binaryLocationTrackedExpressionsForFunc.clear();
+    bodies[i].swap(buffer);
+    buffer.clear();
+  });
+
+  for (size_t i = 0; i < funcs.size(); i++) {
+    auto* func = funcs[i];
+    auto& body = bodies[i];
+    assert(body.size() <= std::numeric_limits<uint32_t>::max());
+    BYN_TRACE("write one at" << o.size() << ", body size: " << body.size()
+                             << std::endl);
+    auto sizePos = o.size();
+    o << U32LEB(body.size());
+    auto start = o.size();
+    tableOfContents.functionBodies.emplace_back(func->name, start, body.size());
+    o.insert(o.end(), body.begin(), body.end());
+    // Free each body as we go, to keep the peak memory down.
+    BufferWithRandomAccess().swap(body);
+    if (debugInfo) {
+      funcMappedLocals[func->name] = std::move(mappedLocals[i]);
+    }
+
+    // Add the debug info of the body, at its final offsets, as if we had
+    // written it here.
+    auto& locations = bodyLocations[i];
+    for (auto& [offset, loc] : locations.sourceMapLocations) {
+      if (lastDebugLocation && *loc == *lastDebugLocation) {
+        continue;
+      }
+      sourceMapLocations.emplace_back(start + offset, loc);
+      lastDebugLocation = *loc;
+    }
+    for (auto& [curr, span] : locations.expressions) {
+      binaryLocations.expressions[curr] = BinaryLocations::Span{
+        BinaryLocation(start + span.start), BinaryLocation(start + span.end)};
+    }
+    for (auto& [curr, delimiters] : locations.delimiters) {
+      for (auto& item : delimiters) {
+        if (item) {
+          item += start;
+        }
+      }
+      binaryLocations.delimiters[curr] = std::move(delimiters);
+    }
+    if (!locations.expressions.empty()) {
+      binaryLocations.functions[func] = BinaryLocations::FunctionLocations{
+        BinaryLocation(sizePos),
+        BinaryLocation(start),
+        BinaryLocation(o.size())};
+    }
+    locations = BodyLocations();
+  }
+}
+
 void WasmBinaryWriter::writeStrings() {
   assert(wasm->features.hasStrings());
 
@@ -1249,7 +1391,7 @@ void WasmBinaryWriter::writeDylinkSection() {
 }
 
 void WasmBinaryWriter::writeDebugLocation(const Function::DebugLocation& loc) {
-  if (loc == lastDebugLocation) {
+  if (lastDebugLocation && loc == *lastDebugLocation) {
     return;
   }
   auto offset = o.size();
@@ -1487,12 +1629,35 @@ void WasmBinaryWriter::writeField(const Field& field) {
 
 WasmBinaryBuilder::WasmBinaryBuilder(Module& wasm,
                                      FeatureSet features,
-                                     const std::vector<char>& input)
+                                     std::string_view input)
   : wasm(wasm), allocator(wasm.allocator), input(input), sourceMap(nullptr),
     nextDebugLocation(0, {0, 0, 0}), debugLocation() {
   wasm.features = features;
 }
 
+WasmBinaryBuilder::WasmBinaryBuilder(WasmBinaryBuilder& parent)
+  : wasm(parent.wasm), allocator(parent.allocator), input(parent.input),
+    sourceMap(nullptr), nextDebugLocation(0, {0, 0, 0}),
+    debugInfo(parent.debugInfo), DWARF(parent.DWARF),
+    skipFunctionBodies(parent.skipFunctionBodies),
+    startIndex(parent.startIndex), debugLocation(),
+    codeSectionLocation(parent.codeSectionLocation), types(parent.types),
+    functionTypes(parent.functionTypes),
+    functionImports(parent.functionImports),
+    tableImports(parent.tableImports), globalImports(parent.globalImports),
+    strings(parent.strings), dataCount(parent.dataCount),
+    hasDataCount(parent.hasDataCount) {
+  // Function bodies only look at the names and types of tables and globals, so
+  // copies of those are enough. (The names are fixed up later through the
+  // refs, after we merge them.)
+  for (auto& table : parent.tables) {
+    tables.push_back(std::make_unique<Table>(*table));
+  }
+  for (auto& global : parent.globals) {
+    globals.push_back(std::make_unique<Global>(*global));
+  }
+}
+
 bool WasmBinaryBuilder::hasDWARFSections() {
   assert(pos == 0);
   getInt32(); // magic
@@ -1621,6 +1786,24 @@ void WasmBinaryBuilder::read() {
 
   validateBinary();
   processNames();
+
+  if (lazyFunctionBodies) {
+    lazyFunctionBodies->numFunctions = wasm.functions.size();
+    lazyFunctionBodies->numTables = wasm.tables.size();
+    lazyFunctionBodies->numGlobals = wasm.globals.size();
+    lazyFunctionBodies->numTags = wasm.tags.size();
+    // Function bodies look at the types of the defined tables and globals,
+    // which processNames() moved into the module, so keep copies around for
+    // when we decode them later.
+    for (Index i = 0; i < tables.size(); i++) {
+      tables[i] =
+        std::make_unique<Table>(*wasm.tables[tableImports.size() + i]);
+    }
+    for (Index i = 0; i < globals.size(); i++) {
+      globals[i] =
+        std::make_unique<Global>(*wasm.globals[globalImports.size() + i]);
+    }
+  }
 }
 
 void WasmBinaryBuilder::readUserSection(size_t payloadLen) {
@@ -2403,6 +2586,10 @@ void WasmBinaryBuilder::readFunctions() {
   if (total != functionTypes.size() - functionImports.size()) {
     throwError("invalid function section size, must equal types");
   }
+  if (shouldReadFunctionsInParallel(total)) {
+    readFunctionsInParallel(total);
+    return;
+  }
   for (size_t i = 0; i < total; i++) {
     BYN_TRACE("read one at " << pos << std::endl);
     auto sizePos = pos;
@@ -2410,85 +2597,269 @@ void WasmBinaryBuilder::readFunctions() {
     if (size == 0) {
       throwError("empty function size");
     }
-    endOfFunction = pos + size;
-
-    auto* func = new Function;
-    func->name = Name::fromInt(i);
-    func->type = getTypeByFunctionIndex(functionImports.size() + i);
-    currFunction = func;
-
-    if (DWARF) {
-      func->funcLocation = BinaryLocations::FunctionLocations{
-        BinaryLocation(sizePos - codeSectionLocation),
-        BinaryLocation(pos - codeSectionLocation),
-        BinaryLocation(pos - codeSectionLocation + size)};
-    }
-
-    readNextDebugLocation();
-
-    BYN_TRACE("reading " << i << std::endl);
-
-    readVars();
-
-    std::swap(func->prologLocation, debugLocation);
-    {
-      // process the function body
-      BYN_TRACE("processing function: " << i << std::endl);
-      nextLabel = 0;
-      debugLocation.clear();
-      willBeIgnored = false;
-      // process body
-      assert(breakStack.empty());
-      assert(breakTargetNames.empty());
-      assert(exceptionTargetNames.empty());
-      assert(expressionStack.empty());
-      assert(controlFlowStack.empty());
-      assert(letStack.empty());
-      assert(depth == 0);
-      // Even if we are skipping function bodies we need to not skip the start
-      // function. That contains important code for wasm-emscripten-finalize in
-      // the form of pthread-related segment initializations. As this is just
-      // one function, it doesn't add significant time, so the optimization of
-      // skipping bodies is still very useful.
-      auto currFunctionIndex = functionImports.size() + functions.size();
-      bool isStart = startIndex == currFunctionIndex;
-      if (!skipFunctionBodies || isStart) {
-        func->body = getBlockOrSingleton(func->getResults());
-      } else {
-        // When skipping the function body we need to put something valid in
-        // their place so we validate. An unreachable is always acceptable
-        // there.
-        func->body = Builder(wasm).makeUnreachable();
+    functions.push_back(readFunction(i, sizePos, size));
+  }
+  BYN_TRACE(" end function bodies\n");
+}
 
-        // Skip reading the contents.
-        pos = endOfFunction;
-      }
-      assert(depth == 0);
-      assert(breakStack.empty());
-      assert(breakTargetNames.empty());
-      assert(exceptionTargetNames.empty());
-      if (!expressionStack.empty()) {
-        throwError("stack not empty on function exit");
-      }
-      assert(controlFlowStack.empty());
-      assert(letStack.empty());
-      if (pos != endOfFunction) {
-        throwError("binary offset at function exit not at expected location");
+Function*
+WasmBinaryBuilder::readFunction(size_t i, size_t sizePos, size_t size) {
+  auto start = pos;
+  endOfFunction = pos + size;
+
+  auto* func = new Function;
+  func->name = Name::fromInt(i);
+  func->type = getTypeByFunctionIndex(functionImports.size() + i);
+  currFunction = func;
+
+  if (DWARF) {
+    func->funcLocation = BinaryLocations::FunctionLocations{
+      BinaryLocation(sizePos - codeSectionLocation),
+      BinaryLocation(pos - codeSectionLocation),
+      BinaryLocation(pos - codeSectionLocation + size)};
+  }
+
+  readNextDebugLocation();
+
+  BYN_TRACE("reading " << i << std::endl);
+
+  readVars();
+
+  std::swap(func->prologLocation, debugLocation);
+  {
+    // process the function body
+    BYN_TRACE("processing function: " << i << std::endl);
+    nextLabel = 0;
+    debugLocation.clear();
+    willBeIgnored = false;
+    // process body
+    assert(breakStack.empty());
+    assert(breakTargetNames.empty());
+    assert(exceptionTargetNames.empty());
+    assert(expressionStack.empty());
+    assert(controlFlowStack.empty());
+    assert(letStack.empty());
+    assert(depth == 0);
+    // Even if we are skipping function bodies we need to not skip the start
+    // function. That contains important code for wasm-emscripten-finalize in
+    // the form of pthread-related segment initializations. As this is just
+    // one function, it doesn't add significant time, so the optimization of
+    // skipping bodies is still very useful.
+    auto currFunctionIndex = functionImports.size() + i;
+    bool isStart = startIndex == currFunctionIndex;
+    if (!skipFunctionBodies || isStart) {
+      func->body = getBlockOrSingleton(func->getResults());
+    } else {
+      // When skipping the function body we need to put something valid in
+      // their place so we validate. An unreachable is always acceptable
+      // there.
+      func->body = Builder(wasm).makeUnreachable();
+
+      if (lazyFunctionBodies) {
+        lazyFunctionBodies->bodies[func] = {Index(i), sizePos, start, size};
       }
+
+      // Skip reading the contents.
+      pos = endOfFunction;
+    }
+    assert(depth == 0);
+    assert(breakStack.empty());
+    assert(breakTargetNames.empty());
+    assert(exceptionTargetNames.empty());
+    if (!expressionStack.empty()) {
+      throwError("stack not empty on function exit");
     }
+    assert(controlFlowStack.empty());
+    assert(letStack.empty());
+    if (pos != endOfFunction) {
+      throwError("binary offset at function exit not at expected location");
+    }
+  }
 
-    if (!wasm.features.hasGCNNLocals()) {
-      TypeUpdating::handleNonDefaultableLocals(func, wasm);
+  if (!wasm.features.hasGCNNLocals()) {
+    TypeUpdating::handleNonDefaultableLocals(func, wasm);
+  }
+
+  std::swap(func->epilogLocation, debugLocation);
+  currFunction = nullptr;
+  debugLocation.clear();
+  return func;
+}
+
+bool WasmBinaryBuilder::shouldReadFunctionsInParallel(size_t total) {
+  return !sourceMap && !skipFunctionBodies && total > 1 &&
+         ThreadPool::getNumCores() > 1;
+}
+
+void WasmBinaryBuilder::readFunctionsInParallel(size_t total) {
+  // Each body is prefixed by its size, so we can find them all without
+  // decoding anything.
+  struct BodyLocation {
+    size_t sizePos;
+    size_t pos;
+    size_t size;
+  };
+  std::vector<BodyLocation> bodies;
+  for (size_t i = 0; i < total; i++) {
+    auto sizePos = pos;
+    size_t size = getU32LEB();
+    if (size == 0) {
+      throwError("empty function size");
     }
+    if (uint64_t(pos) + uint64_t(size) > input.size()) {
+      throwError("function body extends beyond end of input");
+    }
+    bodies.push_back({sizePos, pos, size});
+    pos += size;
+  }
+  auto endPos = pos;
 
-    std::swap(func->epilogLocation, debugLocation);
-    currFunction = nullptr;
-    debugLocation.clear();
-    functions.push_back(func);
+  // Decode the bodies, largest first so that a huge one does not end up last.
+  // Each worker has its own builder for the per-function decoding state, while
+  // the IR itself is allocated in the module's arena, which already gives each
+  // thread its own chunks to allocate from.
+  std::vector<size_t> order(total);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return bodies[a].size > bodies[b].size;
+  });
+  std::vector<std::unique_ptr<WasmBinaryBuilder>> workers(
+    ThreadPool::get()->size());
+  std::vector<Function*> decoded(total, nullptr);
+  // Exceptions cannot cross the thread pool, so note the errors down. If there
+  // are several, report the first in code order, like a serial read would.
+  std::vector<std::unique_ptr<ParseException>> errors(total);
+  WorkStealingQueues::run(order, [&](size_t worker, size_t i) {
+    if (!workers[worker]) {
+      workers[worker] = std::unique_ptr<WasmBinaryBuilder>(
+        new WasmBinaryBuilder(*this));
+    }
+    auto& builder = *workers[worker];
+    builder.pos = bodies[i].pos;
+    try {
+      decoded[i] = builder.readFunction(i, bodies[i].sizePos, bodies[i].size);
+    } catch (ParseException& p) {
+      errors[i] = std::make_unique<ParseException>(p);
+      // The builder's decoding state is now inconsistent, so start over with a
+      // fresh one.
+      workers[worker].reset();
+    }
+  });
+  for (size_t i = 0; i < total; i++) {
+    if (errors[i]) {
+      for (auto* func : decoded) {
+        delete func;
+      }
+      throw *errors[i];
+    }
   }
+  functions.insert(functions.end(), decoded.begin(), decoded.end());
+
+  // Merge the references to module-level things, which we only learn the
+  // final names of later.
+  for (auto& worker : workers) {
+    if (!worker) {
+      continue;
+    }
+    for (auto& [index, refs] : worker->functionRefs) {
+      auto& ours = functionRefs[index];
+      ours.insert(ours.end(), refs.begin(), refs.end());
+    }
+    for (auto& [index, refs] : worker->tableRefs) {
+      auto& ours = tableRefs[index];
+      ours.insert(ours.end(), refs.begin(), refs.end());
+    }
+    for (auto& [index, refs] : worker->globalRefs) {
+      auto& ours = globalRefs[index];
+      ours.insert(ours.end(), refs.begin(), refs.end());
+    }
+  }
+  pos = endPos;
   BYN_TRACE(" end function bodies\n");
 }
 
+LazyFunctionBodies::LazyFunctionBodies() = default;
+
+LazyFunctionBodies::~LazyFunctionBodies() { skipRemaining(); }
+
+WasmBinaryBuilder&
+LazyFunctionBodies::createBuilder(Module& wasm,
+                                  std::unique_ptr<MappedFile> input_) {
+  assert(!builder && "a LazyFunctionBodies can only be used for one read");
+  input = std::move(input_);
+  builder =
+    std::make_unique<WasmBinaryBuilder>(wasm, wasm.features, input->view());
+  builder->setLazyFunctionBodies(this);
+  wasm.lazyFunctionBodies = this;
+  return *builder;
+}
+
+bool LazyFunctionBodies::isLazy(Function* func) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return bodies.count(func);
+}
+
+void LazyFunctionBodies::materialize(Function* func) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto iter = bodies.find(func);
+  if (iter == bodies.end()) {
+    return;
+  }
+  auto body = iter->second;
+  bodies.erase(iter);
+
+  auto& wasm = builder->wasm;
+  if (wasm.functions.size() != numFunctions ||
+      wasm.tables.size() != numTables || wasm.globals.size() != numGlobals ||
+      wasm.tags.size() != numTags) {
+    Fatal() << "cannot materialize the body of " << func->name
+            << " after the module's index spaces have changed";
+  }
+
+  // Decode the body into a new function, and resolve the references in it
+  // right away, as we know all the names by now.
+  builder->skipFunctionBodies = false;
+  builder->sourceMap = nullptr;
+  builder->functionRefs.clear();
+  builder->tableRefs.clear();
+  builder->globalRefs.clear();
+  builder->pos = body.pos;
+  std::unique_ptr<Function> decoded(
+    builder->readFunction(body.index, body.sizePos, body.size));
+  builder->resolveRefs();
+
+  // Move the contents over to the existing function, which is the one that
+  // everything else refers to, and has the names from the names section.
+  func->vars = std::move(decoded->vars);
+  func->body = decoded->body;
+  func->prologLocation = std::move(decoded->prologLocation);
+  func->epilogLocation = std::move(decoded->epilogLocation);
+  func->debugLocations = std::move(decoded->debugLocations);
+  func->expressionLocations = std::move(decoded->expressionLocations);
+  func->delimiterLocations = std::move(decoded->delimiterLocations);
+}
+
+void LazyFunctionBodies::materializeAll() {
+  std::vector<Function*> funcs;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& [func, _] : bodies) {
+      funcs.push_back(func);
+    }
+  }
+  for (auto* func : funcs) {
+    materialize(func);
+  }
+}
+
+void LazyFunctionBodies::skipRemaining() {
+  std::lock_guard<std::mutex> lock(mutex);
+  bodies.clear();
+  if (builder && builder->wasm.lazyFunctionBodies == this) {
+    builder->wasm.lazyFunctionBodies = nullptr;
+  }
+}
+
 void WasmBinaryBuilder::readVars() {
   size_t numLocalTypes = getU32LEB();
   for (size_t t = 0; t < numLocalTypes; t++) {
@@ -2988,6 +3359,14 @@ void WasmBinaryBuilder::processNames() {
     wasm.addExport(curr);
   }
 
+  resolveRefs();
+
+  // Everything now has its proper name.
+
+  wasm.updateMaps();
+}
+
+void WasmBinaryBuilder::resolveRefs() {
   for (auto& [index, refs] : functionRefs) {
     for (auto* ref : refs) {
       *ref = getFunctionName(index);
@@ -3005,10 +3384,6 @@ void WasmBinaryBuilder::processNames() {
       *ref = getGlobalName(index);
     }
   }
-
-  // Everything now has its proper name.
-
-  wasm.updateMaps();
 }
 
 void WasmBinaryBuilder::readDataSegmentCount() {
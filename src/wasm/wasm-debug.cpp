@@ -20,6 +20,7 @@
 #ifdef BUILD_LLVM_DWARF
 #include "llvm/ObjectYAML/DWARFEmitter.h"
 #include "llvm/ObjectYAML/DWARFYAML.h"
+#include "llvm/Support/LEB128.h"
 #include "llvm/include/llvm/DebugInfo/DWARFContext.h"
 
 std::error_code dwarf2yaml(llvm::DWARFContext& DCtx, llvm::DWARFYAML::Data& Y);
@@ -55,9 +56,12 @@ struct BinaryenDWARFInfo {
     // Get debug sections from the wasm.
     for (auto& section : wasm.userSections) {
       if (Name(section.name).startsWith(".debug_") && section.data.data()) {
-        // TODO: efficiency
-        sections[section.name.substr(1)] = llvm::MemoryBuffer::getMemBufferCopy(
-          llvm::StringRef(section.data.data(), section.data.size()));
+        // Refer to the data without copying it, which means that the sections
+        // must not be modified while we read from them.
+        sections[section.name.substr(1)] = llvm::MemoryBuffer::getMemBuffer(
+          llvm::StringRef(section.data.data(), section.data.size()),
+          "",
+          false /* RequiresNullTerminator */);
       }
     }
     // Parse debug sections.
@@ -111,6 +115,10 @@ bool shouldPreserveDWARF(PassOptions& options, Module& wasm) {
 //     StringMap<std::unique_ptr<MemoryBuffer>>
 //     EmitDebugSections(llvm::DWARFYAML::Data &DI, bool ApplyFixups);
 //
+// Steps 2 and 3 are slow and use a lot of memory on large inputs, so when we
+// can, we skip them and update the binary sections directly, using the
+// DWARFContext to find what to update (see DWARFSectionUpdater).
+//
 
 // Represents the state when parsing a line table.
 struct LineState {
@@ -652,105 +660,111 @@ static bool isTombstone(uint32_t x) {
   return x == 0 || x == uint32_t(-1) || x == uint32_t(-2);
 }
 
-// Update debug lines, and update the locationUpdater with debug line offset
-// changes so we can update offsets into the debug line section.
-static void updateDebugLines(llvm::DWARFYAML::Data& data,
-                             LocationUpdater& locationUpdater) {
-  for (auto& table : data.DebugLines) {
-    uint32_t sequenceId = 0;
-    // Parse the original opcodes and emit new ones.
-    LineState state(table, sequenceId);
-    // All the addresses we need to write out.
-    std::vector<BinaryLocation> newAddrs;
-    std::unordered_map<BinaryLocation, LineState> newAddrInfo;
-    // If the address was zeroed out, we must omit the entire range (we could
-    // also leave it unchanged, so that the debugger ignores it based on the
-    // initial zero; but it's easier and better to just not emit it at all).
-    bool omittingRange = false;
-    for (auto& opcode : table.Opcodes) {
-      // Update the state, and check if we have a new row to emit.
-      if (state.startsNewRange(opcode)) {
-        omittingRange = false;
+// Update the opcodes in a line table to the new locations.
+static void updateLineTable(llvm::DWARFYAML::LineTable& table,
+                            const LocationUpdater& locationUpdater) {
+  uint32_t sequenceId = 0;
+  // Parse the original opcodes and emit new ones.
+  LineState state(table, sequenceId);
+  // All the addresses we need to write out.
+  std::vector<BinaryLocation> newAddrs;
+  std::unordered_map<BinaryLocation, LineState> newAddrInfo;
+  // If the address was zeroed out, we must omit the entire range (we could
+  // also leave it unchanged, so that the debugger ignores it based on the
+  // initial zero; but it's easier and better to just not emit it at all).
+  bool omittingRange = false;
+  for (auto& opcode : table.Opcodes) {
+    // Update the state, and check if we have a new row to emit.
+    if (state.startsNewRange(opcode)) {
+      omittingRange = false;
+    }
+    if (state.update(opcode, table)) {
+      if (isTombstone(state.addr)) {
+        omittingRange = true;
       }
-      if (state.update(opcode, table)) {
-        if (isTombstone(state.addr)) {
-          omittingRange = true;
-        }
-        if (omittingRange) {
-          state = LineState(table, sequenceId);
+      if (omittingRange) {
+        state = LineState(table, sequenceId);
+        continue;
+      }
+      // An expression may not exist for this line table item, if we optimized
+      // it away.
+      BinaryLocation oldAddr = state.addr;
+      BinaryLocation newAddr = 0;
+      if (locationUpdater.hasOldExprStart(oldAddr)) {
+        newAddr = locationUpdater.getNewExprStart(oldAddr);
+      }
+      // Test for a function's end address first, as LLVM output appears to
+      // use 1-past-the-end-of-the-function as a location in that function,
+      // and not the next (but the first byte of the next function, which is
+      // ambiguously identical to that value, is used at least in low_pc).
+      else if (locationUpdater.hasOldFuncEnd(oldAddr)) {
+        newAddr = locationUpdater.getNewFuncEnd(oldAddr);
+      } else if (locationUpdater.hasOldFuncStart(oldAddr)) {
+        newAddr = locationUpdater.getNewFuncStart(oldAddr);
+      } else if (locationUpdater.hasOldDelimiter(oldAddr)) {
+        newAddr = locationUpdater.getNewDelimiter(oldAddr);
+      } else if (locationUpdater.hasOldExprEnd(oldAddr)) {
+        newAddr = locationUpdater.getNewExprEnd(oldAddr);
+      }
+      if (newAddr && state.needToEmit()) {
+        // LLVM sometimes emits the same address more than once. We should
+        // probably investigate that.
+        if (newAddrInfo.count(newAddr)) {
           continue;
         }
-        // An expression may not exist for this line table item, if we optimized
-        // it away.
-        BinaryLocation oldAddr = state.addr;
-        BinaryLocation newAddr = 0;
-        if (locationUpdater.hasOldExprStart(oldAddr)) {
-          newAddr = locationUpdater.getNewExprStart(oldAddr);
-        }
-        // Test for a function's end address first, as LLVM output appears to
-        // use 1-past-the-end-of-the-function as a location in that function,
-        // and not the next (but the first byte of the next function, which is
-        // ambiguously identical to that value, is used at least in low_pc).
-        else if (locationUpdater.hasOldFuncEnd(oldAddr)) {
-          newAddr = locationUpdater.getNewFuncEnd(oldAddr);
-        } else if (locationUpdater.hasOldFuncStart(oldAddr)) {
-          newAddr = locationUpdater.getNewFuncStart(oldAddr);
-        } else if (locationUpdater.hasOldDelimiter(oldAddr)) {
-          newAddr = locationUpdater.getNewDelimiter(oldAddr);
-        } else if (locationUpdater.hasOldExprEnd(oldAddr)) {
-          newAddr = locationUpdater.getNewExprEnd(oldAddr);
-        }
-        if (newAddr && state.needToEmit()) {
-          // LLVM sometimes emits the same address more than once. We should
-          // probably investigate that.
-          if (newAddrInfo.count(newAddr)) {
-            continue;
-          }
-          newAddrs.push_back(newAddr);
-          newAddrInfo.emplace(newAddr, state);
-          auto& updatedState = newAddrInfo.at(newAddr);
-          // The only difference is the address TODO other stuff?
-          updatedState.addr = newAddr;
-          // Reset relevant state.
-          state.resetAfterLine();
-        }
-        if (opcode.Opcode == 0 &&
-            opcode.SubOpcode == llvm::dwarf::DW_LNE_end_sequence) {
-          sequenceId++;
-          // We assume the number of sequences can fit in 32 bits, and -1 is
-          // an invalid value.
-          assert(sequenceId != uint32_t(-1));
-          state = LineState(table, sequenceId);
-        }
+        newAddrs.push_back(newAddr);
+        newAddrInfo.emplace(newAddr, state);
+        auto& updatedState = newAddrInfo.at(newAddr);
+        // The only difference is the address TODO other stuff?
+        updatedState.addr = newAddr;
+        // Reset relevant state.
+        state.resetAfterLine();
+      }
+      if (opcode.Opcode == 0 &&
+          opcode.SubOpcode == llvm::dwarf::DW_LNE_end_sequence) {
+        sequenceId++;
+        // We assume the number of sequences can fit in 32 bits, and -1 is
+        // an invalid value.
+        assert(sequenceId != uint32_t(-1));
+        state = LineState(table, sequenceId);
       }
     }
-    // Sort the new addresses (which may be substantially different from the
-    // original layout after optimization).
-    std::sort(newAddrs.begin(), newAddrs.end());
-    // Emit a new line table.
-    {
-      std::vector<llvm::DWARFYAML::LineTableOpcode> newOpcodes;
-      for (size_t i = 0; i < newAddrs.size(); i++) {
-        LineState state = newAddrInfo.at(newAddrs[i]);
-        assert(state.needToEmit());
-        LineState lastState(table, -1);
-        if (i != 0) {
-          lastState = newAddrInfo.at(newAddrs[i - 1]);
-          // If the last line is in another sequence, clear the old state, as
-          // there is nothing to diff to.
-          if (lastState.sequenceId != state.sequenceId) {
-            lastState = LineState(table, -1);
-          }
+  }
+  // Sort the new addresses (which may be substantially different from the
+  // original layout after optimization).
+  std::sort(newAddrs.begin(), newAddrs.end());
+  // Emit a new line table.
+  {
+    std::vector<llvm::DWARFYAML::LineTableOpcode> newOpcodes;
+    for (size_t i = 0; i < newAddrs.size(); i++) {
+      LineState state = newAddrInfo.at(newAddrs[i]);
+      assert(state.needToEmit());
+      LineState lastState(table, -1);
+      if (i != 0) {
+        lastState = newAddrInfo.at(newAddrs[i - 1]);
+        // If the last line is in another sequence, clear the old state, as
+        // there is nothing to diff to.
+        if (lastState.sequenceId != state.sequenceId) {
+          lastState = LineState(table, -1);
         }
-        // This line ends a sequence if there is no next line after it, or if
-        // the next line is in a different sequence.
-        bool endSequence =
-          i + 1 == newAddrs.size() ||
-          newAddrInfo.at(newAddrs[i + 1]).sequenceId != state.sequenceId;
-        state.emitDiff(lastState, newOpcodes, table, endSequence);
       }
-      table.Opcodes.swap(newOpcodes);
+      // This line ends a sequence if there is no next line after it, or if
+      // the next line is in a different sequence.
+      bool endSequence =
+        i + 1 == newAddrs.size() ||
+        newAddrInfo.at(newAddrs[i + 1]).sequenceId != state.sequenceId;
+      state.emitDiff(lastState, newOpcodes, table, endSequence);
     }
+    table.Opcodes.swap(newOpcodes);
+  }
+}
+
+// Update debug lines, and update the locationUpdater with debug line offset
+// changes so we can update offsets into the debug line section.
+static void updateDebugLines(llvm::DWARFYAML::Data& data,
+                             LocationUpdater& locationUpdater) {
+  for (auto& table : data.DebugLines) {
+    updateLineTable(table, locationUpdater);
   }
   // After updating the contents, run the emitter in order to update the
   // lengths of each section. We will use that to update offsets into the
@@ -768,105 +782,111 @@ static void updateDebugLines(llvm::DWARFYAML::Data& data,
   }
 }
 
-// Iterate in parallel over a DwarfContext representation element and a
-// YAML element, which parallel each other.
-template<typename T, typename U, typename W>
-static void iterContextAndYAML(const T& contextList, U& yamlList, W func) {
-  auto yamlValue = yamlList.begin();
-  for (const auto& contextValue : contextList) {
-    assert(yamlValue != yamlList.end());
-    func(contextValue, *yamlValue);
-    yamlValue++;
-  }
-  assert(yamlValue == yamlList.end());
+// An attribute value in a DIE that we may need to update.
+struct DIEValue {
+  llvm::dwarf::Attribute attr;
+  llvm::dwarf::Form form;
+  BinaryLocation value;
+};
+
+// Whether updateDIE cares about an attribute.
+static bool isUpdatedAttribute(
+  const llvm::DWARFAbbreviationDeclaration::AttributeSpec& attrSpec) {
+  auto attr = attrSpec.Attr;
+  return attr == llvm::dwarf::DW_AT_low_pc ||
+         attr == llvm::dwarf::DW_AT_high_pc ||
+         attr == llvm::dwarf::DW_AT_stmt_list ||
+         (attr == llvm::dwarf::DW_AT_location &&
+          attrSpec.Form == llvm::dwarf::DW_FORM_sec_offset);
 }
 
-// Updates a YAML entry from a DWARF DIE. Also updates LocationUpdater
-// associating each .debug_loc entry with the base address of its corresponding
-// compilation unit.
-static void updateDIE(const llvm::DWARFDebugInfoEntry& DIE,
-                      llvm::DWARFYAML::Entry& yamlEntry,
-                      const llvm::DWARFAbbreviationDeclaration* abbrevDecl,
+// Updates the relevant attribute values of a DIE (see isUpdatedAttribute),
+// which are given in order. Also updates LocationUpdater associating each
+// .debug_loc entry with the base address of its corresponding compilation
+// unit.
+static void updateDIE(llvm::dwarf::Tag tag,
+                      std::vector<DIEValue>& values,
                       LocationUpdater& locationUpdater,
                       size_t compileUnitIndex) {
-  auto tag = DIE.getTag();
   // Pairs of low/high_pc require some special handling, as the high
   // may be an offset relative to the low. First, process everything but
   // the high pcs, so we see the low pcs first.
   BinaryLocation oldLowPC = 0, newLowPC = 0;
-  iterContextAndYAML(
-    abbrevDecl->attributes(),
-    yamlEntry.Values,
-    [&](const llvm::DWARFAbbreviationDeclaration::AttributeSpec& attrSpec,
-        llvm::DWARFYAML::FormValue& yamlValue) {
-      auto attr = attrSpec.Attr;
-      if (attr == llvm::dwarf::DW_AT_low_pc) {
-        // This is an address.
-        BinaryLocation oldValue = yamlValue.Value, newValue = 0;
-        if (tag == llvm::dwarf::DW_TAG_GNU_call_site ||
-            tag == llvm::dwarf::DW_TAG_inlined_subroutine ||
-            tag == llvm::dwarf::DW_TAG_lexical_block ||
-            tag == llvm::dwarf::DW_TAG_label) {
-          newValue = locationUpdater.getNewStart(oldValue);
-        } else if (tag == llvm::dwarf::DW_TAG_compile_unit) {
-          newValue = locationUpdater.getNewFuncStart(oldValue);
-          // Per the DWARF spec, "The base address of a compile unit is
-          // defined as the value of the DW_AT_low_pc attribute, if present."
-          locationUpdater.compileUnitBases[compileUnitIndex] =
-            LocationUpdater::OldToNew{oldValue, newValue};
-        } else if (tag == llvm::dwarf::DW_TAG_subprogram) {
-          newValue = locationUpdater.getNewFuncStart(oldValue);
-        } else {
-          Fatal() << "unknown tag with low_pc "
-                  << llvm::dwarf::TagString(tag).str();
-        }
-        oldLowPC = oldValue;
-        newLowPC = newValue;
-        yamlValue.Value = newValue;
-      } else if (attr == llvm::dwarf::DW_AT_stmt_list) {
-        // This is an offset into the debug line section.
-        yamlValue.Value =
-          locationUpdater.getNewDebugLineLocation(yamlValue.Value);
-      } else if (attr == llvm::dwarf::DW_AT_location &&
-                 attrSpec.Form == llvm::dwarf::DW_FORM_sec_offset) {
-        BinaryLocation locOffset = yamlValue.Value;
-        locationUpdater.locToUnitMap[locOffset] = compileUnitIndex;
-      }
-    });
-  // Next, process the high_pcs.
-  // TODO: do this more efficiently, without a second traversal (but that's a
-  //       little tricky given the special double-traversal we have).
-  iterContextAndYAML(
-    abbrevDecl->attributes(),
-    yamlEntry.Values,
-    [&](const llvm::DWARFAbbreviationDeclaration::AttributeSpec& attrSpec,
-        llvm::DWARFYAML::FormValue& yamlValue) {
-      auto attr = attrSpec.Attr;
-      if (attr != llvm::dwarf::DW_AT_high_pc) {
-        return;
-      }
-      BinaryLocation oldValue = yamlValue.Value, newValue = 0;
-      bool isRelative = attrSpec.Form == llvm::dwarf::DW_FORM_data4;
-      if (isRelative) {
-        oldValue += oldLowPC;
-      }
+  for (auto& dieValue : values) {
+    auto attr = dieValue.attr;
+    if (attr == llvm::dwarf::DW_AT_low_pc) {
+      // This is an address.
+      BinaryLocation oldValue = dieValue.value, newValue = 0;
       if (tag == llvm::dwarf::DW_TAG_GNU_call_site ||
           tag == llvm::dwarf::DW_TAG_inlined_subroutine ||
           tag == llvm::dwarf::DW_TAG_lexical_block ||
           tag == llvm::dwarf::DW_TAG_label) {
-        newValue = locationUpdater.getNewExprEnd(oldValue);
-      } else if (tag == llvm::dwarf::DW_TAG_compile_unit ||
-                 tag == llvm::dwarf::DW_TAG_subprogram) {
-        newValue = locationUpdater.getNewFuncEnd(oldValue);
+        newValue = locationUpdater.getNewStart(oldValue);
+      } else if (tag == llvm::dwarf::DW_TAG_compile_unit) {
+        newValue = locationUpdater.getNewFuncStart(oldValue);
+        // Per the DWARF spec, "The base address of a compile unit is
+        // defined as the value of the DW_AT_low_pc attribute, if present."
+        locationUpdater.compileUnitBases[compileUnitIndex] =
+          LocationUpdater::OldToNew{oldValue, newValue};
+      } else if (tag == llvm::dwarf::DW_TAG_subprogram) {
+        newValue = locationUpdater.getNewFuncStart(oldValue);
       } else {
         Fatal() << "unknown tag with low_pc "
                 << llvm::dwarf::TagString(tag).str();
       }
-      if (isRelative) {
-        newValue -= newLowPC;
-      }
-      yamlValue.Value = newValue;
-    });
+      oldLowPC = oldValue;
+      newLowPC = newValue;
+      dieValue.value = newValue;
+    } else if (attr == llvm::dwarf::DW_AT_stmt_list) {
+      // This is an offset into the debug line section.
+      dieValue.value = locationUpdater.getNewDebugLineLocation(dieValue.value);
+    } else if (attr == llvm::dwarf::DW_AT_location) {
+      BinaryLocation locOffset = dieValue.value;
+      locationUpdater.locToUnitMap[locOffset] = compileUnitIndex;
+    }
+  }
+  // Next, process the high_pcs.
+  // TODO: do this more efficiently, without a second traversal (but that's a
+  //       little tricky given the special double-traversal we have).
+  for (auto& dieValue : values) {
+    if (dieValue.attr != llvm::dwarf::DW_AT_high_pc) {
+      continue;
+    }
+    BinaryLocation oldValue = dieValue.value, newValue = 0;
+    bool isRelative = dieValue.form == llvm::dwarf::DW_FORM_data4;
+    if (isRelative) {
+      oldValue += oldLowPC;
+    }
+    if (tag == llvm::dwarf::DW_TAG_GNU_call_site ||
+        tag == llvm::dwarf::DW_TAG_inlined_subroutine ||
+        tag == llvm::dwarf::DW_TAG_lexical_block ||
+        tag == llvm::dwarf::DW_TAG_label) {
+      newValue = locationUpdater.getNewExprEnd(oldValue);
+    } else if (tag == llvm::dwarf::DW_TAG_compile_unit ||
+               tag == llvm::dwarf::DW_TAG_subprogram) {
+      newValue = locationUpdater.getNewFuncEnd(oldValue);
+    } else {
+      Fatal() << "unknown tag with low_pc "
+              << llvm::dwarf::TagString(tag).str();
+    }
+    if (isRelative) {
+      newValue -= newLowPC;
+    }
+    dieValue.value = newValue;
+  }
+}
+
+// Iterate in parallel over a DwarfContext representation element and a
+// YAML element, which parallel each other.
+template<typename T, typename U, typename W>
+static void iterContextAndYAML(const T& contextList, U& yamlList, W func) {
+  auto yamlValue = yamlList.begin();
+  for (const auto& contextValue : contextList) {
+    assert(yamlValue != yamlList.end());
+    func(contextValue, *yamlValue);
+    yamlValue++;
+  }
+  assert(yamlValue == yamlList.end());
 }
 
 static void updateCompileUnits(const BinaryenDWARFInfo& info,
@@ -876,6 +896,8 @@ static void updateCompileUnits(const BinaryenDWARFInfo& info,
   // The context has the high-level information we need, and the YAML is where
   // we write changes. First, iterate over the compile units.
   size_t compileUnitIndex = 0;
+  std::vector<DIEValue> values;
+  std::vector<llvm::DWARFYAML::FormValue*> yamlValues;
   iterContextAndYAML(
     info.context->compile_units(),
     yaml.CompileUnits,
@@ -897,23 +919,44 @@ static void updateCompileUnits(const BinaryenDWARFInfo& info,
           // Process the entries in each relevant DIE, looking for attributes to
           // change.
           auto abbrevDecl = DIE.getAbbreviationDeclarationPtr();
-          if (abbrevDecl) {
-            // This is relevant; look for things to update.
-            updateDIE(
-              DIE, yamlEntry, abbrevDecl, locationUpdater, compileUnitIndex);
+          if (!abbrevDecl) {
+            return;
+          }
+          values.clear();
+          yamlValues.clear();
+          iterContextAndYAML(
+            abbrevDecl->attributes(),
+            yamlEntry.Values,
+            [&](const llvm::DWARFAbbreviationDeclaration::AttributeSpec&
+                  attrSpec,
+                llvm::DWARFYAML::FormValue& yamlValue) {
+              if (isUpdatedAttribute(attrSpec)) {
+                values.push_back(DIEValue{attrSpec.Attr,
+                                          attrSpec.Form,
+                                          BinaryLocation(yamlValue.Value)});
+                yamlValues.push_back(&yamlValue);
+              }
+            });
+          if (values.empty()) {
+            return;
+          }
+          // This is relevant; update things.
+          updateDIE(DIE.getTag(), values, locationUpdater, compileUnitIndex);
+          for (size_t i = 0; i < values.size(); i++) {
+            yamlValues[i]->Value = values[i].value;
           }
         });
       compileUnitIndex++;
     });
 }
 
-static void updateRanges(llvm::DWARFYAML::Data& yaml,
+static void updateRanges(std::vector<llvm::DWARFYAML::Range>& ranges,
                          const LocationUpdater& locationUpdater) {
   // In each range section, try to update the start and end. If we no longer
   // have something to map them to, we must skip that part.
   size_t skip = 0;
-  for (size_t i = 0; i < yaml.Ranges.size(); i++) {
-    auto& range = yaml.Ranges[i];
+  for (size_t i = 0; i < ranges.size(); i++) {
+    auto& range = ranges[i];
     BinaryLocation oldStart = range.Start, oldEnd = range.End, newStart = 0,
                    newEnd = 0;
     // If this is an end marker (0, 0), or an invalid range (0, x) or (x, 0)
@@ -938,7 +981,7 @@ static void updateRanges(llvm::DWARFYAML::Data& yaml,
       // longer contiguous. We should check that, and possibly split/merge
       // the range. Or, we may need to have tracking in the IR for this.
     }
-    auto& writtenRange = yaml.Ranges[i - skip];
+    auto& writtenRange = ranges[i - skip];
     writtenRange.Start = newStart;
     writtenRange.End = newEnd;
   }
@@ -957,7 +1000,7 @@ static bool isEndMarkerLoc(const llvm::DWARFYAML::Loc& loc) {
 }
 
 // Update the .debug_loc section.
-static void updateLoc(llvm::DWARFYAML::Data& yaml,
+static void updateLoc(std::vector<llvm::DWARFYAML::Loc>& locs,
                       const LocationUpdater& locationUpdater) {
   // Similar to ranges, try to update the start and end. Note that here we
   // can't skip since the location description is a variable number of bytes,
@@ -969,7 +1012,6 @@ static void updateLoc(llvm::DWARFYAML::Data& yaml,
   // list). However, we may change the base's value as after moving instructions
   // around the old base may not be smaller than all the values relative to it.
   BinaryLocation oldBase, newBase;
-  auto& locs = yaml.Locs;
   for (size_t i = 0; i < locs.size(); i++) {
     auto& loc = locs[i];
     if (atStart) {
@@ -1052,24 +1094,472 @@ static void updateLoc(llvm::DWARFYAML::Data& yaml,
   }
 }
 
+//
+// Updating the sections in place
+//
+// Going through DWARFYAML::Data is simple, but it turns every DIE and every
+// attribute value into an object of its own, and then emits all of them from
+// scratch, which is slow and uses a lot of memory on large debug builds. Yet
+// most of the DWARF does not change: in .debug_info, .debug_ranges and
+// .debug_loc we only update addresses and offsets of a fixed size, which we
+// can patch in place. Only .debug_line must be regenerated, which we do one
+// table at a time. This works as long as the layout of the sections stays the
+// same, that is, when the address size remains 32 bits, and when we understand
+// every form we need to update. Otherwise we use DWARFYAML.
+//
+
+static void writeU32(std::vector<char>& data, size_t offset, uint32_t value) {
+  for (size_t i = 0; i < 4; i++) {
+    data[offset + i] = char(value >> (8 * i));
+  }
+}
+
+static void writeU32(llvm::raw_ostream& os, uint32_t value) {
+  for (size_t i = 0; i < 4; i++) {
+    os << char(value >> (8 * i));
+  }
+}
+
+// Reads the header of the line table at an offset in .debug_line. Returns the
+// offsets of the end of the header and of the end of the table, or nothing if
+// the table is not one we can rewrite.
+static std::optional<std::pair<uint64_t, uint64_t>>
+readLineTableHeader(const llvm::DataExtractor& data,
+                    uint64_t offset,
+                    llvm::DWARFYAML::LineTable& table) {
+  if (!data.isValidOffsetForDataOfSize(offset, 4)) {
+    return {};
+  }
+  table.Position = offset;
+  uint32_t length = data.getU32(&offset);
+  // Only 32-bit DWARF is supported.
+  if (length >= llvm::dwarf::DW_LENGTH_lo_reserved ||
+      !data.isValidOffsetForDataOfSize(offset, length)) {
+    return {};
+  }
+  uint64_t end = offset + length;
+  table.Version = data.getU16(&offset);
+  if (table.Version < 2 || table.Version > 4) {
+    return {};
+  }
+  table.PrologueLength = data.getU32(&offset);
+  uint64_t headerEnd = offset + table.PrologueLength;
+  if (headerEnd > end) {
+    return {};
+  }
+  table.MinInstLength = data.getU8(&offset);
+  if (table.Version >= 4) {
+    table.MaxOpsPerInst = data.getU8(&offset);
+  }
+  table.DefaultIsStmt = data.getU8(&offset);
+  table.LineBase = data.getU8(&offset);
+  table.LineRange = data.getU8(&offset);
+  table.OpcodeBase = data.getU8(&offset);
+  table.StandardOpcodeLengths.clear();
+  for (uint8_t i = 1; i < table.OpcodeBase; i++) {
+    table.StandardOpcodeLengths.push_back(data.getU8(&offset));
+  }
+  return std::make_pair(headerEnd, end);
+}
+
+// Reads the opcodes of a line table, which are in [offset, end).
+static void readLineTableOpcodes(const llvm::DataExtractor& data,
+                                 uint64_t offset,
+                                 uint64_t end,
+                                 llvm::DWARFYAML::LineTable& table) {
+  table.Opcodes.clear();
+  while (offset < end) {
+    llvm::DWARFYAML::LineTableOpcode op = {};
+    op.Opcode = llvm::dwarf::LineNumberOps(data.getU8(&offset));
+    if (op.Opcode == 0) {
+      auto start = offset;
+      op.ExtLen = data.getULEB128(&offset);
+      op.SubOpcode = llvm::dwarf::LineNumberExtendedOps(data.getU8(&offset));
+      switch (op.SubOpcode) {
+        case llvm::dwarf::DW_LNE_set_address:
+        case llvm::dwarf::DW_LNE_set_discriminator:
+          op.Data = data.getU32(&offset);
+          break;
+        case llvm::dwarf::DW_LNE_define_file:
+          // LineState::update will error on this.
+          break;
+        case llvm::dwarf::DW_LNE_end_sequence:
+          break;
+        default:
+          while (offset < start + op.ExtLen) {
+            op.UnknownOpcodeData.push_back(data.getU8(&offset));
+          }
+      }
+    } else if (op.Opcode < table.OpcodeBase) {
+      switch (op.Opcode) {
+        case llvm::dwarf::DW_LNS_copy:
+        case llvm::dwarf::DW_LNS_negate_stmt:
+        case llvm::dwarf::DW_LNS_set_basic_block:
+        case llvm::dwarf::DW_LNS_const_add_pc:
+        case llvm::dwarf::DW_LNS_set_prologue_end:
+        case llvm::dwarf::DW_LNS_set_epilogue_begin:
+          break;
+        case llvm::dwarf::DW_LNS_advance_pc:
+        case llvm::dwarf::DW_LNS_set_file:
+        case llvm::dwarf::DW_LNS_set_column:
+        case llvm::dwarf::DW_LNS_set_isa:
+          op.Data = data.getULEB128(&offset);
+          break;
+        case llvm::dwarf::DW_LNS_advance_line:
+          op.SData = data.getSLEB128(&offset);
+          break;
+        case llvm::dwarf::DW_LNS_fixed_advance_pc:
+          op.Data = data.getU16(&offset);
+          break;
+        default:
+          for (uint8_t i = 0; i < table.StandardOpcodeLengths[op.Opcode - 1];
+               i++) {
+            op.StandardOpcodeData.push_back(data.getULEB128(&offset));
+          }
+      }
+    }
+    table.Opcodes.push_back(op);
+  }
+}
+
+// Writes the opcodes of a line table, in the same way as the DWARFYAML
+// emitter.
+static void writeLineTableOpcodes(llvm::raw_ostream& os,
+                                  const llvm::DWARFYAML::LineTable& table) {
+  for (auto& op : table.Opcodes) {
+    os << char(op.Opcode);
+    if (op.Opcode == 0) {
+      llvm::encodeULEB128(op.ExtLen, os);
+      os << char(op.SubOpcode);
+      switch (op.SubOpcode) {
+        case llvm::dwarf::DW_LNE_set_address:
+        case llvm::dwarf::DW_LNE_set_discriminator:
+          writeU32(os, op.Data);
+          break;
+        case llvm::dwarf::DW_LNE_end_sequence:
+          break;
+        default:
+          for (auto byte : op.UnknownOpcodeData) {
+            os << char(byte);
+          }
+      }
+    } else if (op.Opcode < table.OpcodeBase) {
+      switch (op.Opcode) {
+        case llvm::dwarf::DW_LNS_copy:
+        case llvm::dwarf::DW_LNS_negate_stmt:
+        case llvm::dwarf::DW_LNS_set_basic_block:
+        case llvm::dwarf::DW_LNS_const_add_pc:
+        case llvm::dwarf::DW_LNS_set_prologue_end:
+        case llvm::dwarf::DW_LNS_set_epilogue_begin:
+          break;
+        case llvm::dwarf::DW_LNS_advance_pc:
+        case llvm::dwarf::DW_LNS_set_file:
+        case llvm::dwarf::DW_LNS_set_column:
+        case llvm::dwarf::DW_LNS_set_isa:
+          llvm::encodeULEB128(op.Data, os);
+          break;
+        case llvm::dwarf::DW_LNS_advance_line:
+          llvm::encodeSLEB128(op.SData, os);
+          break;
+        case llvm::dwarf::DW_LNS_fixed_advance_pc:
+          os << char(op.Data) << char(op.Data >> 8);
+          break;
+        default:
+          for (uint64_t data : op.StandardOpcodeData) {
+            llvm::encodeULEB128(data, os);
+          }
+      }
+    }
+  }
+}
+
+struct DWARFSectionUpdater {
+  Module& wasm;
+  const BinaryenDWARFInfo& info;
+  LocationUpdater& locationUpdater;
+
+  DWARFSectionUpdater(Module& wasm,
+                      const BinaryenDWARFInfo& info,
+                      LocationUpdater& locationUpdater)
+    : wasm(wasm), info(info), locationUpdater(locationUpdater) {}
+
+  // Checks whether we can update the sections in place, and reads what we need
+  // to update. Nothing is modified here, so if this fails, the DWARFYAML path
+  // can still be used.
+  bool prepare() {
+    if (wasm.memory.is64()) {
+      // Memory64Lowering may need to change the address size.
+      return false;
+    }
+    return prepareCompileUnits() && prepareDebugLines() && prepareRanges() &&
+           prepareLocs();
+  }
+
+  void update() {
+    // The order here matters, as in the DWARFYAML path: updating the line
+    // tables computes their new offsets, which the compile units refer to, and
+    // updating the compile units finds the bases for .debug_loc.
+    rewriteDebugLines();
+    rewriteCompileUnits();
+    rewriteRanges();
+    rewriteLocs();
+  }
+
+private:
+  // The attribute values in .debug_info that we need to update, and their
+  // offsets.
+  std::vector<DIEValue> values;
+  std::vector<uint64_t> valueOffsets;
+
+  // A DIE whose values are values[firstValue, firstValue + numValues).
+  struct DIEInfo {
+    llvm::dwarf::Tag tag;
+    size_t compileUnitIndex;
+    size_t firstValue;
+    size_t numValues;
+  };
+  std::vector<DIEInfo> dies;
+
+  // The offsets of the line tables, in the order of the compile units that
+  // refer to them.
+  std::vector<uint64_t> lineTables;
+
+  // The contents of .debug_ranges and .debug_loc, and the offsets of the
+  // entries in the latter. We do not read the location descriptions in
+  // .debug_loc, as we do not change them.
+  std::vector<llvm::DWARFYAML::Range> ranges;
+  std::vector<llvm::DWARFYAML::Loc> locs;
+  std::vector<uint64_t> locOffsets;
+
+  UserSection* getSection(const char* name) {
+    for (auto& section : wasm.userSections) {
+      if (section.name == name) {
+        return &section;
+      }
+    }
+    return nullptr;
+  }
+
+  bool prepareCompileUnits() {
+    size_t compileUnitIndex = 0;
+    for (auto& CU : info.context->compile_units()) {
+      auto& params = CU->getFormParams();
+      if (params.AddrSize != AddressSize ||
+          params.Format != llvm::dwarf::DWARF32 || params.Version < 2 ||
+          params.Version > 4) {
+        return false;
+      }
+      auto data = CU->getDebugInfoExtractor();
+      for (auto& DIE : CU->dies()) {
+        auto* abbrevDecl = DIE.getAbbreviationDeclarationPtr();
+        if (!abbrevDecl) {
+          continue;
+        }
+        // Skip the abbreviation code, and then find the offset of each value.
+        uint64_t offset = DIE.getOffset();
+        data.getULEB128(&offset);
+        size_t firstValue = values.size();
+        for (auto& attrSpec : abbrevDecl->attributes()) {
+          if (isUpdatedAttribute(attrSpec)) {
+            // We can only update 32-bit values in place.
+            auto form = attrSpec.Form;
+            if ((form != llvm::dwarf::DW_FORM_addr &&
+                 form != llvm::dwarf::DW_FORM_data4 &&
+                 form != llvm::dwarf::DW_FORM_sec_offset) ||
+                !data.isValidOffsetForDataOfSize(offset, 4)) {
+              return false;
+            }
+            uint64_t valueOffset = offset;
+            values.push_back(
+              DIEValue{attrSpec.Attr, form, data.getU32(&valueOffset)});
+            valueOffsets.push_back(offset);
+          }
+          if (!attrSpec.isImplicitConst() &&
+              !llvm::DWARFFormValue::skipValue(
+                attrSpec.Form, data, &offset, params)) {
+            return false;
+          }
+        }
+        if (values.size() > firstValue) {
+          dies.push_back(DIEInfo{DIE.getTag(),
+                                 compileUnitIndex,
+                                 firstValue,
+                                 values.size() - firstValue});
+        }
+      }
+      if (auto stmtList = llvm::dwarf::toSectionOffset(
+            CU->getUnitDIE().find(llvm::dwarf::DW_AT_stmt_list))) {
+        lineTables.push_back(*stmtList);
+      }
+      compileUnitIndex++;
+    }
+    return true;
+  }
+
+  bool prepareDebugLines() {
+    llvm::DataExtractor data(
+      info.context->getDWARFObj().getLineSection().Data, true, AddressSize);
+    llvm::DWARFYAML::LineTable table;
+    for (auto offset : lineTables) {
+      if (!readLineTableHeader(data, offset, table)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool prepareRanges() {
+    llvm::DataExtractor data(
+      info.context->getDWARFObj().getRangesSection().Data, true, AddressSize);
+    auto size = data.getData().size();
+    if (size % (2 * AddressSize)) {
+      return false;
+    }
+    uint64_t offset = 0;
+    while (offset < size) {
+      llvm::DWARFYAML::Range range = {};
+      range.Start = data.getU32(&offset);
+      range.End = data.getU32(&offset);
+      ranges.push_back(range);
+    }
+    return true;
+  }
+
+  bool prepareLocs() {
+    llvm::DataExtractor data(
+      info.context->getDWARFObj().getLocSection().Data, true, AddressSize);
+    uint64_t offset = 0;
+    uint64_t listOffset = 0;
+    while (offset < data.getData().size()) {
+      if (!data.isValidOffsetForDataOfSize(offset, 2 * AddressSize)) {
+        return false;
+      }
+      locOffsets.push_back(offset);
+      llvm::DWARFYAML::Loc loc;
+      loc.Start = data.getU32(&offset);
+      loc.End = data.getU32(&offset);
+      loc.CompileUnitOffset = listOffset;
+      if (loc.Start == 0 && loc.End == 0) {
+        // The end of the list; another may begin right after it.
+        listOffset = offset;
+      } else if (loc.Start != uint32_t(-1)) {
+        // Skip the location description.
+        if (!data.isValidOffsetForDataOfSize(offset, 2)) {
+          return false;
+        }
+        offset += data.getU16(&offset);
+        if (offset > data.getData().size()) {
+          return false;
+        }
+      }
+      locs.push_back(std::move(loc));
+    }
+    return true;
+  }
+
+  void rewriteDebugLines() {
+    if (lineTables.empty()) {
+      return;
+    }
+    llvm::DataExtractor data(
+      info.context->getDWARFObj().getLineSection().Data, true, AddressSize);
+    std::string buffer;
+    llvm::raw_string_ostream os(buffer);
+    llvm::DWARFYAML::LineTable table;
+    for (auto offset : lineTables) {
+      auto [headerEnd, end] = *readLineTableHeader(data, offset, table);
+      readLineTableOpcodes(data, headerEnd, end, table);
+      updateLineTable(table, locationUpdater);
+      // Write the length later, when we know it, and copy the header, which
+      // does not change.
+      os.flush();
+      BinaryLocation newOffset = buffer.size();
+      locationUpdater.debugLineMap[offset] = newOffset;
+      writeU32(os, 0);
+      os << data.getData().slice(offset + 4, headerEnd);
+      writeLineTableOpcodes(os, table);
+      os.flush();
+      size_t length = buffer.size() - newOffset - 4;
+      if (length >= llvm::dwarf::DW_LENGTH_lo_reserved) {
+        Fatal() << "line table is too big";
+      }
+      for (size_t i = 0; i < 4; i++) {
+        buffer[newOffset + i] = char(length >> (8 * i));
+      }
+    }
+    os.flush();
+    // The section may refer to the old contents, so replace it only now.
+    getSection(".debug_line")->data.assign(buffer.begin(), buffer.end());
+  }
+
+  void rewriteCompileUnits() {
+    if (dies.empty()) {
+      return;
+    }
+    auto& sectionData = getSection(".debug_info")->data;
+    std::vector<DIEValue> dieValues;
+    for (auto& die : dies) {
+      auto begin = values.begin() + die.firstValue;
+      dieValues.assign(begin, begin + die.numValues);
+      updateDIE(die.tag, dieValues, locationUpdater, die.compileUnitIndex);
+      for (size_t i = 0; i < die.numValues; i++) {
+        writeU32(sectionData,
+                 valueOffsets[die.firstValue + i],
+                 dieValues[i].value);
+      }
+    }
+  }
+
+  void rewriteRanges() {
+    if (ranges.empty()) {
+      return;
+    }
+    updateRanges(ranges, locationUpdater);
+    auto& sectionData = getSection(".debug_ranges")->data;
+    for (size_t i = 0; i < ranges.size(); i++) {
+      writeU32(sectionData, i * 2 * AddressSize, ranges[i].Start);
+      writeU32(sectionData, (i * 2 + 1) * AddressSize, ranges[i].End);
+    }
+  }
+
+  void rewriteLocs() {
+    if (locs.empty()) {
+      return;
+    }
+    updateLoc(locs, locationUpdater);
+    auto& sectionData = getSection(".debug_loc")->data;
+    for (size_t i = 0; i < locs.size(); i++) {
+      writeU32(sectionData, locOffsets[i], locs[i].Start);
+      writeU32(sectionData, locOffsets[i] + AddressSize, locs[i].End);
+    }
+  }
+};
+
 void writeDWARFSections(Module& wasm, const BinaryLocations& newLocations) {
   BinaryenDWARFInfo info(wasm);
 
+  LocationUpdater locationUpdater(wasm, newLocations);
+
+  // Update the sections in place, if we can.
+  DWARFSectionUpdater updater(wasm, info, locationUpdater);
+  if (updater.prepare()) {
+    updater.update();
+    return;
+  }
+
   // Convert to Data representation, which YAML can use to write.
   llvm::DWARFYAML::Data data;
   if (dwarf2yaml(*info.context, data)) {
     Fatal() << "Failed to parse DWARF to YAML";
   }
 
-  LocationUpdater locationUpdater(wasm, newLocations);
-
   updateDebugLines(data, locationUpdater);
 
   updateCompileUnits(info, data, locationUpdater, wasm.memory.is64());
 
-  updateRanges(data, locationUpdater);
+  updateRanges(data.Ranges, locationUpdater);
 
-  updateLoc(data, locationUpdater);
+  updateLoc(data.Locs, locationUpdater);
 
   // Convert to binary sections.
   auto newSections =
@@ -1,3 +1,7 @@
+#include <optional>
+
+#include "ir/iteration.h"
+#include "ir/manipulation.h"
 #include "wasm-interpreter.h"
 
 namespace wasm {
@@ -23,4 +27,473 @@ std::ostream& operator<<(std::ostream& o, const WasmException& exn) {
   return o << exn.tag << " " << exn.values;
 }
 
+namespace {
+
+using Op = InterpreterBytecode::Op;
+
+bool isSupported(Type type) {
+  return type == Type::none || type == Type::unreachable || type == Type::i32 ||
+         type == Type::i64 || type == Type::f32 || type == Type::f64;
+}
+
+std::optional<Op> getOp(UnaryOp op) {
+  switch (op) {
+    case EqZInt32:
+      return Op::I32Eqz;
+    case EqZInt64:
+      return Op::I64Eqz;
+    case WrapInt64:
+      return Op::I32WrapI64;
+    case ExtendSInt32:
+      return Op::I64ExtendI32S;
+    case ExtendUInt32:
+      return Op::I64ExtendI32U;
+    default:
+      return {};
+  }
+}
+
+std::optional<Op> getOp(BinaryOp op) {
+  switch (op) {
+    case AddInt32:
+      return Op::I32Add;
+    case SubInt32:
+      return Op::I32Sub;
+    case MulInt32:
+      return Op::I32Mul;
+    case AndInt32:
+      return Op::I32And;
+    case OrInt32:
+      return Op::I32Or;
+    case XorInt32:
+      return Op::I32Xor;
+    case ShlInt32:
+      return Op::I32Shl;
+    case ShrSInt32:
+      return Op::I32ShrS;
+    case ShrUInt32:
+      return Op::I32ShrU;
+    case RotLInt32:
+      return Op::I32RotL;
+    case RotRInt32:
+      return Op::I32RotR;
+    case EqInt32:
+      return Op::I32Eq;
+    case NeInt32:
+      return Op::I32Ne;
+    case LtSInt32:
+      return Op::I32LtS;
+    case LtUInt32:
+      return Op::I32LtU;
+    case GtSInt32:
+      return Op::I32GtS;
+    case GtUInt32:
+      return Op::I32GtU;
+    case LeSInt32:
+      return Op::I32LeS;
+    case LeUInt32:
+      return Op::I32LeU;
+    case GeSInt32:
+      return Op::I32GeS;
+    case GeUInt32:
+      return Op::I32GeU;
+    case AddInt64:
+      return Op::I64Add;
+    case SubInt64:
+      return Op::I64Sub;
+    case MulInt64:
+      return Op::I64Mul;
+    case AndInt64:
+      return Op::I64And;
+    case OrInt64:
+      return Op::I64Or;
+    case XorInt64:
+      return Op::I64Xor;
+    case ShlInt64:
+      return Op::I64Shl;
+    case ShrSInt64:
+      return Op::I64ShrS;
+    case ShrUInt64:
+      return Op::I64ShrU;
+    case RotLInt64:
+      return Op::I64RotL;
+    case RotRInt64:
+      return Op::I64RotR;
+    case EqInt64:
+      return Op::I64Eq;
+    case NeInt64:
+      return Op::I64Ne;
+    case LtSInt64:
+      return Op::I64LtS;
+    case LtUInt64:
+      return Op::I64LtU;
+    case GtSInt64:
+      return Op::I64GtS;
+    case GtUInt64:
+      return Op::I64GtU;
+    case LeSInt64:
+      return Op::I64LeS;
+    case LeUInt64:
+      return Op::I64LeU;
+    case GeSInt64:
+      return Op::I64GeS;
+    case GeUInt64:
+      return Op::I64GeU;
+    default:
+      return {};
+  }
+}
+
+struct BytecodeCompiler {
+  InterpreterBytecode& bytecode;
+  Module& scratch;
+  // The results of the function, which return calls return.
+  Type results;
+
+  // The number of values on the stack.
+  Index height = 0;
+
+  // We compile recursively, so give up on very deeply nested code, which the
+  // tree walker handles better.
+  static const Index MaxDepth = 10000;
+  Index depth = 0;
+
+  bool failed = false;
+
+  struct Label {
+    Name name;
+    // The stack height and whether a value is sent, for branches to here.
+    Index height;
+    bool hasValue;
+    // The start of a loop. For blocks, the branches (and br_table targets) to
+    // here are patched when we reach the end.
+    std::optional<Index> pc;
+    std::vector<Index> branches;
+    std::vector<Index> tableTargets;
+
+    Label(Name name, Index height, bool hasValue, std::optional<Index> pc = {})
+      : name(name), height(height), hasValue(hasValue), pc(pc) {}
+  };
+  std::vector<Label> labels;
+
+  BytecodeCompiler(InterpreterBytecode& bytecode, Module& scratch, Type results)
+    : bytecode(bytecode), scratch(scratch), results(results) {}
+
+  Index emit(Op op, Index a = 0, uint64_t imm = 0) {
+    InterpreterBytecode::Instruction inst;
+    inst.op = op;
+    inst.a = a;
+    inst.imm = imm;
+    bytecode.code.push_back(inst);
+    return bytecode.code.size() - 1;
+  }
+
+  void emitExpression(Op op, Expression* curr) {
+    auto index = emit(op);
+    bytecode.code[index].expr = curr;
+  }
+
+  Label& getLabel(Name name) {
+    for (auto iter = labels.rbegin(); iter != labels.rend(); ++iter) {
+      if (iter->name == name) {
+        return *iter;
+      }
+    }
+    WASM_UNREACHABLE("missing label");
+  }
+
+  void emitBranch(Op op, Name name) {
+    auto& label = getLabel(name);
+    auto index = emit(op, 0, (uint64_t(label.height) << 1) | label.hasValue);
+    if (label.pc) {
+      bytecode.code[index].a = *label.pc;
+    } else {
+      label.branches.push_back(index);
+    }
+  }
+
+  // Ends a block, resolving the branches to it.
+  void bindLabel() {
+    auto& label = labels.back();
+    Index pc = bytecode.code.size();
+    for (auto index : label.branches) {
+      bytecode.code[index].a = pc;
+    }
+    for (auto index : label.tableTargets) {
+      bytecode.targets[index].pc = pc;
+    }
+    labels.pop_back();
+  }
+
+  // Compiles the children of an expression, and returns whether the
+  // expression itself is reached. If it is not, there is no need to emit it.
+  bool compileChildren(Expression* curr) {
+    bool reached = true;
+    for (auto* child : ChildIterator(curr)) {
+      compile(child);
+      if (child->type == Type::unreachable) {
+        reached = false;
+      }
+    }
+    return reached;
+  }
+
+  void compile(Expression* curr) {
+    if (failed || !isSupported(curr->type) || depth >= MaxDepth) {
+      failed = true;
+      return;
+    }
+    depth++;
+    auto start = height;
+    switch (curr->_id) {
+      case Expression::BlockId:
+        compileBlock(curr->cast<Block>());
+        break;
+      case Expression::IfId:
+        compileIf(curr->cast<If>(), start);
+        break;
+      case Expression::LoopId: {
+        auto* loop = curr->cast<Loop>();
+        labels.emplace_back(loop->name, start, false, bytecode.code.size());
+        compile(loop->body);
+        labels.pop_back();
+        break;
+      }
+      case Expression::BreakId: {
+        auto* br = curr->cast<Break>();
+        if (compileChildren(br)) {
+          emitBranch(br->condition ? Op::BrIf : Op::Br, br->name);
+        }
+        break;
+      }
+      case Expression::SwitchId:
+        compileSwitch(curr->cast<Switch>());
+        break;
+      case Expression::ReturnId:
+        if (compileChildren(curr)) {
+          emit(Op::Return, curr->cast<Return>()->value != nullptr);
+        }
+        break;
+      case Expression::DropId:
+        if (compileChildren(curr)) {
+          emit(Op::Drop);
+        }
+        break;
+      case Expression::NopId:
+        break;
+      case Expression::ConstId: {
+        auto& value = curr->cast<Const>()->value;
+        emit(Op::Const, 0, InterpreterBytecode::fromLiteral(value));
+        break;
+      }
+      case Expression::LocalGetId:
+        emit(Op::LocalGet, curr->cast<LocalGet>()->index);
+        break;
+      case Expression::LocalSetId: {
+        auto* set = curr->cast<LocalSet>();
+        if (compileChildren(set)) {
+          emit(set->isTee() ? Op::LocalTee : Op::LocalSet, set->index);
+        }
+        break;
+      }
+      case Expression::SelectId:
+        if (compileChildren(curr)) {
+          emit(Op::Select);
+        }
+        break;
+      case Expression::CallId:
+        if (compileChildren(curr)) {
+          emitExpression(Op::Call, curr);
+          if (curr->cast<Call>()->isReturn) {
+            emitReturnCallReturn();
+          }
+        }
+        break;
+      case Expression::CallIndirectId:
+        if (curr->cast<CallIndirect>()->isReturn) {
+          compileReturnCallGeneric<CallIndirect>(curr);
+        } else {
+          compileGeneric(curr);
+        }
+        break;
+      case Expression::CallRefId:
+        if (curr->cast<CallRef>()->isReturn) {
+          compileReturnCallGeneric<CallRef>(curr);
+        } else {
+          compileGeneric(curr);
+        }
+        break;
+      case Expression::LoadId:
+        if (curr->cast<Load>()->isAtomic) {
+          compileGeneric(curr);
+        } else if (compileChildren(curr)) {
+          emitExpression(Op::Load, curr);
+        }
+        break;
+      case Expression::StoreId:
+        if (curr->cast<Store>()->isAtomic) {
+          compileGeneric(curr);
+        } else if (compileChildren(curr)) {
+          emitExpression(Op::Store, curr);
+        }
+        break;
+      case Expression::UnaryId:
+        if (auto op = getOp(curr->cast<Unary>()->op)) {
+          if (compileChildren(curr)) {
+            emit(*op);
+          }
+        } else {
+          compileGeneric(curr);
+        }
+        break;
+      case Expression::BinaryId:
+        if (auto op = getOp(curr->cast<Binary>()->op)) {
+          if (compileChildren(curr)) {
+            emit(*op);
+          }
+        } else {
+          compileGeneric(curr);
+        }
+        break;
+      case Expression::TryId:
+      case Expression::RethrowId:
+      case Expression::PopId:
+      case Expression::TupleMakeId:
+      case Expression::TupleExtractId:
+        // These depend on state in the tree walker's FunctionScope.
+        failed = true;
+        break;
+      default:
+        compileGeneric(curr);
+    }
+    depth--;
+    height = start + curr->type.isConcrete();
+    bytecode.maxHeight = std::max(bytecode.maxHeight, height);
+  }
+
+  void compileBlock(Block* curr) {
+    if (curr->name.is()) {
+      labels.emplace_back(curr->name, height, curr->type.isConcrete());
+    }
+    for (auto* child : curr->list) {
+      compile(child);
+    }
+    if (curr->name.is()) {
+      bindLabel();
+    }
+  }
+
+  void compileIf(If* curr, Index start) {
+    compile(curr->condition);
+    if (curr->condition->type == Type::unreachable) {
+      return;
+    }
+    height = start;
+    auto skipTrue = emit(Op::BrUnless);
+    compile(curr->ifTrue);
+    if (curr->ifFalse) {
+      // Jump over the false arm, which leaves the stack as it is.
+      auto skipFalse =
+        emit(Op::Br, 0, (uint64_t(start) << 1) | curr->type.isConcrete());
+      bytecode.code[skipTrue].a = bytecode.code.size();
+      height = start;
+      compile(curr->ifFalse);
+      bytecode.code[skipFalse].a = bytecode.code.size();
+    } else {
+      bytecode.code[skipTrue].a = bytecode.code.size();
+    }
+  }
+
+  void compileSwitch(Switch* curr) {
+    if (!compileChildren(curr)) {
+      return;
+    }
+    Index first = bytecode.targets.size();
+    auto addTarget = [&](Name name) {
+      auto& label = getLabel(name);
+      if (!label.pc) {
+        label.tableTargets.push_back(bytecode.targets.size());
+      }
+      bytecode.targets.push_back(
+        {label.pc ? *label.pc : 0, label.height, label.hasValue});
+    };
+    for (auto name : curr->targets) {
+      addTarget(name);
+    }
+    addTarget(curr->default_);
+    emit(Op::BrTable, first, curr->targets.size() + 1);
+  }
+
+  // Emits an expression that is executed by the tree walker, on a copy whose
+  // children are constants that are set to the operands at runtime.
+  void compileGeneric(Expression* curr) {
+    if (!compileChildren(curr) || failed) {
+      return;
+    }
+    Builder builder(scratch);
+    InterpreterBytecode::Generic generic;
+    generic.expr = ExpressionManipulator::flexibleCopy(
+      curr, scratch, [&](Expression* child) -> Expression* {
+        if (child == curr) {
+          return nullptr;
+        }
+        return builder.makeConst(Literal::makeZero(child->type));
+      });
+    for (auto* child : ChildIterator(generic.expr)) {
+      generic.operands.push_back(child->cast<Const>());
+    }
+    emit(Op::Generic, bytecode.generics.size());
+    bytecode.generics.push_back(std::move(generic));
+  }
+
+  // Return calls are run as a normal call followed by a return (which is not a
+  // proper tail call, like in the tree walker). That way the tree walker does
+  // not need to know the current function, which it would look up in its
+  // FunctionScope, which bytecode frames do not have.
+  template<typename T> void compileReturnCallGeneric(Expression* curr) {
+    auto index = bytecode.generics.size();
+    compileGeneric(curr);
+    if (bytecode.generics.size() == index) {
+      // The call is not reached.
+      return;
+    }
+    auto* call = bytecode.generics[index].expr->cast<T>();
+    call->isReturn = false;
+    call->type = results;
+    emitReturnCallReturn();
+  }
+
+  // Emits the return after the call of a return call, which pushed the results
+  // if there are any.
+  void emitReturnCallReturn() {
+    bytecode.maxHeight = std::max(bytecode.maxHeight, height + 1);
+    emit(Op::Return, results.isConcrete());
+  }
+};
+
+} // anonymous namespace
+
+std::unique_ptr<InterpreterBytecode>
+InterpreterBytecode::compile(Function* func, Module& scratch) {
+  if (func->imported() || func->getResults().isTuple()) {
+    return nullptr;
+  }
+  for (Index i = 0; i < func->getNumLocals(); i++) {
+    auto type = func->getLocalType(i);
+    if (!type.isConcrete() || !isSupported(type)) {
+      return nullptr;
+    }
+  }
+  auto bytecode = std::make_unique<InterpreterBytecode>();
+  bytecode->numLocals = func->getNumLocals();
+  BytecodeCompiler compiler(*bytecode, scratch, func->getResults());
+  compiler.compile(func->body);
+  if (compiler.failed) {
+    return nullptr;
+  }
+  // Return whatever the body leaves on the stack.
+  compiler.emit(Op::Return, func->body->type.isConcrete());
+  return bytecode;
+}
+
 } // namespace wasm
@@ -26,6 +26,7 @@
 
 #include "wasm-io.h"
 #include "support/debug.h"
+#include "support/file.h"
 #include "wasm-binary.h"
 #include "wasm-s-parser.h"
 #include "wat-parser.h"
@@ -57,22 +58,30 @@ void ModuleReader::readText(std::string filename, Module& wasm) {
   readTextData(input, wasm, profile);
 }
 
-void ModuleReader::readBinaryData(std::vector<char>& input,
+void ModuleReader::readBinaryData(std::unique_ptr<MappedFile> input,
                                   Module& wasm,
                                   std::string sourceMapFilename) {
   std::unique_ptr<std::ifstream> sourceMapStream;
   // Assume that the wasm has had its initial features applied, and use those
   // while parsing.
-  WasmBinaryBuilder parser(wasm, wasm.features, input);
-  parser.setDebugInfo(debugInfo);
-  parser.setDWARF(DWARF);
-  parser.setSkipFunctionBodies(skipFunctionBodies);
+  std::unique_ptr<WasmBinaryBuilder> ownParser;
+  WasmBinaryBuilder* parser;
+  if (lazyFunctionBodies) {
+    parser = &lazyFunctionBodies->createBuilder(wasm, std::move(input));
+  } else {
+    ownParser =
+      std::make_unique<WasmBinaryBuilder>(wasm, wasm.features, input->view());
+    parser = ownParser.get();
+    parser->setSkipFunctionBodies(skipFunctionBodies);
+  }
+  parser->setDebugInfo(debugInfo);
+  parser->setDWARF(DWARF);
   if (sourceMapFilename.size()) {
     sourceMapStream = make_unique<std::ifstream>();
     sourceMapStream->open(sourceMapFilename);
-    parser.setDebugLocations(sourceMapStream.get());
+    parser->setDebugLocations(sourceMapStream.get());
   }
-  parser.read();
+  parser->read();
   if (sourceMapStream) {
     sourceMapStream->close();
   }
@@ -82,8 +91,8 @@ void ModuleReader::readBinary(std::string filename,
                               Module& wasm,
                               std::string sourceMapFilename) {
   BYN_TRACE("reading binary from " << filename << "\n");
-  auto input(read_file<std::vector<char>>(filename, Flags::Binary));
-  readBinaryData(input, wasm, sourceMapFilename);
+  readBinaryData(
+    std::make_unique<MappedFile>(filename), wasm, sourceMapFilename);
 }
 
 bool ModuleReader::isBinaryFile(std::string filename) {
@@ -123,7 +132,8 @@ void ModuleReader::readStdin(Module& wasm, std::string sourceMapFilename) {
   std::vector<char> input = read_stdin();
   if (input.size() >= 4 && input[0] == '\0' && input[1] == 'a' &&
       input[2] == 's' && input[3] == 'm') {
-    readBinaryData(input, wasm, sourceMapFilename);
+    readBinaryData(
+      std::make_unique<MappedFile>(std::move(input)), wasm, sourceMapFilename);
   } else {
     std::ostringstream s;
     s.write(input.data(), input.size());
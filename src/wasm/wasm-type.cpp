@@ -734,7 +734,10 @@ bool HeapTypeInfo::operator==(const HeapTypeInfo& other) const {
 }
 
 template<typename Info> struct Store {
-  std::recursive_mutex mutex;
+  // Looking up a type we already have only takes a shared lock, so that threads
+  // that create the same types over and over do not serialize. Only creating a
+  // new type takes the lock exclusively.
+  std::shared_mutex mutex;
 
   // Track unique_ptrs for constructed types to avoid leaks.
   std::vector<std::unique_ptr<Info>> constructedTypes;
@@ -746,9 +749,15 @@ template<typename Info> struct Store {
   bool isGlobalStore();
 #endif
 
-  typename Info::type_t insert(const Info& info) { return doInsert(info); }
+  typename Info::type_t insert(const Info& info) {
+    return doInsert(info, true);
+  }
   typename Info::type_t insert(std::unique_ptr<Info>&& info) {
-    return doInsert(info);
+    return doInsert(info, true);
+  }
+  // Insert while the caller already holds the lock exclusively.
+  typename Info::type_t insertLocked(std::unique_ptr<Info>&& info) {
+    return doInsert(info, false);
   }
   bool hasCanonical(const Info& info, typename Info::type_t& canonical);
 
@@ -758,7 +767,8 @@ template<typename Info> struct Store {
   }
 
 private:
-  template<typename Ref> typename Info::type_t doInsert(Ref& infoRef) {
+  template<typename Ref>
+  typename Info::type_t doInsert(Ref& infoRef, bool lock) {
     const Info& info = [&]() {
       if constexpr (std::is_same_v<Ref, const Info>) {
         return infoRef;
@@ -790,17 +800,30 @@ private:
     if (auto canonical = info.getCanonical()) {
       return *canonical;
     }
-    std::lock_guard<std::recursive_mutex> lock(mutex);
     // Nominal HeapTypes are always unique, so don't bother deduplicating them.
+    bool dedupe = true;
     if constexpr (std::is_same_v<Info, HeapTypeInfo>) {
-      if (typeSystem == TypeSystem::Nominal) {
-        return insertNew();
-      }
+      dedupe = typeSystem != TypeSystem::Nominal;
     }
     // Check whether we already have a type for this structural Info.
-    auto indexIt = typeIDs.find(std::cref(info));
-    if (indexIt != typeIDs.end()) {
-      return typename Info::type_t(indexIt->second);
+    if (dedupe && lock) {
+      std::shared_lock<std::shared_mutex> readLock(mutex);
+      auto indexIt = typeIDs.find(std::cref(info));
+      if (indexIt != typeIDs.end()) {
+        return typename Info::type_t(indexIt->second);
+      }
+    }
+    std::unique_lock<std::shared_mutex> writeLock(mutex, std::defer_lock);
+    if (lock) {
+      writeLock.lock();
+    }
+    // Another thread may have created the type since we looked, so check
+    // again now that we have the lock.
+    if (dedupe) {
+      auto indexIt = typeIDs.find(std::cref(info));
+      if (indexIt != typeIDs.end()) {
+        return typename Info::type_t(indexIt->second);
+      }
     }
     // We do not have a type for this Info already. Create one.
     return insertNew();
@@ -840,10 +863,17 @@ template<typename Info> bool Store<Info>::isGlobalStore() {
 // `HeapType::HeapType(Signature)`.
 struct SignatureTypeCache {
   std::unordered_map<Signature, HeapType> cache;
-  std::mutex mutex;
+  std::shared_mutex mutex;
 
   HeapType getType(Signature sig) {
-    std::lock_guard<std::mutex> lock(mutex);
+    {
+      std::shared_lock<std::shared_mutex> lock(mutex);
+      auto it = cache.find(sig);
+      if (it != cache.end()) {
+        return it->second;
+      }
+    }
+    std::lock_guard<std::shared_mutex> lock(mutex);
     // Try inserting a placeholder type, then replace it with a real type if we
     // don't already have a canonical type for this signature.
     auto [entry, inserted] = cache.insert({sig, {}});
@@ -855,7 +885,7 @@ struct SignatureTypeCache {
   }
 
   void insertType(HeapType type) {
-    std::lock_guard<std::mutex> lock(mutex);
+    std::lock_guard<std::shared_mutex> lock(mutex);
     cache.insert({type.getSignature(), type});
   }
 
@@ -866,7 +896,9 @@ static SignatureTypeCache nominalSignatureCache;
 
 // Keep track of the constructed recursion groups.
 struct RecGroupStore {
-  std::mutex mutex;
+  // As with the type stores, looking up a group we already have only takes a
+  // shared lock.
+  std::shared_mutex mutex;
   // Store the structures of all rec groups created so far so we can avoid
   // creating duplicates.
   std::unordered_set<RecGroupStructure> canonicalGroups;
@@ -895,9 +927,17 @@ struct RecGroupStore {
 
   // Utility for canonicalizing HeapTypes with trivial recursion groups.
   HeapType insert(std::unique_ptr<HeapTypeInfo>&& info) {
-    std::lock_guard<std::mutex> lock(mutex);
     assert(!info->recGroup && "Unexpected nontrivial rec group");
     auto group = asHeapType(info).getRecGroup();
+    RecGroupStructure structure{group};
+    {
+      std::shared_lock<std::shared_mutex> lock(mutex);
+      auto it = canonicalGroups.find(structure);
+      if (it != canonicalGroups.end()) {
+        return it->group[0];
+      }
+    }
+    std::lock_guard<std::shared_mutex> lock(mutex);
     auto canonical = insert(group);
     if (group == canonical) {
       globalHeapTypeStore.insert(std::move(info));
@@ -3601,11 +3641,11 @@ void globallyCanonicalize(CanonicalizationState& state) {
   // same shape as one being canonicalized here. This cannot happen with Types
   // because they are hashed in the global store by pointer identity, which has
   // not yet escaped the builder, rather than shape.
-  std::lock_guard<std::recursive_mutex> lock(globalHeapTypeStore.mutex);
+  std::lock_guard<std::shared_mutex> lock(globalHeapTypeStore.mutex);
   std::unordered_map<HeapType, HeapType> canonicalHeapTypes;
   for (auto& info : state.newInfos) {
     HeapType original = asHeapType(info);
-    HeapType canonical = globalHeapTypeStore.insert(std::move(info));
+    HeapType canonical = globalHeapTypeStore.insertLocked(std::move(info));
     if (original != canonical) {
       canonicalHeapTypes[original] = canonical;
     }
@@ -3810,7 +3850,7 @@ std::optional<TypeBuilder::Error> canonicalizeIsorecursive(
   // replacements accordingly.
   CanonicalizationState::ReplacementMap replacements;
   {
-    std::lock_guard<std::mutex> lock(globalRecGroupStore.mutex);
+    std::lock_guard<std::shared_mutex> lock(globalRecGroupStore.mutex);
     groupStart = 0;
     for (auto group : groups) {
       size_t size = group.size();
@@ -15,12 +15,14 @@
  */
 
 #include <mutex>
+#include <numeric>
 #include <set>
 #include <sstream>
 #include <unordered_set>
 
 #include "ir/eh-utils.h"
 #include "ir/features.h"
+#include "ir/find_all.h"
 #include "ir/global-utils.h"
 #include "ir/intrinsics.h"
 #include "ir/local-graph.h"
@@ -28,6 +30,7 @@
 #include "ir/stack-utils.h"
 #include "ir/utils.h"
 #include "support/colors.h"
+#include "support/threads.h"
 #include "wasm-validator.h"
 #include "wasm.h"
 
@@ -217,9 +220,6 @@ struct FunctionValidator : public WalkerPass<PostWalker<FunctionValidator>> {
     setModule(&wasm);
   }
 
-  // Validate the entire module.
-  void validate(PassRunner* runner) { run(runner, getModule()); }
-
   // Validate a specific expression.
   void validate(Expression* curr) { walk(curr); }
 
@@ -2755,11 +2755,8 @@ void FunctionValidator::visitFunction(Function* curr) {
 
   if (getModule()->features.hasGCNNLocals()) {
     // If we have non-nullable locals, verify that no local.get can read a null
-    // default value.
-    // TODO: this can be fairly slow due to the LocalGraph. writing more code to
-    //       do a more specific analysis (we don't need to know all sets, just
-    //       if there is a set of a null default value that is read) could be a
-    //       lot faster.
+    // default value. Only the gets of non-nullable vars matter, so we compute
+    // the sets of those lazily.
     bool hasNNLocals = false;
     for (const auto& var : curr->vars) {
       if (var.isNonNullable()) {
@@ -2768,8 +2765,11 @@ void FunctionValidator::visitFunction(Function* curr) {
       }
     }
     if (hasNNLocals) {
-      LocalGraph graph(curr);
-      for (auto& [get, sets] : graph.getSetses) {
+      LazyLocalGraph graph(curr);
+      // Visit the gets in the order they appear in the function, rather than
+      // in the order of the graph's locations, so that errors are reported in
+      // a deterministic order.
+      for (auto* get : FindAll<LocalGet>(curr->body).list) {
         auto index = get->index;
         // It is always ok to read nullable locals, and it is always ok to read
         // params even if they are non-nullable.
@@ -2777,7 +2777,7 @@ void FunctionValidator::visitFunction(Function* curr) {
             curr->isParam(index)) {
           continue;
         }
-        for (auto* set : sets) {
+        for (auto* set : graph.getSets(get)) {
           shouldBeTrue(!!set, index, "non-nullable local must not read null");
         }
       }
@@ -2854,53 +2854,107 @@ void FunctionValidator::validateAlignment(
   }
 }
 
-static void validateBinaryenIR(Module& wasm, ValidationInfo& info) {
-  struct BinaryenIRValidator
-    : public PostWalker<BinaryenIRValidator,
-                        UnifiedExpressionVisitor<BinaryenIRValidator>> {
-    ValidationInfo& info;
-
-    std::unordered_set<Expression*> seen;
-
-    BinaryenIRValidator(ValidationInfo& info) : info(info) {}
-
-    void visitExpression(Expression* curr) {
-      auto scope = getFunction() ? getFunction()->name : Name("(global scope)");
-      // check if a node type is 'stale', i.e., we forgot to finalize() the
-      // node.
-      auto oldType = curr->type;
-      ReFinalizeNode().visit(curr);
-      auto newType = curr->type;
-      if (newType != oldType) {
-        // We accept concrete => undefined,
-        // e.g.
-        //
-        //  (drop (block (result i32) (unreachable)))
-        //
-        // The block has an added type, not derived from the ast itself, so it
-        // is ok for it to be either i32 or unreachable.
-        if (!Type::isSubType(newType, oldType) &&
-            !(oldType.isConcrete() && newType == Type::unreachable)) {
-          std::ostringstream ss;
-          ss << "stale type found in " << scope << " on " << curr
-             << "\n(marked as " << oldType << ", should be " << newType
-             << ")\n";
-          info.fail(ss.str(), curr, getFunction());
-        }
-        curr->type = oldType;
-      }
-      // check if a node is a duplicate - expressions must not be seen more than
-      // once
-      if (!seen.insert(curr).second) {
+// Checks internal IR details, which we do in pass-debug mode: that types are
+// not stale, and that no expression appears more than once in the IR. The
+// latter is checked for all the code at once, after the other checks have run
+// on each function (and on the module-level code) in parallel, which note the
+// expressions they saw.
+struct BinaryenIRValidator
+  : public PostWalker<BinaryenIRValidator,
+                      UnifiedExpressionVisitor<BinaryenIRValidator>> {
+  ValidationInfo& info;
+
+  // The expressions we saw, in the order we saw them.
+  std::vector<Expression*>& seen;
+
+  BinaryenIRValidator(ValidationInfo& info, std::vector<Expression*>& seen)
+    : info(info), seen(seen) {}
+
+  void visitExpression(Expression* curr) {
+    auto scope = getFunction() ? getFunction()->name : Name("(global scope)");
+    // check if a node type is 'stale', i.e., we forgot to finalize() the
+    // node.
+    auto oldType = curr->type;
+    ReFinalizeNode().visit(curr);
+    auto newType = curr->type;
+    if (newType != oldType) {
+      // We accept concrete => undefined,
+      // e.g.
+      //
+      //  (drop (block (result i32) (unreachable)))
+      //
+      // The block has an added type, not derived from the ast itself, so it
+      // is ok for it to be either i32 or unreachable.
+      if (!Type::isSubType(newType, oldType) &&
+          !(oldType.isConcrete() && newType == Type::unreachable)) {
         std::ostringstream ss;
-        ss << "expression seen more than once in the tree in " << scope
-           << " on " << curr << '\n';
+        ss << "stale type found in " << scope << " on " << curr
+           << "\n(marked as " << oldType << ", should be " << newType
+           << ")\n";
         info.fail(ss.str(), curr, getFunction());
       }
+      curr->type = oldType;
+    }
+    seen.push_back(curr);
+  }
+
+  void walkModuleCode(Module* module) {
+    PostWalker<BinaryenIRValidator,
+               UnifiedExpressionVisitor<BinaryenIRValidator>>::
+      walkModuleCode(module);
+    for (auto& segment : module->dataSegments) {
+      if (!segment->isPassive) {
+        walk(segment->offset);
+      }
     }
+  }
+};
+
+// Checks that no expression appears more than once, given the expressions that
+// were seen in each function (or in module-level code, for a null function).
+// To do so in parallel, each worker handles a shard of the expressions, picked
+// by their addresses, and looks for them everywhere.
+static void validateUniqueExpressions(
+  std::vector<std::pair<Function*, std::vector<Expression*>>>& seen,
+  ValidationInfo& info) {
+  size_t numShards = ThreadPool::get()->size();
+  auto getShard = [&](Expression* curr) {
+    // Expressions are aligned, so ignore the low bits.
+    return (size_t(curr) >> 4) % numShards;
   };
-  BinaryenIRValidator binaryenIRValidator(info);
-  binaryenIRValidator.walkModule(&wasm);
+  // The duplicates found in each shard, as a place in |seen| and an index in
+  // its expressions.
+  std::vector<std::vector<std::pair<size_t, size_t>>> duplicates(numShards);
+  std::vector<size_t> shards(numShards);
+  std::iota(shards.begin(), shards.end(), 0);
+  WorkStealingQueues::run(shards, [&](size_t, size_t shard) {
+    std::unordered_set<Expression*> shardSeen;
+    for (size_t place = 0; place < seen.size(); place++) {
+      auto& exprs = seen[place].second;
+      for (size_t i = 0; i < exprs.size(); i++) {
+        if (getShard(exprs[i]) == shard && !shardSeen.insert(exprs[i]).second) {
+          duplicates[shard].emplace_back(place, i);
+        }
+      }
+    }
+  });
+  // Report in a deterministic order, the same as if we had looked through the
+  // places one by one.
+  std::vector<std::pair<size_t, size_t>> allDuplicates;
+  for (auto& shardDuplicates : duplicates) {
+    allDuplicates.insert(
+      allDuplicates.end(), shardDuplicates.begin(), shardDuplicates.end());
+  }
+  std::sort(allDuplicates.begin(), allDuplicates.end());
+  for (auto [place, i] : allDuplicates) {
+    auto* func = seen[place].first;
+    auto* curr = seen[place].second[i];
+    auto scope = func ? func->name : Name("(global scope)");
+    std::ostringstream ss;
+    ss << "expression seen more than once in the tree in " << scope << " on "
+       << curr << '\n';
+    info.fail(ss.str(), curr, func);
+  }
 }
 
 // Main validator class
@@ -3288,32 +3342,81 @@ static void validateFeatures(Module& module, ValidationInfo& info) {
   }
 }
 
+// Validates the given functions, or if there are none, the entire module.
+//
 // TODO: If we want the validator to be part of libwasm rather than libpasses,
 // then Using PassRunner::getPassDebug causes a circular dependence. We should
 // fix that, perhaps by moving some of the pass infrastructure into libsupport.
-bool WasmValidator::validate(Module& module, Flags flags) {
+static bool validateModuleOrFunctions(Module& module,
+                                      const std::vector<Function*>* functions,
+                                      WasmValidator::Flags flags) {
   ValidationInfo info(module);
-  info.validateWeb = (flags & Web) != 0;
-  info.validateGlobally = (flags & Globally) != 0;
-  info.quiet = (flags & Quiet) != 0;
-  // parallel wasm logic validation
-  PassRunner runner(&module);
-  FunctionValidator(module, &info).validate(&runner);
-  // validate globally
-  if (info.validateGlobally) {
-    validateImports(module, info);
-    validateExports(module, info);
-    validateGlobals(module, info);
-    validateMemory(module, info);
-    validateTables(module, info);
-    validateTags(module, info);
-    validateModule(module, info);
-    validateFeatures(module, info);
-  }
+  info.validateWeb = (flags & WasmValidator::Web) != 0;
+  info.validateGlobally = (flags & WasmValidator::Globally) != 0;
+  info.quiet = (flags & WasmValidator::Quiet) != 0;
   // validate additional internal IR details when in pass-debug mode
-  if (PassRunner::getPassDebug()) {
-    validateBinaryenIR(module, info);
+  bool validateIR = PassRunner::getPassDebug();
+
+  std::vector<Function*> toValidate;
+  if (functions) {
+    toValidate = *functions;
+  } else {
+    ModuleUtils::iterDefinedFunctions(
+      module, [&](Function* func) { toValidate.push_back(func); });
+  }
+
+  // Each function is validated in parallel, and in parallel to them, so are
+  // the module-level things, which form an additional item of work after the
+  // functions. The module-level things report errors with no function, so
+  // errors are never reported concurrently to the same stream.
+  std::vector<size_t> items;
+  if (!functions) {
+    // Start on the module-level things, as they may be large.
+    items.push_back(toValidate.size());
+  }
+  for (size_t i = 0; i < toValidate.size(); i++) {
+    items.push_back(i);
+  }
+  // The expressions seen in each function, and in module-level code, for the
+  // IR validation.
+  std::vector<std::pair<Function*, std::vector<Expression*>>> seen;
+  if (validateIR) {
+    if (!functions) {
+      seen.emplace_back(nullptr, std::vector<Expression*>());
+    }
+    for (auto* func : toValidate) {
+      seen.emplace_back(func, std::vector<Expression*>());
+    }
+  }
+  WorkStealingQueues::run(items, [&](size_t, size_t item) {
+    size_t seenIndex = functions ? item : item + 1;
+    if (item < toValidate.size()) {
+      auto* func = toValidate[item];
+      FunctionValidator(module, &info).walkFunctionInModule(func, &module);
+      if (validateIR) {
+        BinaryenIRValidator(info, seen[seenIndex].second)
+          .walkFunctionInModule(func, &module);
+      }
+      return;
+    }
+    if (info.validateGlobally) {
+      validateImports(module, info);
+      validateExports(module, info);
+      validateGlobals(module, info);
+      validateMemory(module, info);
+      validateTables(module, info);
+      validateTags(module, info);
+      validateModule(module, info);
+      validateFeatures(module, info);
+    }
+    if (validateIR) {
+      BinaryenIRValidator(info, seen[0].second).walkModuleCode(&module);
+    }
+  });
+  if (validateIR) {
+    validateUniqueExpressions(seen, info);
   }
+
   // print all the data
   if (!info.valid.load() && !info.quiet) {
     for (auto& func : module.functions) {
@@ -3324,4 +3427,14 @@ bool WasmValidator::validate(Module& module, Flags flags) {
   return info.valid.load();
 }
 
+bool WasmValidator::validate(Module& module, Flags flags) {
+  return validateModuleOrFunctions(module, nullptr, flags);
+}
+
+bool WasmValidator::validate(Module& module,
+                             const std::vector<Function*>& functions,
+                             Flags flags) {
+  return validateModuleOrFunctions(module, &functions, flags);
+}
+
 } // namespace wasm
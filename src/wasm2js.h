@@ -44,6 +44,7 @@
 #include "passes/passes.h"
 #include "support/base64.h"
 #include "support/file.h"
+#include "support/threads.h"
 #include "wasm-builder.h"
 #include "wasm-io.h"
 #include "wasm-validator.h"
@@ -176,30 +177,73 @@ public:
     }
   }
 
+  // The state of the translation of a single function. Each function has its
+  // own, so that functions can be translated in parallel.
+  struct FunctionState {
+    Function* func;
+
+    // How many temp vars we need
+    std::vector<size_t> temps; // type => num temps
+    // Which are currently free to use
+    std::vector<std::vector<IString>> frees; // type => list of free names
+
+    // Mangled names in the scopes that belong to the function, that is, the
+    // Local and Label scopes (see fromName).
+    std::unordered_map<const void*, IString>
+      wasmNameToMangledName[(int)NameScope::Max];
+    std::unordered_set<IString> mangledNames[(int)NameScope::Max];
+
+    // The helper imports that the code uses. We add them to the module only
+    // after the translation, so that functions translated in parallel do not
+    // modify the module at the same time, and so that they are added in the
+    // same order as when translating sequentially.
+    std::vector<IString> helpers;
+
+    FunctionState(Function* func) : func(func) {
+      auto size = std::max(Type::i32, std::max(Type::f32, Type::f64)) + 1;
+      temps.resize(size);
+      frees.resize(size);
+    }
+  };
+
   Ref processWasm(Module* wasm, Name funcName = ASM_FUNC);
   Ref processFunction(Module* wasm, Function* func, bool standalone = false);
   Ref processStandaloneFunction(Module* wasm, Function* func) {
     return processFunction(wasm, func, true);
   }
 
+  // Translate a function, without modifying the module. This is safe to call
+  // in parallel on different functions, after the module-level names have
+  // been set up by processWasm. addHelpers() must then be called on the state.
+  Ref translateFunction(Module* m, FunctionState& state, bool standalone);
+
+  // Add the helper imports that a translated function uses.
+  void addHelpers(Module* m, FunctionState& state) {
+    for (auto helper : state.helpers) {
+      ABI::wasm2js::ensureHelpers(m, helper);
+    }
+  }
+
   // The second pass on an expression: process it fully, generating
   // JS
-  Ref processFunctionBody(Module* m, Function* func, bool standalone);
+  Ref processFunctionBody(Module* m, FunctionState& state, bool standalone);
 
   // Get a temp var.
-  IString getTemp(Type type, Function* func) {
+  IString getTemp(Type type, FunctionState& state) {
     IString ret;
     TODO_SINGLE_COMPOUND(type);
+    auto& frees = state.frees;
     if (frees[type.getBasic()].size() > 0) {
       ret = frees[type.getBasic()].back();
       frees[type.getBasic()].pop_back();
     } else {
-      size_t index = temps[type.getBasic()]++;
+      size_t index = state.temps[type.getBasic()]++;
       ret = IString((std::string("wasm2js_") + type.toString() + "$" +
                      std::to_string(index))
                       .c_str(),
                     false);
     }
+    auto* func = state.func;
     if (func->localIndices.find(ret) == func->localIndices.end()) {
       Builder::addVar(func, ret, type);
     }
@@ -207,9 +251,9 @@ public:
   }
 
   // Free a temp var.
-  void freeTemp(Type type, IString temp) {
+  void freeTemp(Type type, IString temp, FunctionState& state) {
     TODO_SINGLE_COMPOUND(type);
-    frees[type.getBasic()].push_back(temp);
+    state.frees[type.getBasic()].push_back(temp);
   }
 
   // Generates a mangled name from `name` within the specified scope.
@@ -222,18 +266,28 @@ public:
   // within a `scope`. Or in other words, the same `name` and `scope` pair will
   // always return the same result. If `scope` changes, however, the return
   // value may differ even if the same `name` is passed in.
-  IString fromName(Name name, NameScope scope) {
+  //
+  // The Local and Label scopes are per function, and use the given function
+  // state. The other scopes are for the entire module; their names must all
+  // have been created before functions are translated in parallel, so that the
+  // translation only reads them.
+  IString fromName(Name name, NameScope scope, FunctionState* state = nullptr) {
     // TODO: checking names do not collide after mangling
 
+    bool local = scope == NameScope::Local || scope == NameScope::Label;
+    assert(local == !!state);
+    auto* scopes = local ? state->wasmNameToMangledName : wasmNameToMangledName;
+
     // First up check our cached of mangled names to avoid doing extra work
     // below
-    auto& map = wasmNameToMangledName[(int)scope];
+    auto& map = scopes[(int)scope];
     auto it = map.find(name.c_str());
     if (it != map.end()) {
       return it->second;
     }
     // The mangled names in our scope.
-    auto& scopeMangledNames = mangledNames[(int)scope];
+    auto& scopeMangledNames =
+      (local ? state->mangledNames : mangledNames)[(int)scope];
     // In some cases (see below) we need to also check the Top scope.
     auto& topMangledNames = mangledNames[int(NameScope::Top)];
 
@@ -283,11 +337,6 @@ private:
   Flags flags;
   PassOptions options;
 
-  // How many temp vars we need
-  std::vector<size_t> temps; // type => num temps
-  // Which are currently free to use
-  std::vector<std::vector<IString>> frees; // type => list of free names
-
   // Mangled names cache by interned names.
   // Utilizes the usually reused underlying cstring's pointer as the key.
   std::unordered_map<const void*, IString>
@@ -493,10 +542,21 @@ Ref Wasm2JSBuilder::processWasm(Module* wasm, Name funcName) {
     asmFunc[3]->push_back(
       ValueBuilder::makeName("// EMSCRIPTEN_START_FUNCS\n"));
   }
-  // functions
+  // functions, which we translate in parallel and then append in order
+  std::vector<std::unique_ptr<FunctionState>> states;
   ModuleUtils::iterDefinedFunctions(*wasm, [&](Function* func) {
-    asmFunc[3]->push_back(processFunction(wasm, func));
+    states.push_back(std::make_unique<FunctionState>(func));
+  });
+  std::vector<Ref> functions(states.size());
+  std::vector<size_t> items(states.size());
+  std::iota(items.begin(), items.end(), 0);
+  WorkStealingQueues::run(items, [&](size_t, size_t i) {
+    functions[i] = translateFunction(wasm, *states[i], false);
   });
+  for (size_t i = 0; i < states.size(); i++) {
+    addHelpers(wasm, *states[i]);
+    asmFunc[3]->push_back(functions[i]);
+  }
   if (generateFetchHighBits) {
     Builder builder(*wasm);
     asmFunc[3]->push_back(
@@ -856,6 +916,16 @@ void Wasm2JSBuilder::addGlobal(Ref ast, Global* global) {
 Ref Wasm2JSBuilder::processFunction(Module* m,
                                     Function* func,
                                     bool standaloneFunction) {
+  FunctionState state(func);
+  Ref ret = translateFunction(m, state, standaloneFunction);
+  addHelpers(m, state);
+  return ret;
+}
+
+Ref Wasm2JSBuilder::translateFunction(Module* m,
+                                      FunctionState& state,
+                                      bool standaloneFunction) {
+  auto* func = state.func;
   if (standaloneFunction) {
     // We are only printing a function, not a whole module. Prepare it for
     // translation now (if there were a module, we'd have done this for all
@@ -875,16 +945,12 @@ Ref Wasm2JSBuilder::processFunction(Module* m,
   // sure that everything has a name and it's unique.
   Names::ensureNames(func);
   Ref ret = ValueBuilder::makeFunction(fromName(func->name, NameScope::Top));
-  frees.clear();
-  frees.resize(std::max(Type::i32, std::max(Type::f32, Type::f64)) + 1);
-  temps.clear();
-  temps.resize(std::max(Type::i32, std::max(Type::f32, Type::f64)) + 1);
-  temps[Type::i32] = temps[Type::f32] = temps[Type::f64] = 0;
   // arguments
   bool needCoercions = options.optimizeLevel == 0 || standaloneFunction ||
                        functionsCallableFromOutside.count(func->name);
   for (Index i = 0; i < func->getNumParams(); i++) {
-    IString name = fromName(func->getLocalNameOrGeneric(i), NameScope::Local);
+    IString name =
+      fromName(func->getLocalNameOrGeneric(i), NameScope::Local, &state);
     ValueBuilder::appendArgumentToFunction(ret, name);
     if (needCoercions) {
       ret[3]->push_back(ValueBuilder::makeStatement(ValueBuilder::makeBinary(
@@ -898,26 +964,26 @@ Ref Wasm2JSBuilder::processFunction(Module* m,
   size_t theVarIndex = ret[3]->size();
   ret[3]->push_back(theVar);
   // body
-  flattenAppend(ret, processFunctionBody(m, func, standaloneFunction));
+  flattenAppend(ret, processFunctionBody(m, state, standaloneFunction));
   // vars, including new temp vars
   for (Index i = func->getVarIndexBase(); i < func->getNumLocals(); i++) {
     ValueBuilder::appendToVar(
       theVar,
-      fromName(func->getLocalNameOrGeneric(i), NameScope::Local),
+      fromName(func->getLocalNameOrGeneric(i), NameScope::Local, &state),
       makeJsCoercedZero(wasmToJsType(func->getLocalType(i))));
   }
   if (theVar[1]->size() == 0) {
     ret[3]->splice(theVarIndex, 1);
   }
   // checks: all temp vars should be free at the end
-  assert(frees[Type::i32].size() == temps[Type::i32]);
-  assert(frees[Type::f32].size() == temps[Type::f32]);
-  assert(frees[Type::f64].size() == temps[Type::f64]);
+  assert(state.frees[Type::i32].size() == state.temps[Type::i32]);
+  assert(state.frees[Type::f32].size() == state.temps[Type::f32]);
+  assert(state.frees[Type::f64].size() == state.temps[Type::f64]);
   return ret;
 }
 
 Ref Wasm2JSBuilder::processFunctionBody(Module* m,
-                                        Function* func,
+                                        FunctionState& state,
                                         bool standaloneFunction) {
   // Switches are tricky to handle - in wasm they often come with
   // massively-nested "towers" of blocks, which if naively translated
@@ -1043,6 +1109,7 @@ Ref Wasm2JSBuilder::processFunctionBody(Module* m,
     : public OverriddenVisitor<ExpressionProcessor, Ref> {
     Wasm2JSBuilder* parent;
     IString result; // TODO: remove
+    FunctionState& state;
     Function* func;
     Module* module;
     bool standaloneFunction;
@@ -1051,9 +1118,9 @@ Ref Wasm2JSBuilder::processFunctionBody(Module* m,
 
     ExpressionProcessor(Wasm2JSBuilder* parent,
                         Module* m,
-                        Function* func,
+                        FunctionState& state,
                         bool standaloneFunction)
-      : parent(parent), func(func), module(m),
+      : parent(parent), state(state), func(state.func), module(m),
         standaloneFunction(standaloneFunction) {}
 
     Ref process() {
@@ -1064,6 +1131,7 @@ Ref Wasm2JSBuilder::processFunctionBody(Module* m,
     // A scoped temporary variable.
     struct ScopedTemp {
       Wasm2JSBuilder* parent;
+      FunctionState& state;
       Type type;
       IString temp; // TODO: switch to indexes; avoid names
       bool needFree;
@@ -1073,12 +1141,12 @@ Ref Wasm2JSBuilder::processFunctionBody(Module* m,
       //                 anyhow.
       ScopedTemp(Type type,
                  Wasm2JSBuilder* parent,
-                 Function* func,
+                 FunctionState& state,
                  IString possible = NO_RESULT)
-        : parent(parent), type(type) {
+        : parent(parent), state(state), type(type) {
         assert(possible != EXPRESSION_RESULT);
         if (possible == NO_RESULT) {
-          temp = parent->getTemp(type, func);
+          temp = parent->getTemp(type, state);
           needFree = true;
         } else {
           temp = possible;
@@ -1087,7 +1155,7 @@ Ref Wasm2JSBuilder::processFunctionBody(Module* m,
       }
       ~ScopedTemp() {
         if (needFree) {
-          parent->freeTemp(type, temp);
+          parent->freeTemp(type, temp, state);
         }
       }
 
@@ -1138,9 +1206,13 @@ Ref Wasm2JSBuilder::processFunctionBody(Module* m,
     std::unordered_set<Name> continueLabels;
 
     IString fromName(Name name, NameScope scope) {
-      return parent->fromName(name, scope);
+      bool local = scope == NameScope::Local || scope == NameScope::Label;
+      return parent->fromName(name, scope, local ? &state : nullptr);
     }
 
+    // Note that we use a helper import.
+    void ensureHelper(IString helper) { state.helpers.push_back(helper); }
+
     // Visitors
 
     Ref visitBlock(Block* curr) {
@@ -1342,10 +1414,10 @@ Ref Wasm2JSBuilder::processFunctionBody(Module* m,
       target = makeJsCoercion(target, JS_INT);
       if (mustReorder) {
         Ref ret;
-        ScopedTemp idx(Type::i32, parent, func);
+        ScopedTemp idx(Type::i32, parent, state);
         std::vector<ScopedTemp*> temps; // TODO: utility class, with destructor?
         for (auto* operand : curr->operands) {
-          temps.push_back(new ScopedTemp(operand->type, parent, func));
+          temps.push_back(new ScopedTemp(operand->type, parent, state));
           IString temp = temps.back()->temp;
           sequenceAppend(ret, visitAndAssign(operand, temp));
         }
@@ -1491,9 +1563,9 @@ Ref Wasm2JSBuilder::processFunctionBody(Module* m,
             !FindAll<MemoryGrow>(curr->ptr).list.empty() ||
             !FindAll<MemoryGrow>(curr->value).list.empty()) {
           Ref ret;
-          ScopedTemp ptr(Type::i32, parent, func);
+          ScopedTemp ptr(Type::i32, parent, state);
           sequenceAppend(ret, visitAndAssign(curr->ptr, ptr));
-          ScopedTemp value(curr->value->type, parent, func);
+          ScopedTemp value(curr->value->type, parent, state);
           sequenceAppend(ret, visitAndAssign(curr->value, value));
           LocalGet getPtr;
           getPtr.index = func->getLocalIndex(ptr.getName());
@@ -1620,10 +1692,8 @@ Ref Wasm2JSBuilder::processFunctionBody(Module* m,
                 L_NOT, visit(curr->value, EXPRESSION_RESULT));
             }
             case ReinterpretFloat32: {
-              ABI::wasm2js::ensureHelpers(module,
-                                          ABI::wasm2js::SCRATCH_STORE_F32);
-              ABI::wasm2js::ensureHelpers(module,
-                                          ABI::wasm2js::SCRATCH_LOAD_I32);
+              ensureHelper(ABI::wasm2js::SCRATCH_STORE_F32);
+              ensureHelper(ABI::wasm2js::SCRATCH_LOAD_I32);
 
               Ref store =
                 ValueBuilder::makeCall(ABI::wasm2js::SCRATCH_STORE_F32,
@@ -1719,10 +1789,8 @@ Ref Wasm2JSBuilder::processFunctionBody(Module* m,
               return makeJsCoercion(visit(curr->value, EXPRESSION_RESULT),
                                     JS_FLOAT);
             case ReinterpretInt32: {
-              ABI::wasm2js::ensureHelpers(module,
-                                          ABI::wasm2js::SCRATCH_STORE_I32);
-              ABI::wasm2js::ensureHelpers(module,
-                                          ABI::wasm2js::SCRATCH_LOAD_F32);
+              ensureHelper(ABI::wasm2js::SCRATCH_STORE_I32);
+              ensureHelper(ABI::wasm2js::SCRATCH_LOAD_F32);
 
               // 32-bit scratch memory uses index 2, so that it does not
               // conflict with indexes 0, 1 which are used for 64-bit, see
@@ -1962,9 +2030,9 @@ Ref Wasm2JSBuilder::processFunctionBody(Module* m,
         useLocals = true;
       }
       if (useLocals) {
-        ScopedTemp tempIfTrue(curr->type, parent, func),
-          tempIfFalse(curr->type, parent, func),
-          tempCondition(Type::i32, parent, func);
+        ScopedTemp tempIfTrue(curr->type, parent, state),
+          tempIfFalse(curr->type, parent, state),
+          tempCondition(Type::i32, parent, state);
         Ref ifTrue = visit(curr->ifTrue, EXPRESSION_RESULT);
         Ref ifFalse = visit(curr->ifFalse, EXPRESSION_RESULT);
         Ref condition = visit(curr->condition, EXPRESSION_RESULT);
@@ -2153,7 +2221,7 @@ Ref Wasm2JSBuilder::processFunctionBody(Module* m,
       WASM_UNREACHABLE("unimp");
     }
     Ref visitMemoryInit(MemoryInit* curr) {
-      ABI::wasm2js::ensureHelpers(module, ABI::wasm2js::MEMORY_INIT);
+      ensureHelper(ABI::wasm2js::MEMORY_INIT);
       return ValueBuilder::makeCall(ABI::wasm2js::MEMORY_INIT,
                                     ValueBuilder::makeNum(curr->segment),
                                     visit(curr->dest, EXPRESSION_RESULT),
@@ -2161,19 +2229,19 @@ Ref Wasm2JSBuilder::processFunctionBody(Module* m,
                                     visit(curr->size, EXPRESSION_RESULT));
     }
     Ref visitDataDrop(DataDrop* curr) {
-      ABI::wasm2js::ensureHelpers(module, ABI::wasm2js::DATA_DROP);
+      ensureHelper(ABI::wasm2js::DATA_DROP);
       return ValueBuilder::makeCall(ABI::wasm2js::DATA_DROP,
                                     ValueBuilder::makeNum(curr->segment));
     }
     Ref visitMemoryCopy(MemoryCopy* curr) {
-      ABI::wasm2js::ensureHelpers(module, ABI::wasm2js::MEMORY_COPY);
+      ensureHelper(ABI::wasm2js::MEMORY_COPY);
       return ValueBuilder::makeCall(ABI::wasm2js::MEMORY_COPY,
                                     visit(curr->dest, EXPRESSION_RESULT),
                                     visit(curr->source, EXPRESSION_RESULT),
                                     visit(curr->size, EXPRESSION_RESULT));
     }
     Ref visitMemoryFill(MemoryFill* curr) {
-      ABI::wasm2js::ensureHelpers(module, ABI::wasm2js::MEMORY_FILL);
+      ensureHelper(ABI::wasm2js::MEMORY_FILL);
       return ValueBuilder::makeCall(ABI::wasm2js::MEMORY_FILL,
                                     visit(curr->dest, EXPRESSION_RESULT),
                                     visit(curr->value, EXPRESSION_RESULT),
@@ -2376,7 +2444,7 @@ Ref Wasm2JSBuilder::processFunctionBody(Module* m,
     }
   };
 
-  return ExpressionProcessor(this, m, func, standaloneFunction).process();
+  return ExpressionProcessor(this, m, state, standaloneFunction).process();
 }
 
 void Wasm2JSBuilder::addMemoryFuncs(Ref ast, Module* wasm) {
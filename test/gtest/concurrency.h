@@ -0,0 +1,25 @@
+#include <functional>
+#include <thread>
+#include <vector>
+
+#ifndef wasm_test_gtest_concurrency_h
+#define wasm_test_gtest_concurrency_h
+
+// The number of threads that tests of concurrent operations use. This is fixed
+// rather than depending on the machine, so that the tests cost the same
+// everywhere, and it is enough for the threads to race with each other.
+constexpr size_t NumTestThreads = 4;
+
+// Runs work(t) for each t in [0, NumTestThreads) on a thread of its own, all at
+// once, and waits for them to finish.
+inline void runOnTestThreads(std::function<void(size_t)> work) {
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < NumTestThreads; t++) {
+    threads.emplace_back(work, t);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+#endif // wasm_test_gtest_concurrency_h
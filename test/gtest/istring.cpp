@@ -0,0 +1,74 @@
+/*
+ * Copyright 2022 WebAssembly Community Group participants
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+
+#include "concurrency.h"
+#include "emscripten-optimizer/istring.h"
+#include "gtest/gtest.h"
+
+using cashew::IString;
+
+TEST(IStringTest, Interning) {
+  std::string foo = "istring-test-foo";
+  IString a(foo.c_str(), false);
+  // The string was copied, so changing our buffer does not affect it.
+  foo[0] = 'X';
+  IString b("istring-test-foo");
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(a.str, b.str);
+  EXPECT_STREQ(a.str, "istring-test-foo");
+  EXPECT_NE(a, IString("istring-test-bar"));
+
+  // Large strings are stored separately from small ones.
+  std::string large(100000, 'x');
+  IString c(large.c_str(), false);
+  EXPECT_EQ(c.size(), large.size());
+  EXPECT_EQ(c, IString(large.c_str(), false));
+}
+
+// Intern the same strings from several threads at once, checking that they
+// all agree on the results.
+TEST(IStringTest, ConcurrentInterning) {
+  constexpr size_t numStrings = 20000;
+  constexpr size_t rounds = 10;
+
+  std::vector<std::vector<const char*>> results(NumTestThreads);
+  runOnTestThreads([&](size_t t) {
+    auto& result = results[t];
+    for (size_t round = 0; round < rounds; round++) {
+      result.clear();
+      for (size_t i = 0; i < numStrings; i++) {
+        // Mix strings that all threads share with ones only this thread uses,
+        // like the labels of a function-parallel pass do.
+        auto prefix = i % 2 ? std::string("concurrent-")
+                            : "thread-" + std::to_string(t) + "-";
+        auto s = prefix + std::to_string(i);
+        result.push_back(IString(s.c_str(), false).str);
+      }
+    }
+  });
+
+  for (size_t t = 1; t < NumTestThreads; t++) {
+    for (size_t i = 1; i < numStrings; i += 2) {
+      ASSERT_EQ(results[t][i], results[0][i]);
+    }
+    for (size_t i = 0; i < numStrings; i += 2) {
+      ASSERT_NE(results[t][i], results[0][i]);
+    }
+  }
+}
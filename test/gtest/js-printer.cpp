@@ -0,0 +1,44 @@
+#include <sstream>
+#include <string>
+
+#include "emscripten-optimizer/simple_ast.h"
+#include "gtest/gtest.h"
+
+using namespace cashew;
+
+// Builds a function containing many small functions, like the asmFunc that
+// wasm2js emits.
+static Ref makeNestedFunctions(size_t num) {
+  Ref ast = ValueBuilder::makeToplevel();
+  Ref outer = ValueBuilder::makeFunction("outer");
+  ast[1]->push_back(outer);
+  for (size_t i = 0; i < num; i++) {
+    auto name = "inner" + std::to_string(i);
+    Ref inner = ValueBuilder::makeFunction(IString(name.c_str(), false));
+    ValueBuilder::appendArgumentToFunction(inner, "x");
+    inner[3]->push_back(ValueBuilder::makeReturn(ValueBuilder::makeBinary(
+      ValueBuilder::makeName("x"), PLUS, ValueBuilder::makeNum(i))));
+    outer[3]->push_back(inner);
+  }
+  return ast;
+}
+
+TEST(JSPrinterTest, StreamsNestedFunctionsInParallel) {
+  Ref ast = makeNestedFunctions(50000);
+
+  JSPrinter serial(true, false, ast);
+  serial.parallel = false;
+  serial.printAst();
+  std::string expected(serial.buffer, serial.used);
+
+  // Print the inner functions in parallel, as when there are multiple threads.
+  std::ostringstream out;
+  JSPrinter printer(true, false, ast, out);
+  printer.parallel = true;
+  printer.printAst();
+  EXPECT_EQ(out.str(), expected);
+
+  // The outer function contains nearly all of the output, but it is streamed
+  // as it is printed, so only a small part of the output is buffered at once.
+  EXPECT_LT(printer.size, expected.size() / 8);
+}
@@ -0,0 +1,246 @@
+#include "ir/find_all.h"
+#include "ir/utils.h"
+#include "pass.h"
+#include "support/file.h"
+#include "support/threads.h"
+#include "wasm-binary.h"
+#include "wasm-s-parser.h"
+#include "wasm.h"
+#include "gtest/gtest.h"
+
+using namespace wasm;
+
+// Parse a module from text and return it.
+static std::unique_ptr<Module> parse(std::string module) {
+  auto wasm = std::make_unique<Module>();
+  wasm->features = FeatureSet::All;
+  try {
+    SExpressionParser parser(&module.front());
+    Element& root = *parser.root;
+    SExpressionWasmBuilder builder(*wasm, *root[0], IRProfile::Normal);
+  } catch (ParseException& p) {
+    p.dump(std::cerr);
+    Fatal() << "error in parsing wasm text";
+  }
+  return wasm;
+}
+
+static std::vector<char> makeBinary() {
+  auto wasm = parse(R"(
+    (module
+      (import "env" "imported" (func $imported (param i32)))
+      (global $g (mut i32) (i32.const 0))
+      (table 1 funcref)
+      (elem (i32.const 0) $add)
+      (func $add (param $x i32) (param $y i32) (result i32)
+        (i32.add
+          (local.get $x)
+          (local.get $y)
+        )
+      )
+      (func $calls (param $x i32)
+        (call $imported
+          (call $add
+            (local.get $x)
+            (global.get $g)
+          )
+        )
+        (global.set $g
+          (ref.is_null
+            (ref.func $add)
+          )
+        )
+      )
+      (func $loop (result i32)
+        (local $i i32)
+        (loop $l
+          (br_if $l
+            (local.tee $i
+              (i32.sub
+                (local.get $i)
+                (i32.const 1)
+              )
+            )
+          )
+        )
+        (call_indirect (param i32 i32) (result i32)
+          (local.get $i)
+          (i32.const 1)
+          (i32.const 0)
+        )
+      )
+    )
+  )");
+  BufferWithRandomAccess buffer;
+  WasmBinaryWriter(wasm.get(), buffer).write();
+  return std::vector<char>(buffer.begin(), buffer.end());
+}
+
+// Reads the binary into a module with all of its bodies.
+static void readEagerly(Module& wasm, std::vector<char> binary) {
+  wasm.features = FeatureSet::All;
+  WasmBinaryBuilder builder(
+    wasm, wasm.features, std::string_view(binary.data(), binary.size()));
+  builder.read();
+}
+
+// Reads the binary into a module with lazy bodies.
+static void
+readLazily(Module& wasm, LazyFunctionBodies& lazy, std::vector<char> binary) {
+  wasm.features = FeatureSet::All;
+  auto input = std::make_unique<MappedFile>(std::move(binary));
+  lazy.createBuilder(wasm, std::move(input)).read();
+}
+
+TEST(LazyFunctionBodiesTest, Materialize) {
+  auto binary = makeBinary();
+  Module eager;
+  readEagerly(eager, binary);
+
+  Module wasm;
+  LazyFunctionBodies lazy;
+  readLazily(wasm, lazy, binary);
+
+  EXPECT_FALSE(lazy.isLazy(wasm.getFunction("imported")));
+  for (auto name : {"add", "calls", "loop"}) {
+    auto* func = wasm.getFunction(name);
+    EXPECT_TRUE(lazy.isLazy(func));
+    // Until it is materialized, a function has a placeholder body.
+    EXPECT_TRUE(func->body->is<Unreachable>());
+  }
+
+  // Materializing one function decodes just that one, with the same body as
+  // reading it eagerly.
+  auto* calls = wasm.getFunction("calls");
+  lazy.materialize(calls);
+  EXPECT_FALSE(lazy.isLazy(calls));
+  EXPECT_TRUE(lazy.isLazy(wasm.getFunction("add")));
+  EXPECT_TRUE(
+    ExpressionAnalyzer::equal(calls->body, eager.getFunction("calls")->body));
+  EXPECT_EQ(calls->vars, eager.getFunction("calls")->vars);
+
+  // Materializing again does nothing.
+  auto* body = calls->body;
+  lazy.materialize(calls);
+  EXPECT_EQ(calls->body, body);
+
+  lazy.materializeAll();
+  for (auto& func : wasm.functions) {
+    EXPECT_FALSE(lazy.isLazy(func.get()));
+    if (!func->imported()) {
+      auto* other = eager.getFunction(func->name);
+      EXPECT_TRUE(ExpressionAnalyzer::equal(func->body, other->body));
+      EXPECT_EQ(func->vars, other->vars);
+    }
+  }
+}
+
+TEST(LazyFunctionBodiesTest, MaterializeInParallel) {
+  auto binary = makeBinary();
+  Module eager;
+  readEagerly(eager, binary);
+
+  Module wasm;
+  LazyFunctionBodies lazy;
+  readLazily(wasm, lazy, binary);
+
+  // Materialize each function several times at once.
+  std::vector<size_t> items;
+  for (size_t i = 0; i < 4 * wasm.functions.size(); i++) {
+    items.push_back(i % wasm.functions.size());
+  }
+  WorkStealingQueues::run(items, [&](size_t, size_t i) {
+    lazy.materialize(wasm.functions[i].get());
+  });
+  for (auto& func : wasm.functions) {
+    EXPECT_FALSE(lazy.isLazy(func.get()));
+    if (!func->imported()) {
+      auto* other = eager.getFunction(func->name);
+      EXPECT_TRUE(ExpressionAnalyzer::equal(func->body, other->body));
+    }
+  }
+}
+
+TEST(LazyFunctionBodiesTest, MaterializeAfterRenaming) {
+  auto binary = makeBinary();
+  Module wasm;
+  LazyFunctionBodies lazy;
+  readLazily(wasm, lazy, binary);
+
+  // Bodies refer to functions by index, so a body decoded after a rename uses
+  // the new name.
+  auto* add = wasm.getFunction("add");
+  add->name = "renamed";
+  wasm.updateMaps();
+  auto* calls = wasm.getFunction("calls");
+  lazy.materialize(calls);
+  bool found = false;
+  for (auto* call : FindAll<Call>(calls->body).list) {
+    if (call->target == "renamed") {
+      found = true;
+    }
+  }
+  EXPECT_TRUE(found);
+}
+
+TEST(LazyFunctionBodiesTest, Passes) {
+  auto binary = makeBinary();
+  Module wasm;
+  LazyFunctionBodies lazy;
+  readLazily(wasm, lazy, binary);
+  EXPECT_EQ(wasm.lazyFunctionBodies, &lazy);
+
+  // Running passes on one function decodes just that one.
+  auto* calls = wasm.getFunction("calls");
+  PassRunner(&wasm).runOnFunction(calls);
+  EXPECT_FALSE(lazy.isLazy(calls));
+  EXPECT_TRUE(lazy.isLazy(wasm.getFunction("add")));
+
+  // Running passes on the module decodes everything.
+  PassRunner runner(&wasm);
+  runner.add("vacuum");
+  runner.run();
+  for (auto& func : wasm.functions) {
+    EXPECT_FALSE(lazy.isLazy(func.get()));
+  }
+}
+
+TEST(LazyFunctionBodiesTest, Writing) {
+  auto binary = makeBinary();
+  Module wasm;
+  LazyFunctionBodies lazy;
+  readLazily(wasm, lazy, binary);
+
+  // Writing the module decodes everything, so the output is the same as when
+  // reading it eagerly.
+  Module eager;
+  readEagerly(eager, binary);
+  BufferWithRandomAccess expected;
+  WasmBinaryWriter(&eager, expected).write();
+  BufferWithRandomAccess buffer;
+  WasmBinaryWriter(&wasm, buffer).write();
+  EXPECT_FALSE(lazy.isLazy(wasm.getFunction("add")));
+  EXPECT_EQ(std::vector<char>(buffer.begin(), buffer.end()),
+            std::vector<char>(expected.begin(), expected.end()));
+}
+
+TEST(LazyFunctionBodiesTest, SkipRemaining) {
+  auto binary = makeBinary();
+  Module wasm;
+  LazyFunctionBodies lazy;
+  readLazily(wasm, lazy, binary);
+
+  auto* calls = wasm.getFunction("calls");
+  lazy.materialize(calls);
+  lazy.skipRemaining();
+  EXPECT_EQ(wasm.lazyFunctionBodies, nullptr);
+
+  // The other functions keep their placeholders, also when running passes.
+  PassRunner runner(&wasm);
+  runner.add("vacuum");
+  runner.run();
+  auto* add = wasm.getFunction("add");
+  EXPECT_FALSE(lazy.isLazy(add));
+  EXPECT_TRUE(add->body->is<Unreachable>());
+  EXPECT_FALSE(calls->body->is<Unreachable>());
+}
@@ -0,0 +1,135 @@
+#include "ir/find_all.h"
+#include "ir/local-graph.h"
+#include "wasm-s-parser.h"
+#include "wasm.h"
+#include "gtest/gtest.h"
+
+using namespace wasm;
+
+// Parse a module from text and return it.
+static std::unique_ptr<Module> parse(std::string module) {
+  auto wasm = std::make_unique<Module>();
+  wasm->features = FeatureSet::All;
+  try {
+    SExpressionParser parser(&module.front());
+    Element& root = *parser.root;
+    SExpressionWasmBuilder builder(*wasm, *root[0], IRProfile::Normal);
+  } catch (ParseException& p) {
+    p.dump(std::cerr);
+    Fatal() << "error in parsing wasm text";
+  }
+  return wasm;
+};
+
+static std::unique_ptr<Module> makeModule() {
+  return parse(R"(
+    (module
+      (func $test (param $p i32) (result i32)
+        (local $x i32)
+        (local $y i32)
+        ;; Reads the param.
+        (local.set $x
+          (local.get $p)
+        )
+        (block $out
+          (loop $loop
+            ;; Reads the set before the loop and the set at the end of it.
+            (br_if $out
+              (local.get $x)
+            )
+            ;; Reads the zero init and the set below.
+            (drop
+              (local.get $y)
+            )
+            (local.set $y
+              (local.get $x)
+            )
+            ;; Reads the set just before it.
+            (local.set $x
+              (i32.sub
+                (local.get $x)
+                (i32.const 1)
+              )
+            )
+            (br $loop)
+          )
+        )
+        (if
+          (local.get $p)
+          (local.set $y
+            (i32.const 1)
+          )
+        )
+        ;; Reads the zero init and both sets of $y.
+        (local.get $y)
+      )
+    )
+  )");
+}
+
+TEST(LocalGraphTest, LazyMatchesEager) {
+  auto wasm = makeModule();
+  auto* func = wasm->getFunction("test");
+
+  LocalGraph graph(func);
+  LazyLocalGraph lazy(func);
+
+  EXPECT_EQ(graph.locations, lazy.locations);
+
+  auto gets = FindAll<LocalGet>(func->body).list;
+  ASSERT_EQ(gets.size(), 7u);
+  for (auto* get : gets) {
+    auto& expected = graph.getSetses[get];
+    // Ask twice, to check the second answer comes from the cache.
+    for (int i = 0; i < 2; i++) {
+      auto& sets = lazy.getSets(get);
+      EXPECT_EQ(sets.size(), expected.size());
+      for (auto* set : expected) {
+        EXPECT_EQ(sets.count(set), 1u);
+      }
+    }
+  }
+
+  // Check a few of them precisely.
+  auto sets = FindAll<LocalSet>(func->body).list;
+  ASSERT_EQ(sets.size(), 4u);
+  auto* setX = sets[0];
+  auto* setY = sets[1];
+  auto* setXLoop = sets[2];
+  auto* setYIf = sets[3];
+
+  // The param read.
+  EXPECT_EQ(lazy.getSets(gets[0]).size(), 1u);
+  EXPECT_EQ(lazy.getSets(gets[0]).count(nullptr), 1u);
+  // The br_if condition.
+  EXPECT_EQ(lazy.getSets(gets[1]).size(), 2u);
+  EXPECT_EQ(lazy.getSets(gets[1]).count(setX), 1u);
+  EXPECT_EQ(lazy.getSets(gets[1]).count(setXLoop), 1u);
+  // The read of $y in the loop.
+  EXPECT_EQ(lazy.getSets(gets[2]).size(), 2u);
+  EXPECT_EQ(lazy.getSets(gets[2]).count(nullptr), 1u);
+  EXPECT_EQ(lazy.getSets(gets[2]).count(setY), 1u);
+  // The final read of $y.
+  EXPECT_EQ(lazy.getSets(gets[6]).size(), 3u);
+  EXPECT_EQ(lazy.getSets(gets[6]).count(nullptr), 1u);
+  EXPECT_EQ(lazy.getSets(gets[6]).count(setY), 1u);
+  EXPECT_EQ(lazy.getSets(gets[6]).count(setYIf), 1u);
+}
+
+TEST(LocalGraphTest, LazyUnreachable) {
+  auto wasm = parse(R"(
+    (module
+      (func $test (result i32)
+        (local $x i32)
+        (return
+          (i32.const 0)
+        )
+        (local.get $x)
+      )
+    )
+  )");
+  auto* func = wasm->getFunction("test");
+  LazyLocalGraph lazy(func);
+  auto* get = FindAll<LocalGet>(func->body).list[0];
+  EXPECT_TRUE(lazy.getSets(get).empty());
+}
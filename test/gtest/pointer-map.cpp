@@ -0,0 +1,89 @@
+#include <random>
+#include <unordered_map>
+
+#include "support/pointer_map.h"
+#include "gtest/gtest.h"
+
+using namespace wasm;
+
+TEST(PointerMapTest, Basics) {
+  int a, b;
+  PointerMap<int*, int> map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.find(&a), map.end());
+  EXPECT_EQ(map.count(&a), 0u);
+
+  map[&a] = 1;
+  map[&b] = 2;
+  EXPECT_EQ(map.size(), 2u);
+  EXPECT_EQ(map.count(&a), 1u);
+  EXPECT_EQ(map.find(&b)->second, 2);
+  EXPECT_EQ(map.at(&a), 1);
+
+  // Lookups through operator[] do not add anything.
+  map[&a]++;
+  EXPECT_EQ(map.size(), 2u);
+  EXPECT_EQ(map.at(&a), 2);
+
+  map.erase(map.find(&a));
+  EXPECT_EQ(map.size(), 1u);
+  EXPECT_EQ(map.count(&a), 0u);
+  EXPECT_EQ(map.erase(&a), 0u);
+  EXPECT_EQ(map.erase(&b), 1u);
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.begin(), map.end());
+}
+
+TEST(PointerMapTest, CopyAndMove) {
+  int a, b;
+  PointerMap<int*, int> map;
+  map[&a] = 1;
+  map[&b] = 2;
+
+  auto copy = map;
+  EXPECT_EQ(copy, map);
+  copy[&a] = 3;
+  EXPECT_NE(copy, map);
+  EXPECT_EQ(map.at(&a), 1);
+
+  auto moved = std::move(copy);
+  EXPECT_EQ(moved.size(), 2u);
+  EXPECT_EQ(moved.at(&a), 3);
+  // The moved-from map is empty, and usable.
+  EXPECT_TRUE(copy.empty());
+  EXPECT_EQ(copy.find(&a), copy.end());
+  copy[&b] = 4;
+  EXPECT_EQ(copy.size(), 1u);
+}
+
+TEST(PointerMapTest, MatchesUnorderedMap) {
+  // Insert and erase many keys in a random order, which exercises collisions
+  // and moving entries back when erasing, and compare to a std::unordered_map.
+  std::vector<char> storage(4096);
+  std::mt19937 rng(42);
+  PointerMap<char*, size_t> map;
+  std::unordered_map<char*, size_t> expected;
+  for (size_t i = 0; i < 100000; i++) {
+    auto* key = &storage[rng() % storage.size()];
+    switch (rng() % 3) {
+      case 0:
+      case 1:
+        map[key] = i;
+        expected[key] = i;
+        break;
+      case 2:
+        EXPECT_EQ(map.erase(key), expected.erase(key));
+        break;
+    }
+  }
+  EXPECT_EQ(map.size(), expected.size());
+  size_t seen = 0;
+  for (auto& [key, value] : map) {
+    EXPECT_EQ(expected.at(key), value);
+    seen++;
+  }
+  EXPECT_EQ(seen, expected.size());
+  for (auto& c : storage) {
+    EXPECT_EQ(map.count(&c), expected.count(&c));
+  }
+}
@@ -1,3 +1,4 @@
+#include "concurrency.h"
 #include "ir/subtypes.h"
 #include "type-test.h"
 #include "wasm-type-printing.h"
@@ -535,3 +536,40 @@ TEST_F(NominalTest, testSubTypes) {
   auto subTypes1 = subTypes.getStrictSubTypes(built[1]);
   EXPECT_EQ(subTypes1.size(), 0u);
 }
+
+// Create the same types from several threads at once, as function-parallel
+// passes do, checking that they all get the same results.
+static void testConcurrentTypeCreation() {
+  constexpr size_t rounds = 100;
+  std::vector<Type> basics = {Type::i32, Type::i64, Type::f32, Type::f64};
+
+  std::vector<std::vector<Type>> results(NumTestThreads);
+  runOnTestThreads([&](size_t t) {
+    auto& result = results[t];
+    for (size_t round = 0; round < rounds; round++) {
+      result.clear();
+      for (auto a : basics) {
+        for (auto b : basics) {
+          for (auto c : basics) {
+            HeapType sig(Signature(Type({a, b}), c));
+            result.push_back(Type(sig, Nullable));
+            result.push_back(Type(sig, NonNullable));
+            result.push_back(Type({Type(sig, Nullable), a}));
+          }
+        }
+      }
+    }
+  });
+
+  for (size_t t = 1; t < NumTestThreads; t++) {
+    EXPECT_EQ(results[t], results[0]);
+  }
+}
+
+TEST_F(EquirecursiveTest, ConcurrentTypeCreation) {
+  testConcurrentTypeCreation();
+}
+TEST_F(NominalTest, ConcurrentTypeCreation) { testConcurrentTypeCreation(); }
+TEST_F(IsorecursiveTest, ConcurrentTypeCreation) {
+  testConcurrentTypeCreation();
+}
@@ -0,0 +1,55 @@
+#include "wasm-builder.h"
+#include "wasm-s-parser.h"
+#include "wasm-validator.h"
+#include "wasm.h"
+#include "gtest/gtest.h"
+
+using namespace wasm;
+
+static std::unique_ptr<Module> makeModule() {
+  auto wasm = std::make_unique<Module>();
+  std::string module = R"(
+    (module
+      (func $good (result i32)
+        (i32.const 0)
+      )
+      (func $bad (result i32)
+        (i32.const 1)
+      )
+    )
+  )";
+  SExpressionParser parser(&module.front());
+  Element& root = *parser.root;
+  SExpressionWasmBuilder builder(*wasm, *root[0], IRProfile::Normal);
+  return wasm;
+}
+
+TEST(ValidatorTest, Functions) {
+  auto wasm = makeModule();
+  auto* good = wasm->getFunction("good");
+  auto* bad = wasm->getFunction("bad");
+  auto flags = WasmValidator::Globally | WasmValidator::Quiet;
+
+  EXPECT_TRUE(WasmValidator().validate(*wasm, flags));
+
+  // Make one function return the wrong type.
+  bad->body = Builder(*wasm).makeConst(Literal(int64_t(1)));
+  EXPECT_FALSE(WasmValidator().validate(*wasm, flags));
+  EXPECT_TRUE(WasmValidator().validate(*wasm, {good}, flags));
+  EXPECT_FALSE(WasmValidator().validate(*wasm, {bad}, flags));
+  EXPECT_FALSE(WasmValidator().validate(*wasm, {good, bad}, flags));
+}
+
+TEST(ValidatorTest, ModuleLevel) {
+  auto wasm = makeModule();
+  auto* good = wasm->getFunction("good");
+  auto flags = WasmValidator::Globally | WasmValidator::Quiet;
+
+  // Export a function that does not exist. Only validating the entire module
+  // notices that.
+  wasm->addExport(
+    Builder::makeExport("missing", "missing", ExternalKind::Function));
+  EXPECT_FALSE(WasmValidator().validate(*wasm, flags));
+  EXPECT_TRUE(WasmValidator().validate(*wasm, {good}, flags));
+  EXPECT_TRUE(WasmValidator().validate(*wasm, {}, flags));
+}
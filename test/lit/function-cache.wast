@@ -0,0 +1,48 @@
+;; Test that optimized functions are stored in the function cache and read back
+;; from it when optimizing the same code again.
+
+;; RUN: rm -rf %t.cache && mkdir %t.cache
+;; RUN: wasm-opt %s -O1 -S -o %t.nocache.wat
+;; RUN: wasm-opt %s -O1 --function-cache-dir %t.cache -S -o %t.first.wat
+;; RUN: wasm-opt %s -O1 --function-cache-dir %t.cache -S -o %t.second.wat
+;; RUN: diff %t.nocache.wat %t.first.wat
+;; RUN: diff %t.nocache.wat %t.second.wat
+
+;; Modify the optimized code in the cache, which should then show up in the
+;; output, showing that it was not optimized again. There is a single entry, for
+;; $add.
+
+;; RUN: sed -e 's/i32.const 3/i32.const 1337/' %t.cache/* > %t.modified
+;; RUN: mv %t.modified %t.cache/*
+;; RUN: wasm-opt %s -O1 --function-cache-dir %t.cache -S -o - | filecheck %s
+
+;; CHECK:      (func $add (result i32)
+;; CHECK-NEXT:  (i32.const 1337)
+;; CHECK-NEXT: )
+
+;; An entry written by another version of Binaryen is not used.
+
+;; RUN: sed -e 's/^;; version .*/;; version 0/' %t.cache/* > %t.modified
+;; RUN: mv %t.modified %t.cache/*
+;; RUN: wasm-opt %s -O1 --function-cache-dir %t.cache -S -o - | filecheck %s --check-prefix=VERSION
+
+;; VERSION:      (func $add (result i32)
+;; VERSION-NEXT:  (i32.const 3)
+;; VERSION-NEXT: )
+
+;; A different pipeline does not use the same cache entries.
+
+;; RUN: wasm-opt %s --precompute --function-cache-dir %t.cache -S -o - | filecheck %s --check-prefix=PRECOMPUTE
+
+;; PRECOMPUTE:      (func $add (result i32)
+;; PRECOMPUTE-NEXT:  (i32.const 3)
+;; PRECOMPUTE-NEXT: )
+
+(module
+ (func $add (export "add") (result i32)
+  (i32.add
+   (i32.const 1)
+   (i32.const 2)
+  )
+ )
+)
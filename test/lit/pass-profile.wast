@@ -0,0 +1,34 @@
+;; Test that --pass-profile records each pass on each function.
+
+;; RUN: wasm-opt %s --precompute --vacuum --pass-profile %t.csv -o %t.wasm
+;; RUN: cat %t.csv | filecheck %s
+
+;; CHECK:      pass,function,thread,start_us,duration_us,allocated_bytes,size_before,size_after
+;; CHECK-DAG:  "precompute","add",{{[0-9]+}},{{[0-9.]+}},{{[0-9.]+}},{{-?[0-9]+}},3,1
+;; CHECK-DAG:  "vacuum","add",{{[0-9]+}},{{[0-9.]+}},{{[0-9.]+}},{{-?[0-9]+}},1,1
+;; CHECK-DAG:  "precompute","drop",{{[0-9]+}},{{[0-9.]+}},{{[0-9.]+}},{{-?[0-9]+}},2,1
+;; CHECK-DAG:  "vacuum","drop",{{[0-9]+}},{{[0-9.]+}},{{[0-9.]+}},{{-?[0-9]+}},1,1
+
+;; The same, as a trace.
+
+;; RUN: wasm-opt %s --precompute --vacuum --pass-profile %t.json -o %t.wasm
+;; RUN: cat %t.json | filecheck %s --check-prefix=TRACE
+
+;; TRACE:      {"traceEvents":[
+;; TRACE-DAG:  {"name":"precompute","cat":"function","ph":"X","pid":0,"tid":{{[0-9]+}},"ts":{{[0-9.]+}},"dur":{{[0-9.]+}},"args":{"function":"add","allocated":{{-?[0-9]+}},"sizeBefore":3,"sizeAfter":1}}
+;; TRACE-DAG:  {"name":"precompute","cat":"function","ph":"X","pid":0,"tid":{{[0-9]+}},"ts":{{[0-9.]+}},"dur":{{[0-9.]+}},"args":{"function":"drop","allocated":{{-?[0-9]+}},"sizeBefore":2,"sizeAfter":1}}
+;; TRACE:      ]}
+
+(module
+ (func $add (export "add") (result i32)
+  (i32.add
+   (i32.const 1)
+   (i32.const 2)
+  )
+ )
+ (func $drop (export "drop")
+  (drop
+   (i32.const 3)
+  )
+ )
+)
@@ -0,0 +1,51 @@
+;; NOTE: Assertions have been generated by update_lit_checks.py and should not be edited.
+;; RUN: wasm-opt %s --compact-arena -S -o - | filecheck %s
+
+;; All the expressions in the module, in functions as well as in globals and
+;; segments, are copied into a new arena. Nothing else changes.
+(module
+ ;; CHECK:      (type $i32_=>_i32 (func (param i32) (result i32)))
+
+ ;; CHECK:      (global $g (mut i32) (i32.const 42))
+ (global $g (mut i32) (i32.const 42))
+ ;; CHECK:      (memory $0 1 1)
+ (memory 1 1)
+ ;; CHECK:      (data (i32.const 10) "hello")
+ (data (i32.const 10) "hello")
+ ;; CHECK:      (table $0 1 1 funcref)
+ (table 1 1 funcref)
+ ;; CHECK:      (elem (i32.const 0) $foo)
+ (elem (i32.const 0) $foo)
+ ;; CHECK:      (func $foo (param $x i32) (result i32)
+ ;; CHECK-NEXT:  (local $y i32)
+ ;; CHECK-NEXT:  (local.set $y
+ ;; CHECK-NEXT:   (i32.add
+ ;; CHECK-NEXT:    (local.get $x)
+ ;; CHECK-NEXT:    (global.get $g)
+ ;; CHECK-NEXT:   )
+ ;; CHECK-NEXT:  )
+ ;; CHECK-NEXT:  (if (result i32)
+ ;; CHECK-NEXT:   (local.get $y)
+ ;; CHECK-NEXT:   (call $foo
+ ;; CHECK-NEXT:    (local.get $y)
+ ;; CHECK-NEXT:   )
+ ;; CHECK-NEXT:   (i32.const 1)
+ ;; CHECK-NEXT:  )
+ ;; CHECK-NEXT: )
+ (func $foo (param $x i32) (result i32)
+  (local $y i32)
+  (local.set $y
+   (i32.add
+    (local.get $x)
+    (global.get $g)
+   )
+  )
+  (if (result i32)
+   (local.get $y)
+   (call $foo
+    (local.get $y)
+   )
+   (i32.const 1)
+  )
+ )
+)
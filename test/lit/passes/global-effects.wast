@@ -0,0 +1,541 @@
+;; NOTE: Assertions have been generated by update_lit_checks.py and should not be edited.
+
+;; Run without global effects, and run with, and also run with but discard them
+;; first (to check that discard works; that should be the same as without).
+;; Any pass that does not declare that it keeps the effects valid discards them
+;; as well, like dealign here, even though it changes nothing in these modules.
+
+;; RUN: foreach %s %t wasm-opt -all                                                   --simplify-locals --vacuum -S -o - | filecheck %s --check-prefix WITHOUT
+;; RUN: foreach %s %t wasm-opt -all --generate-global-effects                         --simplify-locals --vacuum -S -o - | filecheck %s --check-prefix INCLUDE
+;; RUN: foreach %s %t wasm-opt -all --generate-global-effects --discard-global-effects --simplify-locals --vacuum -S -o - | filecheck %s --check-prefix DISCARD
+;; RUN: foreach %s %t wasm-opt -all --generate-global-effects --dealign                --simplify-locals --vacuum -S -o - | filecheck %s --check-prefix DISCARD
+
+(module
+  ;; WITHOUT:      (import "a" "b" (func $import))
+  ;; INCLUDE:      (import "a" "b" (func $import))
+  ;; DISCARD:      (import "a" "b" (func $import))
+  (import "a" "b" (func $import))
+
+  ;; WITHOUT:      (global $g (mut i32) (i32.const 0))
+  ;; INCLUDE:      (global $g (mut i32) (i32.const 0))
+  ;; DISCARD:      (global $g (mut i32) (i32.const 0))
+  (global $g (mut i32) (i32.const 0))
+
+  (table 1 1 funcref)
+
+  ;; WITHOUT:      (func $main
+  ;; WITHOUT-NEXT:  (call $nop)
+  ;; WITHOUT-NEXT:  (call $calls-nop)
+  ;; WITHOUT-NEXT:  (call $recurse)
+  ;; WITHOUT-NEXT:  (call $calls-import)
+  ;; WITHOUT-NEXT:  (call $calls-calls-import)
+  ;; WITHOUT-NEXT:  (call $call-indirect)
+  ;; WITHOUT-NEXT:  (call $writes-global)
+  ;; WITHOUT-NEXT:  (call $unreachable)
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $main
+  ;; INCLUDE-NEXT:  (call $recurse)
+  ;; INCLUDE-NEXT:  (call $calls-import)
+  ;; INCLUDE-NEXT:  (call $calls-calls-import)
+  ;; INCLUDE-NEXT:  (call $call-indirect)
+  ;; INCLUDE-NEXT:  (call $writes-global)
+  ;; INCLUDE-NEXT:  (call $unreachable)
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $main
+  ;; DISCARD-NEXT:  (call $nop)
+  ;; DISCARD-NEXT:  (call $calls-nop)
+  ;; DISCARD-NEXT:  (call $recurse)
+  ;; DISCARD-NEXT:  (call $calls-import)
+  ;; DISCARD-NEXT:  (call $calls-calls-import)
+  ;; DISCARD-NEXT:  (call $call-indirect)
+  ;; DISCARD-NEXT:  (call $writes-global)
+  ;; DISCARD-NEXT:  (call $unreachable)
+  ;; DISCARD-NEXT: )
+  (func $main
+    ;; Calling a function with no effects can be optimized away when we have
+    ;; global effect info.
+    (call $nop)
+    ;; Calling a function that calls one with no effects can be too.
+    (call $calls-nop)
+    ;; Recursion is an infinite loop, which is an effect.
+    (call $recurse)
+    ;; Calling an import, directly or indirectly, or doing an indirect call, is
+    ;; an effect that we cannot know.
+    (call $calls-import)
+    (call $calls-calls-import)
+    (call $call-indirect)
+    ;; Writing a global is an effect.
+    (call $writes-global)
+    ;; Traps are effects.
+    (call $unreachable)
+  )
+
+  ;; WITHOUT:      (func $nop
+  ;; WITHOUT-NEXT:  (nop)
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $nop
+  ;; INCLUDE-NEXT:  (nop)
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $nop
+  ;; DISCARD-NEXT:  (nop)
+  ;; DISCARD-NEXT: )
+  (func $nop
+    (nop)
+  )
+
+  ;; WITHOUT:      (func $calls-nop
+  ;; WITHOUT-NEXT:  (call $nop)
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $calls-nop
+  ;; INCLUDE-NEXT:  (nop)
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $calls-nop
+  ;; DISCARD-NEXT:  (call $nop)
+  ;; DISCARD-NEXT: )
+  (func $calls-nop
+    (call $nop)
+  )
+
+  ;; WITHOUT:      (func $recurse
+  ;; WITHOUT-NEXT:  (call $recurse)
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $recurse
+  ;; INCLUDE-NEXT:  (call $recurse)
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $recurse
+  ;; DISCARD-NEXT:  (call $recurse)
+  ;; DISCARD-NEXT: )
+  (func $recurse
+    (call $recurse)
+  )
+
+  ;; WITHOUT:      (func $calls-import
+  ;; WITHOUT-NEXT:  (call $import)
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $calls-import
+  ;; INCLUDE-NEXT:  (call $import)
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $calls-import
+  ;; DISCARD-NEXT:  (call $import)
+  ;; DISCARD-NEXT: )
+  (func $calls-import
+    (call $import)
+  )
+
+  ;; WITHOUT:      (func $calls-calls-import
+  ;; WITHOUT-NEXT:  (call $calls-import)
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $calls-calls-import
+  ;; INCLUDE-NEXT:  (call $calls-import)
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $calls-calls-import
+  ;; DISCARD-NEXT:  (call $calls-import)
+  ;; DISCARD-NEXT: )
+  (func $calls-calls-import
+    (call $calls-import)
+  )
+
+  ;; WITHOUT:      (func $call-indirect
+  ;; WITHOUT-NEXT:  (call_indirect $0 (type $none_=>_none)
+  ;; WITHOUT-NEXT:   (i32.const 0)
+  ;; WITHOUT-NEXT:  )
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $call-indirect
+  ;; INCLUDE-NEXT:  (call_indirect $0 (type $none_=>_none)
+  ;; INCLUDE-NEXT:   (i32.const 0)
+  ;; INCLUDE-NEXT:  )
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $call-indirect
+  ;; DISCARD-NEXT:  (call_indirect $0 (type $none_=>_none)
+  ;; DISCARD-NEXT:   (i32.const 0)
+  ;; DISCARD-NEXT:  )
+  ;; DISCARD-NEXT: )
+  (func $call-indirect
+    (call_indirect (i32.const 0))
+  )
+
+  ;; WITHOUT:      (func $writes-global
+  ;; WITHOUT-NEXT:  (global.set $g
+  ;; WITHOUT-NEXT:   (i32.const 1)
+  ;; WITHOUT-NEXT:  )
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $writes-global
+  ;; INCLUDE-NEXT:  (global.set $g
+  ;; INCLUDE-NEXT:   (i32.const 1)
+  ;; INCLUDE-NEXT:  )
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $writes-global
+  ;; DISCARD-NEXT:  (global.set $g
+  ;; DISCARD-NEXT:   (i32.const 1)
+  ;; DISCARD-NEXT:  )
+  ;; DISCARD-NEXT: )
+  (func $writes-global
+    (global.set $g
+      (i32.const 1)
+    )
+  )
+
+  ;; WITHOUT:      (func $unreachable
+  ;; WITHOUT-NEXT:  (unreachable)
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $unreachable
+  ;; INCLUDE-NEXT:  (unreachable)
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $unreachable
+  ;; DISCARD-NEXT:  (unreachable)
+  ;; DISCARD-NEXT: )
+  (func $unreachable
+    (unreachable)
+  )
+)
+
+(module
+  ;; WITHOUT:      (global $g (mut i32) (i32.const 0))
+  ;; INCLUDE:      (global $g (mut i32) (i32.const 0))
+  ;; DISCARD:      (global $g (mut i32) (i32.const 0))
+  (global $g (mut i32) (i32.const 0))
+
+  ;; WITHOUT:      (func $reads-global (result i32)
+  ;; WITHOUT-NEXT:  (global.get $g)
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $reads-global (result i32)
+  ;; INCLUDE-NEXT:  (global.get $g)
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $reads-global (result i32)
+  ;; DISCARD-NEXT:  (global.get $g)
+  ;; DISCARD-NEXT: )
+  (func $reads-global (result i32)
+    (global.get $g)
+  )
+
+  ;; WITHOUT:      (func $writes-global
+  ;; WITHOUT-NEXT:  (global.set $g
+  ;; WITHOUT-NEXT:   (i32.const 1)
+  ;; WITHOUT-NEXT:  )
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $writes-global
+  ;; INCLUDE-NEXT:  (global.set $g
+  ;; INCLUDE-NEXT:   (i32.const 1)
+  ;; INCLUDE-NEXT:  )
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $writes-global
+  ;; DISCARD-NEXT:  (global.set $g
+  ;; DISCARD-NEXT:   (i32.const 1)
+  ;; DISCARD-NEXT:  )
+  ;; DISCARD-NEXT: )
+  (func $writes-global
+    (global.set $g
+      (i32.const 1)
+    )
+  )
+
+  ;; WITHOUT:      (func $test (result i32)
+  ;; WITHOUT-NEXT:  (local $x i32)
+  ;; WITHOUT-NEXT:  (local.set $x
+  ;; WITHOUT-NEXT:   (global.get $g)
+  ;; WITHOUT-NEXT:  )
+  ;; WITHOUT-NEXT:  (drop
+  ;; WITHOUT-NEXT:   (call $reads-global)
+  ;; WITHOUT-NEXT:  )
+  ;; WITHOUT-NEXT:  (i32.add
+  ;; WITHOUT-NEXT:   (local.get $x)
+  ;; WITHOUT-NEXT:   (i32.const 1)
+  ;; WITHOUT-NEXT:  )
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $test (result i32)
+  ;; INCLUDE-NEXT:  (local $x i32)
+  ;; INCLUDE-NEXT:  (i32.add
+  ;; INCLUDE-NEXT:   (global.get $g)
+  ;; INCLUDE-NEXT:   (i32.const 1)
+  ;; INCLUDE-NEXT:  )
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $test (result i32)
+  ;; DISCARD-NEXT:  (local $x i32)
+  ;; DISCARD-NEXT:  (local.set $x
+  ;; DISCARD-NEXT:   (global.get $g)
+  ;; DISCARD-NEXT:  )
+  ;; DISCARD-NEXT:  (drop
+  ;; DISCARD-NEXT:   (call $reads-global)
+  ;; DISCARD-NEXT:  )
+  ;; DISCARD-NEXT:  (i32.add
+  ;; DISCARD-NEXT:   (local.get $x)
+  ;; DISCARD-NEXT:   (i32.const 1)
+  ;; DISCARD-NEXT:  )
+  ;; DISCARD-NEXT: )
+  (func $test (result i32)
+    (local $x i32)
+    ;; Global effects let us see that the call does not interfere with the
+    ;; read of the global, so we can move it into the add.
+    (local.set $x
+      (global.get $g)
+    )
+    (drop
+      (call $reads-global)
+    )
+    (i32.add
+      (local.get $x)
+      (i32.const 1)
+    )
+  )
+
+  ;; WITHOUT:      (func $test-write (result i32)
+  ;; WITHOUT-NEXT:  (local $x i32)
+  ;; WITHOUT-NEXT:  (local.set $x
+  ;; WITHOUT-NEXT:   (global.get $g)
+  ;; WITHOUT-NEXT:  )
+  ;; WITHOUT-NEXT:  (call $writes-global)
+  ;; WITHOUT-NEXT:  (i32.add
+  ;; WITHOUT-NEXT:   (local.get $x)
+  ;; WITHOUT-NEXT:   (i32.const 1)
+  ;; WITHOUT-NEXT:  )
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $test-write (result i32)
+  ;; INCLUDE-NEXT:  (local $x i32)
+  ;; INCLUDE-NEXT:  (local.set $x
+  ;; INCLUDE-NEXT:   (global.get $g)
+  ;; INCLUDE-NEXT:  )
+  ;; INCLUDE-NEXT:  (call $writes-global)
+  ;; INCLUDE-NEXT:  (i32.add
+  ;; INCLUDE-NEXT:   (local.get $x)
+  ;; INCLUDE-NEXT:   (i32.const 1)
+  ;; INCLUDE-NEXT:  )
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $test-write (result i32)
+  ;; DISCARD-NEXT:  (local $x i32)
+  ;; DISCARD-NEXT:  (local.set $x
+  ;; DISCARD-NEXT:   (global.get $g)
+  ;; DISCARD-NEXT:  )
+  ;; DISCARD-NEXT:  (call $writes-global)
+  ;; DISCARD-NEXT:  (i32.add
+  ;; DISCARD-NEXT:   (local.get $x)
+  ;; DISCARD-NEXT:   (i32.const 1)
+  ;; DISCARD-NEXT:  )
+  ;; DISCARD-NEXT: )
+  (func $test-write (result i32)
+    (local $x i32)
+    ;; This call writes the global, so the read cannot move past it.
+    (local.set $x
+      (global.get $g)
+    )
+    (call $writes-global)
+    (i32.add
+      (local.get $x)
+      (i32.const 1)
+    )
+  )
+)
+
+(module
+  ;; WITHOUT:      (func $main
+  ;; WITHOUT-NEXT:  (drop
+  ;; WITHOUT-NEXT:   (call $loop)
+  ;; WITHOUT-NEXT:  )
+  ;; WITHOUT-NEXT:  (call $calls-recurse)
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $main
+  ;; INCLUDE-NEXT:  (drop
+  ;; INCLUDE-NEXT:   (call $loop)
+  ;; INCLUDE-NEXT:  )
+  ;; INCLUDE-NEXT:  (call $calls-recurse)
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $main
+  ;; DISCARD-NEXT:  (drop
+  ;; DISCARD-NEXT:   (call $loop)
+  ;; DISCARD-NEXT:  )
+  ;; DISCARD-NEXT:  (call $calls-recurse)
+  ;; DISCARD-NEXT: )
+  (func $main
+    ;; A loop may be infinite even if it is not unreachable, so calling a
+    ;; function with a loop is an effect.
+    (drop
+      (call $loop)
+    )
+    ;; Calling a function that recurses, which may not return, is an effect
+    ;; too.
+    (call $calls-recurse)
+  )
+
+  ;; WITHOUT:      (func $loop (result i32)
+  ;; WITHOUT-NEXT:  (loop $l (result i32)
+  ;; WITHOUT-NEXT:   (br_if $l
+  ;; WITHOUT-NEXT:    (i32.const 1)
+  ;; WITHOUT-NEXT:   )
+  ;; WITHOUT-NEXT:   (i32.const 0)
+  ;; WITHOUT-NEXT:  )
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $loop (result i32)
+  ;; INCLUDE-NEXT:  (loop $l (result i32)
+  ;; INCLUDE-NEXT:   (br_if $l
+  ;; INCLUDE-NEXT:    (i32.const 1)
+  ;; INCLUDE-NEXT:   )
+  ;; INCLUDE-NEXT:   (i32.const 0)
+  ;; INCLUDE-NEXT:  )
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $loop (result i32)
+  ;; DISCARD-NEXT:  (loop $l (result i32)
+  ;; DISCARD-NEXT:   (br_if $l
+  ;; DISCARD-NEXT:    (i32.const 1)
+  ;; DISCARD-NEXT:   )
+  ;; DISCARD-NEXT:   (i32.const 0)
+  ;; DISCARD-NEXT:  )
+  ;; DISCARD-NEXT: )
+  (func $loop (result i32)
+    (loop $l (result i32)
+      (br_if $l
+        (i32.const 1)
+      )
+      (i32.const 0)
+    )
+  )
+
+  ;; WITHOUT:      (func $calls-recurse
+  ;; WITHOUT-NEXT:  (call $recurse)
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $calls-recurse
+  ;; INCLUDE-NEXT:  (call $recurse)
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $calls-recurse
+  ;; DISCARD-NEXT:  (call $recurse)
+  ;; DISCARD-NEXT: )
+  (func $calls-recurse
+    (call $recurse)
+  )
+
+  ;; WITHOUT:      (func $recurse
+  ;; WITHOUT-NEXT:  (call $recurse)
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $recurse
+  ;; INCLUDE-NEXT:  (call $recurse)
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $recurse
+  ;; DISCARD-NEXT:  (call $recurse)
+  ;; DISCARD-NEXT: )
+  (func $recurse
+    (call $recurse)
+  )
+)
+
+(module
+  ;; WITHOUT:      (import "a" "b" (func $import))
+  ;; INCLUDE:      (import "a" "b" (func $import))
+  ;; DISCARD:      (import "a" "b" (func $import))
+  (import "a" "b" (func $import))
+
+  ;; WITHOUT:      (func $main
+  ;; WITHOUT-NEXT:  (call $chain-a)
+  ;; WITHOUT-NEXT:  (call $cycle-a)
+  ;; WITHOUT-NEXT:  (call $cycle-import-a)
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $main
+  ;; INCLUDE-NEXT:  (call $cycle-a)
+  ;; INCLUDE-NEXT:  (call $cycle-import-a)
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $main
+  ;; DISCARD-NEXT:  (call $chain-a)
+  ;; DISCARD-NEXT:  (call $cycle-a)
+  ;; DISCARD-NEXT:  (call $cycle-import-a)
+  ;; DISCARD-NEXT: )
+  (func $main
+    ;; A chain of calls to functions without effects can be removed.
+    (call $chain-a)
+    ;; Mutual recursion may not return, like direct recursion.
+    (call $cycle-a)
+    ;; A cycle that reaches an import has effects that cannot be known.
+    (call $cycle-import-a)
+  )
+
+  ;; WITHOUT:      (func $chain-a
+  ;; WITHOUT-NEXT:  (call $chain-b)
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $chain-a
+  ;; INCLUDE-NEXT:  (nop)
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $chain-a
+  ;; DISCARD-NEXT:  (call $chain-b)
+  ;; DISCARD-NEXT: )
+  (func $chain-a
+    (call $chain-b)
+  )
+
+  ;; WITHOUT:      (func $chain-b
+  ;; WITHOUT-NEXT:  (call $chain-c)
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $chain-b
+  ;; INCLUDE-NEXT:  (nop)
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $chain-b
+  ;; DISCARD-NEXT:  (call $chain-c)
+  ;; DISCARD-NEXT: )
+  (func $chain-b
+    (call $chain-c)
+  )
+
+  ;; WITHOUT:      (func $chain-c
+  ;; WITHOUT-NEXT:  (nop)
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $chain-c
+  ;; INCLUDE-NEXT:  (nop)
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $chain-c
+  ;; DISCARD-NEXT:  (nop)
+  ;; DISCARD-NEXT: )
+  (func $chain-c
+    (nop)
+  )
+
+  ;; WITHOUT:      (func $cycle-a
+  ;; WITHOUT-NEXT:  (call $cycle-b)
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $cycle-a
+  ;; INCLUDE-NEXT:  (call $cycle-b)
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $cycle-a
+  ;; DISCARD-NEXT:  (call $cycle-b)
+  ;; DISCARD-NEXT: )
+  (func $cycle-a
+    (call $cycle-b)
+  )
+
+  ;; WITHOUT:      (func $cycle-b
+  ;; WITHOUT-NEXT:  (call $cycle-a)
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $cycle-b
+  ;; INCLUDE-NEXT:  (call $cycle-a)
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $cycle-b
+  ;; DISCARD-NEXT:  (call $cycle-a)
+  ;; DISCARD-NEXT: )
+  (func $cycle-b
+    (call $cycle-a)
+  )
+
+  ;; WITHOUT:      (func $cycle-import-a
+  ;; WITHOUT-NEXT:  (call $cycle-import-b)
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $cycle-import-a
+  ;; INCLUDE-NEXT:  (call $cycle-import-b)
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $cycle-import-a
+  ;; DISCARD-NEXT:  (call $cycle-import-b)
+  ;; DISCARD-NEXT: )
+  (func $cycle-import-a
+    (call $cycle-import-b)
+  )
+
+  ;; WITHOUT:      (func $cycle-import-b
+  ;; WITHOUT-NEXT:  (call $cycle-import-a)
+  ;; WITHOUT-NEXT:  (call $import)
+  ;; WITHOUT-NEXT: )
+  ;; INCLUDE:      (func $cycle-import-b
+  ;; INCLUDE-NEXT:  (call $cycle-import-a)
+  ;; INCLUDE-NEXT:  (call $import)
+  ;; INCLUDE-NEXT: )
+  ;; DISCARD:      (func $cycle-import-b
+  ;; DISCARD-NEXT:  (call $cycle-import-a)
+  ;; DISCARD-NEXT:  (call $import)
+  ;; DISCARD-NEXT: )
+  (func $cycle-import-b
+    (call $cycle-import-a)
+    (call $import)
+  )
+)
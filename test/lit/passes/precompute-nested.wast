@@ -0,0 +1,83 @@
+;; NOTE: Assertions have been generated by update_lit_checks.py and should not be edited.
+;; RUN: wasm-opt %s --precompute -S -o - | filecheck %s
+
+;; Precompute remembers the expressions it failed on, and does not evaluate
+;; parents that must fail because of them. Test that parents are still
+;; precomputed when control flow can avoid the failing child.
+
+(module
+ ;; CHECK:      (import "env" "f" (func $f (result i32)))
+ (import "env" "f" (func $f (result i32)))
+
+ ;; CHECK:      (func $nested (result i32)
+ ;; CHECK-NEXT:  (i32.add
+ ;; CHECK-NEXT:   (i32.const 1)
+ ;; CHECK-NEXT:   (i32.add
+ ;; CHECK-NEXT:    (i32.const 2)
+ ;; CHECK-NEXT:    (i32.add
+ ;; CHECK-NEXT:     (i32.const 3)
+ ;; CHECK-NEXT:     (call $f)
+ ;; CHECK-NEXT:    )
+ ;; CHECK-NEXT:   )
+ ;; CHECK-NEXT:  )
+ ;; CHECK-NEXT: )
+ (func $nested (result i32)
+  ;; Each add fails because of the call, so the outer ones are skipped.
+  (i32.add
+   (i32.const 1)
+   (i32.add
+    (i32.const 2)
+    (i32.add
+     (i32.const 3)
+     (call $f)
+    )
+   )
+  )
+ )
+
+ ;; CHECK:      (func $break-first (result i32)
+ ;; CHECK-NEXT:  (i32.const 42)
+ ;; CHECK-NEXT: )
+ (func $break-first (result i32)
+  ;; The call fails, but the block branches out before reaching it.
+  (block $out (result i32)
+   (drop
+    (br $out
+     (i32.const 42)
+    )
+   )
+   (call $f)
+  )
+ )
+
+ ;; CHECK:      (func $if-arm (result i32)
+ ;; CHECK-NEXT:  (i32.const 30)
+ ;; CHECK-NEXT: )
+ (func $if-arm (result i32)
+  ;; The call fails, but it is in an arm that is not taken.
+  (if (result i32)
+   (i32.const 0)
+   (call $f)
+   (i32.add
+    (i32.const 10)
+    (i32.const 20)
+   )
+  )
+ )
+
+ ;; CHECK:      (func $if-condition (result i32)
+ ;; CHECK-NEXT:  (if (result i32)
+ ;; CHECK-NEXT:   (call $f)
+ ;; CHECK-NEXT:   (i32.const 1)
+ ;; CHECK-NEXT:   (i32.const 2)
+ ;; CHECK-NEXT:  )
+ ;; CHECK-NEXT: )
+ (func $if-condition (result i32)
+  ;; The condition fails, so the if fails as well.
+  (if (result i32)
+   (call $f)
+   (i32.const 1)
+   (i32.const 2)
+  )
+ )
+)
@@ -0,0 +1,28 @@
+;; Test that validation errors for non-nullable locals are reported in the
+;; order the gets appear in the function.
+
+;; RUN: not wasm-opt -all --enable-gc-nn-locals %s 2>&1 | filecheck %s
+
+;; CHECK:      non-nullable local must not read null, on
+;; CHECK-NEXT: 2
+;; CHECK-NEXT: {{.*}} non-nullable local must not read null, on
+;; CHECK-NEXT: 0
+;; CHECK-NEXT: {{.*}} non-nullable local must not read null, on
+;; CHECK-NEXT: 1
+
+(module
+  (func $foo
+    (local $a (ref any))
+    (local $b (ref any))
+    (local $c (ref any))
+    (drop
+      (local.get $c)
+    )
+    (drop
+      (local.get $a)
+    )
+    (drop
+      (local.get $b)
+    )
+  )
+)
@@ -0,0 +1,36 @@
+;; Test that __em_js functions are found when reading a binary without writing
+;; output, in which case function bodies are only decoded on demand.
+
+;; RUN: wasm-as %s -o %t.wasm
+;; RUN: wasm-emscripten-finalize %t.wasm | filecheck %s
+
+;;      CHECK:  "emJsFuncs": {
+;; CHECK-NEXT:    "bar": "more JS string data",
+;; CHECK-NEXT:    "foo": "some JS string data"
+;; CHECK-NEXT:  },
+
+(module
+ (memory 1 1)
+ (global $__memory_base i32 (i32.const 0))
+ (data (i32.const 1024) "some JS string data\00xxx")
+ (data (i32.const 2048) "more JS string data\00yyy")
+ (export "__em_js__foo" (func $__em_js__foo))
+ (export "__em_js__bar" (func $bar))
+ (export "other" (func $other))
+ (func $__em_js__foo (result i32)
+  (i32.const 1024)
+ )
+ (func $bar (result i32)
+  (local $x i32)
+  (local.set $x
+   (i32.add
+    (global.get $__memory_base)
+    (i32.const 2048)
+   )
+  )
+  (local.get $x)
+ )
+ (func $other
+  (call $other)
+ )
+)
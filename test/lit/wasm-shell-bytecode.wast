@@ -0,0 +1,168 @@
+;; Test the bytecode tier of the interpreter, which should give the same results
+;; as the tree walker. The shell fails if an assertion does not hold.
+
+;; RUN: wasm-shell %s
+;; RUN: wasm-shell %s --bytecode
+
+(module
+ (memory 1)
+ (global $g (mut i32) (i32.const 10))
+ (table 2 funcref)
+ (elem (i32.const 0) $add $sub)
+ (type $binary (func (param i32 i32) (result i32)))
+
+ (func $add (type $binary) (i32.add (local.get 0) (local.get 1)))
+ (func $sub (type $binary) (i32.sub (local.get 0) (local.get 1)))
+
+ ;; Loops, br_if and local.tee.
+ (func (export "sum") (param $n i32) (result i32)
+  (local $sum i32)
+  (block $done
+   (loop $loop
+    (br_if $done (i32.eqz (local.get $n)))
+    (local.set $sum (i32.add (local.get $sum) (local.get $n)))
+    (br_if $loop (local.tee $n (i32.sub (local.get $n) (i32.const 1))))
+   )
+  )
+  (local.get $sum)
+ )
+
+ ;; Branches that send values, from nested blocks.
+ (func (export "nested") (param $x i32) (result i32)
+  (i32.add
+   (i32.const 1000)
+   (block $outer (result i32)
+    (drop
+     (block $inner (result i32)
+      (drop (br_if $inner (i32.const 1) (i32.eq (local.get $x) (i32.const 1))))
+      (br_if $outer (i32.const 2) (i32.eq (local.get $x) (i32.const 2)))
+     )
+    )
+    (i32.const 3)
+   )
+  )
+ )
+
+ ;; br_table, with values.
+ (func (export "switch") (param $x i32) (result i32)
+  (block $a (result i32)
+   (drop
+    (block $b (result i32)
+     (drop
+      (block $c (result i32)
+       (br_table $a $b $c (i32.const 7) (local.get $x))
+      )
+     )
+     (return (i32.const 30))
+    )
+   )
+   (return (i32.const 20))
+  )
+ )
+
+ ;; Ifs with and without values, and select.
+ (func (export "if") (param $x i32) (result i32)
+  (local $y i32)
+  (if (i32.gt_s (local.get $x) (i32.const 10))
+   (then (local.set $y (i32.const 1)))
+  )
+  (i32.add
+   (local.get $y)
+   (if (result i32) (i32.and (local.get $x) (i32.const 1))
+    (then (i32.const 100))
+    (else (select (i32.const 200) (i32.const 300) (local.get $x)))
+   )
+  )
+ )
+
+ ;; 64-bit math and conversions.
+ (func (export "i64") (param $x i64) (result i64)
+  (i64.add
+   (i64.rotl (local.get $x) (i64.const 8))
+   (i64.extend_i32_s (i32.wrap_i64 (i64.shr_u (local.get $x) (i64.const 4))))
+  )
+ )
+
+ ;; Operations that run in the tree walker: float math, division, globals and
+ ;; indirect calls.
+ (func (export "generic") (param $x f64) (param $y i32) (result i32)
+  (global.set $g (i32.add (global.get $g) (i32.const 1)))
+  (i32.add
+   (i32.trunc_f64_s (f64.mul (local.get $x) (f64.const 2.5)))
+   (i32.add
+    (i32.div_s (global.get $g) (local.get $y))
+    (call_indirect (type $binary) (i32.const 5) (i32.const 2) (i32.const 1))
+   )
+  )
+ )
+
+ ;; Memory, and recursive calls.
+ (func $fib (export "fib") (param $n i32) (result i32)
+  (if (i32.lt_u (local.get $n) (i32.const 2))
+   (then (return (local.get $n)))
+  )
+  (i32.store offset=4 (local.get $n)
+   (i32.add
+    (call $fib (i32.sub (local.get $n) (i32.const 1)))
+    (call $fib (i32.sub (local.get $n) (i32.const 2)))
+   )
+  )
+  (i32.load offset=4 (local.get $n))
+ )
+
+ (func (export "load") (param $p i32) (result i64)
+  (i32.store16 (local.get $p) (i32.const 0xfffe))
+  (i64.load16_s (local.get $p))
+ )
+
+ (func (export "unreachable") (result i32)
+  (unreachable)
+ )
+
+ ;; Return calls of all kinds, from a function called from the outside and from
+ ;; one called from another function.
+ (func $return-calls (export "return-calls") (param $x i32) (result i32)
+  (if (i32.eq (local.get $x) (i32.const 0))
+   (then (return_call $add (i32.const 1) (i32.const 2)))
+  )
+  (if (i32.eq (local.get $x) (i32.const 1))
+   (then
+    (return_call_indirect (type $binary) (i32.const 10) (i32.const 4) (i32.const 1))
+   )
+  )
+  (return_call_ref (i32.const 5) (i32.const 6) (ref.func $add))
+ )
+
+ (func (export "nested-return-calls") (param $x i32) (result i32)
+  (i32.add
+   (i32.const 100)
+   (call $return-calls (local.get $x))
+  )
+ )
+)
+
+(assert_return (invoke "sum" (i32.const 100)) (i32.const 5050))
+(assert_return (invoke "nested" (i32.const 1)) (i32.const 1003))
+(assert_return (invoke "nested" (i32.const 2)) (i32.const 1002))
+(assert_return (invoke "nested" (i32.const 3)) (i32.const 1003))
+(assert_return (invoke "switch" (i32.const 0)) (i32.const 7))
+(assert_return (invoke "switch" (i32.const 1)) (i32.const 20))
+(assert_return (invoke "switch" (i32.const 2)) (i32.const 30))
+(assert_return (invoke "switch" (i32.const -1)) (i32.const 30))
+(assert_return (invoke "if" (i32.const 3)) (i32.const 100))
+(assert_return (invoke "if" (i32.const 4)) (i32.const 200))
+(assert_return (invoke "if" (i32.const 0)) (i32.const 300))
+(assert_return (invoke "if" (i32.const 11)) (i32.const 101))
+(assert_return (invoke "i64" (i64.const 0x0102030405060708)) (i64.const 0x0203040546576871))
+(assert_return (invoke "generic" (f64.const 4) (i32.const 2)) (i32.const 18))
+(assert_trap (invoke "generic" (f64.const 4) (i32.const 0)) "i32.div_s by 0")
+(assert_return (invoke "fib" (i32.const 15)) (i32.const 610))
+(assert_return (invoke "load" (i32.const 16)) (i64.const -2))
+(assert_trap (invoke "load" (i32.const 65535)) "final > memory")
+(assert_trap (invoke "unreachable") "unreachable")
+(assert_return (invoke "return-calls" (i32.const 0)) (i32.const 3))
+(assert_return (invoke "return-calls" (i32.const 1)) (i32.const 6))
+(assert_return (invoke "return-calls" (i32.const 2)) (i32.const 11))
+(assert_return (invoke "nested-return-calls" (i32.const 0)) (i32.const 103))
+(assert_return (invoke "nested-return-calls" (i32.const 1)) (i32.const 106))
+(assert_return (invoke "nested-return-calls" (i32.const 2)) (i32.const 111))